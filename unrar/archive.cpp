@@ -13,6 +13,7 @@ Archive::Archive(RAROptions *InitCmd)
   Cmd=DummyCmd ? (new RAROptions):InitCmd;
 
   OpenShared=Cmd->OpenShared;
+  AllowMap=true;
   Format=RARFMT15;
   Solid=false;
   Volume=false;
@@ -325,7 +326,10 @@ int Archive::Read(void *Data,size_t Size)
   size_t Result;
   if (QOpen.Read(Data,Size,Result))
     return (int)Result;
-  return File::Read(Data,Size);
+  int ReadSize=File::Read(Data,Size);
+  if (ReadSize>0)
+    QOpen.CacheHeaderRead(Data,ReadSize);
+  return ReadSize;
 }
 
 
@@ -9,6 +9,9 @@ size_t Archive::ReadHeader()
     return 0;
 
   CurBlockPos=Tell();
+#ifdef USE_QOPEN
+  QOpen.CacheHeaderStart(CurBlockPos);
+#endif
 
   size_t ReadSize;
   switch(Format)
@@ -26,6 +29,14 @@ size_t Archive::ReadHeader()
       break;
   }
 
+#ifdef USE_QOPEN
+  if (ReadSize>0 && CurHeaderType==HEAD_MAIN && Cmd->QOpenCache)
+    QOpen.InitCache(this,CurBlockPos);
+  else
+    QOpen.CacheHeaderEnd(ReadSize>0 && NextBlockPos>CurBlockPos && !BrokenHeader,
+                         CurHeaderType==HEAD_ENDARC);
+#endif
+
   if (ReadSize>0 && NextBlockPos<=CurBlockPos)
   {
     BrokenHeaderMsg();
@@ -2,15 +2,90 @@
 
 #include "rar.hpp"
 
-#ifdef USE_SSE
-#include "blake2s_sse.cpp"
+// NEON compression function is used if compiler targets it. On x86 we select
+// SSE2 or SSSE3 version at startup and also use AVX2 to hash all BLAKE2sp
+// leaves in parallel in one thread.
+#if (defined(__ARM_NEON) || defined(__ARM_NEON__)) && defined(LITTLE_ENDIAN)
+  #define USE_BLAKE2S_NEON
+  #include <arm_neon.h>
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+  #define USE_BLAKE2S_SSE
+  #if _MSC_VER>=1700
+    #define USE_BLAKE2S_AVX2
+  #endif
+  #define BLAKE2S_SSE2_ATTR
+  #define BLAKE2S_SSSE3_ATTR
+  #define BLAKE2S_AVX2_ATTR
+  #include <intrin.h>
+#elif (defined(__i386__) || defined(__x86_64__)) && (defined(__clang__) || \
+      __GNUC__>4 || __GNUC__==4 && __GNUC_MINOR__>=9)
+  #define USE_BLAKE2S_SSE
+  #define USE_BLAKE2S_AVX2
+  #define BLAKE2S_SSE2_ATTR __attribute__((target("sse2")))
+  #define BLAKE2S_SSSE3_ATTR __attribute__((target("ssse3")))
+  #define BLAKE2S_AVX2_ATTR __attribute__((target("avx2")))
+  #include <cpuid.h>
+#endif
+
+#ifdef USE_BLAKE2S_SSE
+#include <immintrin.h>
+
+static bool UseSSE2,UseSSSE3,UseAVX2;
+
+static void InitBlake2s()
+{
+  uint CPUInfo[4],MaxFunc;
+#ifdef _MSC_VER
+  __cpuid((int *)CPUInfo,0);
+  MaxFunc=CPUInfo[0];
+  __cpuid((int *)CPUInfo,1);
+#else
+  MaxFunc=__get_cpuid_max(0,NULL);
+  __cpuid(1,CPUInfo[0],CPUInfo[1],CPUInfo[2],CPUInfo[3]);
+#endif
+  // EDX bit 26 is SSE2, ECX bits 9 and 27 are SSSE3 and OSXSAVE.
+  UseSSE2=(CPUInfo[3] & 0x4000000)!=0;
+#ifdef _WIN_32
+  // 32-bit mode has less SSE2 registers and in MSVC2008 it is more efficient
+  // to not use _mm_shuffle_epi8 here.
+  UseSSSE3=false;
+#else
+  UseSSSE3=UseSSE2 && (CPUInfo[2] & 0x200)!=0;
+#endif
+  bool OSXSave=(CPUInfo[2] & 0x8000000)!=0;
+
+#ifdef USE_BLAKE2S_AVX2
+  if (MaxFunc<7 || !OSXSave)
+    return;
+#ifdef _MSC_VER
+  __cpuidex((int *)CPUInfo,7,0);
+#else
+  __cpuid_count(7,0,CPUInfo[0],CPUInfo[1],CPUInfo[2],CPUInfo[3]);
+#endif
+  // EBX bit 5 is AVX2. OS must also save YMM registers, XCR0 bits 1 and 2.
+  if ((CPUInfo[1] & 0x20)!=0)
+  {
+#ifdef _MSC_VER
+    uint64 XCR0=_xgetbv(0);
+#else
+    uint XCR0Lo,XCR0Hi;
+    __asm__ __volatile__ ("xgetbv" : "=a" (XCR0Lo), "=d" (XCR0Hi) : "c" (0));
+    uint64 XCR0=XCR0Lo;
+#endif
+    UseAVX2=(XCR0 & 6)==6;
+  }
+#endif
+}
+
+struct CallInitBlake2s {CallInitBlake2s() {InitBlake2s();}} static CallInitBlake;
 #endif
 
 static void blake2s_init_param( blake2s_state *S, uint32 node_offset, uint32 node_depth);
 static void blake2s_update( blake2s_state *S, const byte *in, size_t inlen );
 static void blake2s_final( blake2s_state *S, byte *digest );
-
-#include "blake2sp.cpp"
+#ifdef USE_BLAKE2S_AVX2
+static void blake2s_compress_buffered( blake2s_state *S );
+#endif
 
 static const uint32 blake2s_IV[8] =
 {
@@ -32,6 +107,18 @@ static const byte blake2s_sigma[10][16] =
   { 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13 , 0 } ,
 };
 
+#ifdef USE_BLAKE2S_SSE
+#include "blake2s_sse.cpp"
+#endif
+#ifdef USE_BLAKE2S_AVX2
+#include "blake2s_avx2.cpp"
+#endif
+#ifdef USE_BLAKE2S_NEON
+#include "blake2s_neon.cpp"
+#endif
+
+#include "blake2sp.cpp"
+
 static inline void blake2s_set_lastnode( blake2s_state *S )
 {
   S->f[1] = ~0U;
@@ -84,7 +171,7 @@ static _forceinline uint32 rotr32( const uint32 w, const unsigned c )
   b = rotr32(b ^ c, 7);
 
 
-static void blake2s_compress( blake2s_state *S, const byte block[BLAKE2S_BLOCKBYTES] )
+static void blake2s_compress_c( blake2s_state *S, const byte block[BLAKE2S_BLOCKBYTES] )
 {
   uint32 m[16];
   uint32 v[16];
@@ -121,6 +208,28 @@ static void blake2s_compress( blake2s_state *S, const byte block[BLAKE2S_BLOCKBY
 }
 
 
+static void blake2s_compress( blake2s_state *S, const byte block[BLAKE2S_BLOCKBYTES] )
+{
+#ifdef USE_BLAKE2S_NEON
+  blake2s_compress_neon( S, block );
+  return;
+#endif
+#ifdef USE_BLAKE2S_SSE
+  if (UseSSSE3)
+  {
+    blake2s_compress_ssse3( S, block );
+    return;
+  }
+  if (UseSSE2)
+  {
+    blake2s_compress_sse2( S, block );
+    return;
+  }
+#endif
+  blake2s_compress_c( S, block );
+}
+
+
 void blake2s_update( blake2s_state *S, const byte *in, size_t inlen )
 {
   while( inlen > 0 )
@@ -134,19 +243,8 @@ void blake2s_update( blake2s_state *S, const byte *in, size_t inlen )
       S->buflen += fill;
       blake2s_increment_counter( S, BLAKE2S_BLOCKBYTES );
 
-#ifdef USE_SSE
-#ifdef _WIN_32 // We use SSSE3 _mm_shuffle_epi8 only in x64 mode.
-      if (_SSE_Version>=SSE_SSE2)
-#else
-      if (_SSE_Version>=SSE_SSSE3)
-#endif
-        blake2s_compress_sse( S, S->buf );
-      else
-        blake2s_compress( S, S->buf ); // Compress
-#else
       blake2s_compress( S, S->buf ); // Compress
-#endif
-      
+
       memcpy( S->buf, S->buf + BLAKE2S_BLOCKBYTES, BLAKE2S_BLOCKBYTES ); // Shift buffer left
       S->buflen -= BLAKE2S_BLOCKBYTES;
       in += fill;
@@ -163,6 +261,22 @@ void blake2s_update( blake2s_state *S, const byte *in, size_t inlen )
 }
 
 
+#ifdef USE_BLAKE2S_AVX2
+// Compress all buffered data. Buffer must contain only whole blocks and
+// it must be known that more data follows, so we do not need to keep
+// the last block for blake2s_final.
+void blake2s_compress_buffered( blake2s_state *S )
+{
+  for( size_t pos = 0; pos < S->buflen; pos += BLAKE2S_BLOCKBYTES )
+  {
+    blake2s_increment_counter( S, BLAKE2S_BLOCKBYTES );
+    blake2s_compress( S, S->buf + pos );
+  }
+  S->buflen = 0;
+}
+#endif
+
+
 void blake2s_final( blake2s_state *S, byte *digest )
 {
   if( S->buflen > BLAKE2S_BLOCKBYTES )
@@ -0,0 +1,119 @@
+// AVX2 code hashing all 8 BLAKE2sp leaves at once on a single core.
+// Every 32-bit element of a vector belongs to its own leaf, so the whole
+// state of 8 leaves is kept in 16 vectors and rounds are the same as in
+// scalar blake2s_compress.
+
+#define AVX2_ROTR(r, c) ( \
+                c==8 ? _mm256_shuffle_epi8(r,crotr8) \
+              : c==16 ? _mm256_shuffle_epi8(r,crotr16) \
+              : _mm256_or_si256(_mm256_srli_epi32( (r), c ),_mm256_slli_epi32( (r), 32-c )) )
+
+#define AVX2_G(r,i,a,b,c,d) \
+  a = _mm256_add_epi32( _mm256_add_epi32( a, b ), m[blake2s_sigma[r][2*i+0]] ); \
+  d = AVX2_ROTR( _mm256_xor_si256( d, a ), 16 ); \
+  c = _mm256_add_epi32( c, d ); \
+  b = AVX2_ROTR( _mm256_xor_si256( b, c ), 12 ); \
+  a = _mm256_add_epi32( _mm256_add_epi32( a, b ), m[blake2s_sigma[r][2*i+1]] ); \
+  d = AVX2_ROTR( _mm256_xor_si256( d, a ), 8 ); \
+  c = _mm256_add_epi32( c, d ); \
+  b = AVX2_ROTR( _mm256_xor_si256( b, c ), 7 );
+
+
+// Transpose 8x8 matrix of 32-bit values stored in 8 vectors.
+BLAKE2S_AVX2_ATTR static inline void avx2_transpose8( __m256i r[8] )
+{
+  __m256i t0 = _mm256_unpacklo_epi32( r[0], r[1] );
+  __m256i t1 = _mm256_unpackhi_epi32( r[0], r[1] );
+  __m256i t2 = _mm256_unpacklo_epi32( r[2], r[3] );
+  __m256i t3 = _mm256_unpackhi_epi32( r[2], r[3] );
+  __m256i t4 = _mm256_unpacklo_epi32( r[4], r[5] );
+  __m256i t5 = _mm256_unpackhi_epi32( r[4], r[5] );
+  __m256i t6 = _mm256_unpacklo_epi32( r[6], r[7] );
+  __m256i t7 = _mm256_unpackhi_epi32( r[6], r[7] );
+
+  __m256i u0 = _mm256_unpacklo_epi64( t0, t2 );
+  __m256i u1 = _mm256_unpackhi_epi64( t0, t2 );
+  __m256i u2 = _mm256_unpacklo_epi64( t1, t3 );
+  __m256i u3 = _mm256_unpackhi_epi64( t1, t3 );
+  __m256i u4 = _mm256_unpacklo_epi64( t4, t6 );
+  __m256i u5 = _mm256_unpackhi_epi64( t4, t6 );
+  __m256i u6 = _mm256_unpacklo_epi64( t5, t7 );
+  __m256i u7 = _mm256_unpackhi_epi64( t5, t7 );
+
+  r[0] = _mm256_permute2x128_si256( u0, u4, 0x20 );
+  r[1] = _mm256_permute2x128_si256( u1, u5, 0x20 );
+  r[2] = _mm256_permute2x128_si256( u2, u6, 0x20 );
+  r[3] = _mm256_permute2x128_si256( u3, u7, 0x20 );
+  r[4] = _mm256_permute2x128_si256( u0, u4, 0x31 );
+  r[5] = _mm256_permute2x128_si256( u1, u5, 0x31 );
+  r[6] = _mm256_permute2x128_si256( u2, u6, 0x31 );
+  r[7] = _mm256_permute2x128_si256( u3, u7, 0x31 );
+}
+
+
+// Compress 'stripes' blocks of every leaf. Leaf i block is stored at
+// in + i * BLAKE2S_BLOCKBYTES in every stripe of 8 blocks. All leaves must
+// have the same counter, empty buffer and must not be finalized.
+BLAKE2S_AVX2_ATTR static void blake2sp_compress_avx2( blake2s_state *S, const byte *in, size_t stripes )
+{
+  const __m256i crotr8 = _mm256_set_epi8( 12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1,
+                                          12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1 );
+  const __m256i crotr16 = _mm256_set_epi8( 13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2,
+                                           13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2 );
+
+  __m256i h[8], m[16], v[16];
+
+  // Load h[i] of all leaves to element 'leaf' of vector i.
+  for( size_t i = 0; i < 8; ++i )
+    h[i] = _mm256_loadu_si256( (__m256i *)S[i].h );
+  avx2_transpose8( h );
+
+  uint32 t0 = S[0].t[0], t1 = S[0].t[1];
+
+  for( ; stripes > 0; stripes-- )
+  {
+    t0 += BLAKE2S_BLOCKBYTES;
+    t1 += ( t0 < BLAKE2S_BLOCKBYTES );
+
+    for( size_t i = 0; i < 8; ++i )
+    {
+      m[i] = _mm256_loadu_si256( (__m256i *)( in + i * BLAKE2S_BLOCKBYTES ) );
+      m[i + 8] = _mm256_loadu_si256( (__m256i *)( in + i * BLAKE2S_BLOCKBYTES + 32 ) );
+    }
+    avx2_transpose8( m );
+    avx2_transpose8( m + 8 );
+
+    for( size_t i = 0; i < 8; ++i )
+    {
+      v[i] = h[i];
+      v[i + 8] = _mm256_set1_epi32( blake2s_IV[i] );
+    }
+    v[12] = _mm256_xor_si256( v[12], _mm256_set1_epi32( t0 ) );
+    v[13] = _mm256_xor_si256( v[13], _mm256_set1_epi32( t1 ) );
+
+    for ( uint r = 0; r <= 9; ++r )
+    {
+      AVX2_G(r,0,v[ 0],v[ 4],v[ 8],v[12]);
+      AVX2_G(r,1,v[ 1],v[ 5],v[ 9],v[13]);
+      AVX2_G(r,2,v[ 2],v[ 6],v[10],v[14]);
+      AVX2_G(r,3,v[ 3],v[ 7],v[11],v[15]);
+      AVX2_G(r,4,v[ 0],v[ 5],v[10],v[15]);
+      AVX2_G(r,5,v[ 1],v[ 6],v[11],v[12]);
+      AVX2_G(r,6,v[ 2],v[ 7],v[ 8],v[13]);
+      AVX2_G(r,7,v[ 3],v[ 4],v[ 9],v[14]);
+    }
+
+    for( size_t i = 0; i < 8; ++i )
+      h[i] = _mm256_xor_si256( h[i], _mm256_xor_si256( v[i], v[i + 8] ) );
+
+    in += 8 * BLAKE2S_BLOCKBYTES;
+  }
+
+  avx2_transpose8( h );
+  for( size_t i = 0; i < 8; ++i )
+  {
+    _mm256_storeu_si256( (__m256i *)S[i].h, h[i] );
+    S[i].t[0] = t0;
+    S[i].t[1] = t1;
+  }
+}
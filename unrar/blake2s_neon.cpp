@@ -0,0 +1,67 @@
+// NEON version of BLAKE2s compression function. It follows the SSE code,
+// keeping each row of 4x4 state matrix in one vector register.
+
+#define neon_rotr(r, c) ( \
+                c==16 ? vreinterpretq_u32_u16(vrev32q_u16(vreinterpretq_u16_u32(r))) \
+              : vsriq_n_u32(vshlq_n_u32( (r), 32-c ), (r), c) )
+
+#define NEON_G(row1,row2,row3,row4,buf,c1,c2) \
+  row1 = vaddq_u32( vaddq_u32( row1, buf), row2 ); \
+  row4 = veorq_u32( row4, row1 ); \
+  row4 = neon_rotr(row4, c1); \
+  row3 = vaddq_u32( row3, row4 ); \
+  row2 = veorq_u32( row2, row3 ); \
+  row2 = neon_rotr(row2, c2);
+
+#define NEON_DIAGONALIZE(row1,row2,row3,row4) \
+  row4 = vextq_u32( row4, row4, 3 ); \
+  row3 = vextq_u32( row3, row3, 2 ); \
+  row2 = vextq_u32( row2, row2, 1 );
+
+#define NEON_UNDIAGONALIZE(row1,row2,row3,row4) \
+  row4 = vextq_u32( row4, row4, 1 ); \
+  row3 = vextq_u32( row3, row3, 2 ); \
+  row2 = vextq_u32( row2, row2, 3 );
+
+#define NEON_LOAD_MSG(m,r,i0,i1,i2,i3) \
+  { \
+    uint32 v[4]={m[blake2s_sigma[r][i0]],m[blake2s_sigma[r][i1]], \
+                 m[blake2s_sigma[r][i2]],m[blake2s_sigma[r][i3]]}; \
+    buf=vld1q_u32(v); \
+  }
+
+#define NEON_ROUND(m,row,r) \
+{ \
+  uint32x4_t buf; \
+  NEON_LOAD_MSG(m,r,0,2,4,6); \
+  NEON_G(row[0],row[1],row[2],row[3],buf,16,12); \
+  NEON_LOAD_MSG(m,r,1,3,5,7); \
+  NEON_G(row[0],row[1],row[2],row[3],buf,8,7); \
+  NEON_DIAGONALIZE(row[0],row[1],row[2],row[3]); \
+  NEON_LOAD_MSG(m,r,8,10,12,14); \
+  NEON_G(row[0],row[1],row[2],row[3],buf,16,12); \
+  NEON_LOAD_MSG(m,r,9,11,13,15); \
+  NEON_G(row[0],row[1],row[2],row[3],buf,8,7); \
+  NEON_UNDIAGONALIZE(row[0],row[1],row[2],row[3]); \
+}
+
+
+static void blake2s_compress_neon( blake2s_state *S, const byte block[BLAKE2S_BLOCKBYTES] )
+{
+  uint32 m[16];
+  for( size_t i = 0; i < 16; ++i )
+    m[i] = RawGet4( block + i * 4 );
+
+  uint32x4_t row[4];
+  uint32x4_t ff0, ff1;
+
+  row[0] = ff0 = vld1q_u32( &S->h[0] );
+  row[1] = ff1 = vld1q_u32( &S->h[4] );
+
+  row[2] = vld1q_u32( &blake2s_IV[0] );
+  row[3] = veorq_u32( vld1q_u32( &blake2s_IV[4] ), vld1q_u32( &S->t[0] ) );
+  for ( uint r = 0; r <= 9; ++r )
+    NEON_ROUND( m, row, r );
+  vst1q_u32( &S->h[0], veorq_u32( ff0, veorq_u32( row[0], row[2] ) ) );
+  vst1q_u32( &S->h[4], veorq_u32( ff1, veorq_u32( row[1], row[3] ) ) );
+}
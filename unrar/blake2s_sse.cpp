@@ -1,38 +1,35 @@
 // Based on public domain code written in 2012 by Samuel Neves
 
-extern const byte blake2s_sigma[10][16];
-
 #define LOAD(p)  _mm_load_si128( (__m128i *)(p) )
 #define STORE(p,r) _mm_store_si128((__m128i *)(p), r)
 
-#ifdef _WIN_32
-// 32-bit mode has less SSE2 registers and in MSVC2008 it is more efficient
-// to not use _mm_shuffle_epi8 here.
-#define mm_rotr_epi32(r, c) ( \
-              _mm_xor_si128(_mm_srli_epi32( (r), c ),_mm_slli_epi32( (r), 32-c )) )
-#else
-#define mm_rotr_epi32(r, c) ( \
+// SSE2 has no byte shuffle, but rotation by 16 is still possible with
+// 16-bit word shuffles.
+#define mm_rotr_epi32_sse2(r, c) ( \
+                c==16 ? _mm_shufflehi_epi16(_mm_shufflelo_epi16(r,0xb1),0xb1) \
+              : _mm_xor_si128(_mm_srli_epi32( (r), c ),_mm_slli_epi32( (r), 32-c )) )
+
+#define mm_rotr_epi32_ssse3(r, c) ( \
                 c==8 ? _mm_shuffle_epi8(r,crotr8) \
               : c==16 ? _mm_shuffle_epi8(r,crotr16) \
               : _mm_xor_si128(_mm_srli_epi32( (r), c ),_mm_slli_epi32( (r), 32-c )) )
-#endif
 
 
-#define G1(row1,row2,row3,row4,buf) \
+#define G1(row1,row2,row3,row4,buf,rotr) \
   row1 = _mm_add_epi32( _mm_add_epi32( row1, buf), row2 ); \
   row4 = _mm_xor_si128( row4, row1 ); \
-  row4 =  mm_rotr_epi32(row4, 16); \
+  row4 =  rotr(row4, 16); \
   row3 = _mm_add_epi32( row3, row4 );   \
   row2 = _mm_xor_si128( row2, row3 ); \
-  row2 =  mm_rotr_epi32(row2, 12);
+  row2 =  rotr(row2, 12);
 
-#define G2(row1,row2,row3,row4,buf) \
+#define G2(row1,row2,row3,row4,buf,rotr) \
   row1 = _mm_add_epi32( _mm_add_epi32( row1, buf), row2 ); \
   row4 = _mm_xor_si128( row4, row1 ); \
-  row4 =  mm_rotr_epi32(row4, 8); \
+  row4 =  rotr(row4, 8); \
   row3 = _mm_add_epi32( row3, row4 );   \
   row2 = _mm_xor_si128( row2, row3 ); \
-  row2 =  mm_rotr_epi32(row2, 7);
+  row2 =  rotr(row2, 7);
 
 #define DIAGONALIZE(row1,row2,row3,row4) \
   row4 = _mm_shuffle_epi32( row4, _MM_SHUFFLE(2,1,0,3) ); \
@@ -54,42 +51,70 @@ extern const byte blake2s_sigma[10][16];
 
 // Original BLAKE2 SSE4.1 message loading code was a little slower in x86 mode
 // and about the same in x64 mode in our test. Perhaps depends on compiler.
-#define SSE_ROUND(m,row,r) \
+#define SSE_ROUND(m,row,r,rotr) \
 { \
   __m128i buf; \
   buf=_mm_set_epi32(m[blake2s_sigma[r][6]],m[blake2s_sigma[r][4]],m[blake2s_sigma[r][2]],m[blake2s_sigma[r][0]]); \
-  G1(row[0],row[1],row[2],row[3],buf); \
+  G1(row[0],row[1],row[2],row[3],buf,rotr); \
   buf=_mm_set_epi32(m[blake2s_sigma[r][7]],m[blake2s_sigma[r][5]],m[blake2s_sigma[r][3]],m[blake2s_sigma[r][1]]); \
-  G2(row[0],row[1],row[2],row[3],buf); \
+  G2(row[0],row[1],row[2],row[3],buf,rotr); \
   DIAGONALIZE(row[0],row[1],row[2],row[3]); \
   buf=_mm_set_epi32(m[blake2s_sigma[r][14]],m[blake2s_sigma[r][12]],m[blake2s_sigma[r][10]],m[blake2s_sigma[r][8]]); \
-  G1(row[0],row[1],row[2],row[3],buf); \
+  G1(row[0],row[1],row[2],row[3],buf,rotr); \
   buf=_mm_set_epi32(m[blake2s_sigma[r][15]],m[blake2s_sigma[r][13]],m[blake2s_sigma[r][11]],m[blake2s_sigma[r][9]]); \
-  G2(row[0],row[1],row[2],row[3],buf); \
+  G2(row[0],row[1],row[2],row[3],buf,rotr); \
   UNDIAGONALIZE(row[0],row[1],row[2],row[3]); \
 }
 
 
-static int blake2s_compress_sse( blake2s_state *S, const byte block[BLAKE2S_BLOCKBYTES] )
+// Initialization vector and rotation constants are created inside of
+// functions to be compatible with CPUs not supporting SSE2. Global static
+// initialization is performed before our SSE check.
+#define SSE_IV \
+  const __m128i blake2s_IV_0_3 = _mm_setr_epi32( 0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A ); \
+  const __m128i blake2s_IV_4_7 = _mm_setr_epi32( 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19 );
+
+
+BLAKE2S_SSE2_ATTR static void blake2s_compress_sse2( blake2s_state *S, const byte block[BLAKE2S_BLOCKBYTES] )
 {
-  // Initialization vector. Moving them outside of function would provide
-  // ~5% speed gain in 32-bit mode, but would make code incompatible
-  // with older non-SSE2 compatible CPUs. Global static initialization
-  // is performed before our SSE check.
-  static const __m128i blake2s_IV_0_3 = _mm_setr_epi32( 0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A );
-  static const __m128i blake2s_IV_4_7 = _mm_setr_epi32( 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19 );
+  SSE_IV
 
-#ifdef _WIN_64
-  // Constants for cyclic rotation. We use them in 64-bit mode
-  // in mm_rotr_epi32 macro above. We must not define in global scope
-  // to be compatible with non-SSE CPU.
-  static const __m128i crotr8 = _mm_set_epi8( 12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1 );
-  static const __m128i crotr16 = _mm_set_epi8( 13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2 );
-#endif
+  __m128i row[4];
+  __m128i ff0, ff1;
+
+  const uint32  *m = ( uint32 * )block;
+
+  row[0] = ff0 = LOAD( &S->h[0] );
+  row[1] = ff1 = LOAD( &S->h[4] );
+
+  row[2] = blake2s_IV_0_3;
+  row[3] = _mm_xor_si128( blake2s_IV_4_7, LOAD( &S->t[0] ) );
+  SSE_ROUND( m, row, 0, mm_rotr_epi32_sse2 );
+  SSE_ROUND( m, row, 1, mm_rotr_epi32_sse2 );
+  SSE_ROUND( m, row, 2, mm_rotr_epi32_sse2 );
+  SSE_ROUND( m, row, 3, mm_rotr_epi32_sse2 );
+  SSE_ROUND( m, row, 4, mm_rotr_epi32_sse2 );
+  SSE_ROUND( m, row, 5, mm_rotr_epi32_sse2 );
+  SSE_ROUND( m, row, 6, mm_rotr_epi32_sse2 );
+  SSE_ROUND( m, row, 7, mm_rotr_epi32_sse2 );
+  SSE_ROUND( m, row, 8, mm_rotr_epi32_sse2 );
+  SSE_ROUND( m, row, 9, mm_rotr_epi32_sse2 );
+  STORE( &S->h[0], _mm_xor_si128( ff0, _mm_xor_si128( row[0], row[2] ) ) );
+  STORE( &S->h[4], _mm_xor_si128( ff1, _mm_xor_si128( row[1], row[3] ) ) );
+}
+
+
+BLAKE2S_SSSE3_ATTR static void blake2s_compress_ssse3( blake2s_state *S, const byte block[BLAKE2S_BLOCKBYTES] )
+{
+  SSE_IV
+
+  // Constants for cyclic rotation in mm_rotr_epi32_ssse3 macro above.
+  const __m128i crotr8 = _mm_set_epi8( 12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1 );
+  const __m128i crotr16 = _mm_set_epi8( 13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2 );
 
   __m128i row[4];
   __m128i ff0, ff1;
-  
+
   const uint32  *m = ( uint32 * )block;
 
   row[0] = ff0 = LOAD( &S->h[0] );
@@ -97,17 +122,16 @@ static int blake2s_compress_sse( blake2s_state *S, const byte block[BLAKE2S_BLOC
 
   row[2] = blake2s_IV_0_3;
   row[3] = _mm_xor_si128( blake2s_IV_4_7, LOAD( &S->t[0] ) );
-  SSE_ROUND( m, row, 0 );
-  SSE_ROUND( m, row, 1 );
-  SSE_ROUND( m, row, 2 );
-  SSE_ROUND( m, row, 3 );
-  SSE_ROUND( m, row, 4 );
-  SSE_ROUND( m, row, 5 );
-  SSE_ROUND( m, row, 6 );
-  SSE_ROUND( m, row, 7 );
-  SSE_ROUND( m, row, 8 );
-  SSE_ROUND( m, row, 9 );
+  SSE_ROUND( m, row, 0, mm_rotr_epi32_ssse3 );
+  SSE_ROUND( m, row, 1, mm_rotr_epi32_ssse3 );
+  SSE_ROUND( m, row, 2, mm_rotr_epi32_ssse3 );
+  SSE_ROUND( m, row, 3, mm_rotr_epi32_ssse3 );
+  SSE_ROUND( m, row, 4, mm_rotr_epi32_ssse3 );
+  SSE_ROUND( m, row, 5, mm_rotr_epi32_ssse3 );
+  SSE_ROUND( m, row, 6, mm_rotr_epi32_ssse3 );
+  SSE_ROUND( m, row, 7, mm_rotr_epi32_ssse3 );
+  SSE_ROUND( m, row, 8, mm_rotr_epi32_ssse3 );
+  SSE_ROUND( m, row, 9, mm_rotr_epi32_ssse3 );
   STORE( &S->h[0], _mm_xor_si128( ff0, _mm_xor_si128( row[0], row[2] ) ) );
   STORE( &S->h[4], _mm_xor_si128( ff1, _mm_xor_si128( row[1], row[3] ) ) );
-  return 0;
 }
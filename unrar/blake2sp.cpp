@@ -81,6 +81,24 @@ void blake2sp_update( blake2sp_state *S, const byte *in, size_t inlen )
     left = 0;
   }
 
+#ifdef USE_BLAKE2S_AVX2
+  // AVX2 hashes all leaves in one pass and single thread is enough for it.
+  // We leave the last data stripe to code below, so leaves keep the last
+  // block in buffer as required by blake2sp_final.
+  if( UseAVX2 && inlen >= 2 * PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES )
+  {
+    size_t stripes = inlen / ( PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES ) - 1;
+
+    for( size_t i = 0; i < PARALLELISM_DEGREE; ++i )
+      blake2s_compress_buffered( &S->S[i] );
+
+    blake2sp_compress_avx2( S->S, in, stripes );
+
+    in += stripes * PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES;
+    inlen -= stripes * PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES;
+  }
+#endif
+
   Blake2ThreadData btd_array[PARALLELISM_DEGREE];
 
 #ifdef RAR_SMP
@@ -176,8 +176,9 @@ void CommandData::ParseDone()
   if (Test && Extract)
     Test=false;        // Switch '-t' is senseless for 'X', 'E', 'P' commands.
 
-  // Suppress the copyright message and final end of line for 'lb' and 'vb'.
-  if ((CmdChar=='L' || CmdChar=='V') && Command[1]=='B')
+  // Suppress the copyright message and final end of line for 'lb', 'vb',
+  // 'lf' and 'vf'.
+  if ((CmdChar=='L' || CmdChar=='V') && (Command[1]=='B' || Command[1]=='F'))
     BareOutput=true;
 }
 
@@ -653,6 +654,9 @@ void CommandData::ProcessSwitch(const wchar *Switch)
           case '+':
             QOpenMode=QOPEN_ALWAYS;
             break;
+          case 'C':
+            QOpenCache=true;
+            break;
           default:
             BadSwitch(Switch);
             break;
@@ -950,9 +954,9 @@ void CommandData::OutHelp(RAR_EXIT ExitCode)
     MCHelpSwAT,MCHelpSwAC,MCHelpSwAD,MCHelpSwAG,MCHelpSwAI,MCHelpSwAP,
     MCHelpSwCm,MCHelpSwCFGm,MCHelpSwCL,MCHelpSwCU,
     MCHelpSwDH,MCHelpSwEP,MCHelpSwEP3,MCHelpSwF,MCHelpSwIDP,MCHelpSwIERR,
-    MCHelpSwINUL,MCHelpSwIOFF,MCHelpSwKB,MCHelpSwN,MCHelpSwNa,MCHelpSwNal,
+    MCHelpSwINUL,MCHelpSwIOFF,MCHelpSwKB,MCHelpSwMT,MCHelpSwN,MCHelpSwNa,MCHelpSwNal,
     MCHelpSwO,MCHelpSwOC,MCHelpSwOR,MCHelpSwOW,MCHelpSwP,
-    MCHelpSwPm,MCHelpSwR,MCHelpSwRI,MCHelpSwSL,MCHelpSwSM,MCHelpSwTA,
+    MCHelpSwPm,MCHelpSwQOC,MCHelpSwR,MCHelpSwRI,MCHelpSwSL,MCHelpSwSM,MCHelpSwTA,
     MCHelpSwTB,MCHelpSwTN,MCHelpSwTO,MCHelpSwTS,MCHelpSwU,MCHelpSwVUnr,
     MCHelpSwVER,MCHelpSwVP,MCHelpSwX,MCHelpSwXa,MCHelpSwXal,MCHelpSwY
 #else
@@ -1156,6 +1160,17 @@ bool CommandData::SizeCheck(int64 Size)
 #endif
 
 
+#ifndef SFX_MODULE
+// Return 'true' if time, size or attribute filters are set.
+bool CommandData::AnyFiltersActive()
+{
+  return FileTimeBefore.IsSet() || FileTimeAfter.IsSet() ||
+         FileSizeLess!=INT64NDF || FileSizeMore!=INT64NDF ||
+         ExclFileAttr!=0 || InclAttrSet;
+}
+#endif
+
+
 
 
 int CommandData::IsProcessFile(FileHeader &FileHead,bool *ExactMatch,int MatchType)
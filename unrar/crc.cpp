@@ -14,6 +14,29 @@
 
 #include "rar.hpp"
 
+// CRC32 instructions of ARMv8 are used if the compiler targets them.
+// On x86 the PCLMULQDQ version is selected at startup if CPU supports it.
+#if defined(__ARM_FEATURE_CRC32) && defined(LITTLE_ENDIAN)
+  #define USE_CRC_ARM
+  #include <arm_acle.h>
+#elif defined(_MSC_VER) && _MSC_VER>=1500 && (defined(_M_IX86) || defined(_M_X64))
+  #define USE_CRC_CLMUL
+  #define CRC_CLMUL_ATTR
+  #include <intrin.h>
+#elif (defined(__i386__) || defined(__x86_64__)) && (defined(__clang__) || \
+      __GNUC__>4 || __GNUC__==4 && __GNUC_MINOR__>=9)
+  #define USE_CRC_CLMUL
+  #define CRC_CLMUL_ATTR __attribute__((target("sse2,pclmul")))
+  #include <cpuid.h>
+#endif
+
+#ifdef USE_CRC_CLMUL
+#include <emmintrin.h>
+#include <wmmintrin.h>
+
+static bool UseCLMUL;
+#endif
+
 static uint crc_tables[8][256]; // Tables for Slicing-by-8.
 
 
@@ -46,12 +69,24 @@ static void InitTables()
 			crc_tables[J][I]=C;
 		}
 	}
+
+#ifdef USE_CRC_CLMUL
+  uint CPUInfo[4];
+#ifdef _MSC_VER
+  __cpuid((int *)CPUInfo,1);
+#else
+  if (!__get_cpuid(1,&CPUInfo[0],&CPUInfo[1],&CPUInfo[2],&CPUInfo[3]))
+    CPUInfo[2]=CPUInfo[3]=0;
+#endif
+  // ECX bit 1 is PCLMULQDQ, EDX bit 26 is SSE2.
+  UseCLMUL=(CPUInfo[2] & 2)!=0 && (CPUInfo[3] & 0x4000000)!=0;
+#endif
 }
 
 
 struct CallInitCRC {CallInitCRC() {InitTables();}} static CallInit32;
 
-uint CRC32(uint StartCRC,const void *Addr,size_t Size)
+static uint CRC32_Slice8(uint StartCRC,const void *Addr,size_t Size)
 {
   byte *Data=(byte *)Addr;
 
@@ -85,6 +120,72 @@ uint CRC32(uint StartCRC,const void *Addr,size_t Size)
 }
 
 
+#ifdef USE_CRC_CLMUL
+// Fold 64 bytes per iteration with carry-less multiplication, same as
+// xad_xz/lzma/liblzma/check/crc_x86_clmul.h, which describes the method.
+#define CLMUL_FOLD(x,k,y) x=_mm_xor_si128(_mm_xor_si128( \
+          _mm_clmulepi64_si128(x,k,0x00),_mm_clmulepi64_si128(x,k,0x11)),y)
+
+CRC_CLMUL_ATTR static uint CRC32_CLMUL(uint StartCRC,const void *Addr,size_t Size)
+{
+  const __m128i *Data=(const __m128i *)Addr;
+
+  __m128i K=_mm_set_epi32((int)0xcad38e8f,0,0x653d9822,0);
+  __m128i X0=_mm_xor_si128(_mm_loadu_si128(Data),_mm_cvtsi32_si128((int)StartCRC));
+  __m128i X1=_mm_loadu_si128(Data+1);
+  __m128i X2=_mm_loadu_si128(Data+2);
+  __m128i X3=_mm_loadu_si128(Data+3);
+  for (Data+=4,Size-=64;Size>=64;Data+=4,Size-=64)
+  {
+    CLMUL_FOLD(X0,K,_mm_loadu_si128(Data));
+    CLMUL_FOLD(X1,K,_mm_loadu_si128(Data+1));
+    CLMUL_FOLD(X2,K,_mm_loadu_si128(Data+2));
+    CLMUL_FOLD(X3,K,_mm_loadu_si128(Data+3));
+  }
+
+  K=_mm_set_epi32((int)0x9ba54c6f,0,0x65673b46,0);
+  CLMUL_FOLD(X0,K,X1);
+  CLMUL_FOLD(X0,K,X2);
+  CLMUL_FOLD(X0,K,X3);
+  for (;Size>=16;Data++,Size-=16)
+    CLMUL_FOLD(X0,K,_mm_loadu_si128(Data));
+
+  byte Rem[16];
+  _mm_storeu_si128((__m128i *)Rem,X0);
+  return CRC32_Slice8(CRC32_Slice8(0,Rem,sizeof(Rem)),Data,Size);
+}
+#endif
+
+
+#ifdef USE_CRC_ARM
+static uint CRC32_ARM(uint StartCRC,const void *Addr,size_t Size)
+{
+  byte *Data=(byte *)Addr;
+  for (;Size>0 && ((size_t)Data & 7);Size--,Data++)
+    StartCRC=__crc32b(StartCRC,Data[0]);
+  for (;Size>=8;Size-=8,Data+=8)
+    StartCRC=__crc32d(StartCRC,*(uint64 *)Data);
+  for (;Size>0;Size--,Data++)
+    StartCRC=__crc32b(StartCRC,Data[0]);
+  return StartCRC;
+}
+#endif
+
+
+uint CRC32(uint StartCRC,const void *Addr,size_t Size)
+{
+#ifdef USE_CRC_ARM
+  return CRC32_ARM(StartCRC,Addr,Size);
+#else
+#ifdef USE_CRC_CLMUL
+  if (UseCLMUL && Size>=64)
+    return CRC32_CLMUL(StartCRC,Addr,Size);
+#endif
+  return CRC32_Slice8(StartCRC,Addr,Size);
+#endif
+}
+
+
 #ifndef SFX_MODULE
 // For RAR 1.4 archives in case somebody still has them.
 ushort Checksum14(ushort StartCRC,const void *Addr,size_t Size)
@@ -78,10 +78,17 @@ class CryptData
 void GetRnd(byte *RndBuf,size_t BufSize);
 
 void hmac_sha256(const byte *Key,size_t KeyLength,const byte *Data,
-                 size_t DataLength,byte *ResDigest);
+                 size_t DataLength,byte *ResDigest,
+                 sha256_context *ICtxOpt=NULL,bool *SetIOpt=NULL,
+                 sha256_context *RCtxOpt=NULL,bool *SetROpt=NULL);
 void pbkdf2(const byte *pass, size_t pass_len, const byte *salt,
             size_t salt_len,byte *key, byte *Value1, byte *Value2,
             uint rounds);
+void pbkdf2_mb(const byte **Pwd, const size_t *PwdLength, size_t PwdCount,
+               const byte *Salt, size_t SaltLength,
+               byte *Key, byte *V1, byte *V2, uint Count);
+int CheckPasswords50(SecPassword *Passwords,size_t PwdCount,const byte *Salt,
+                     uint Lg2Cnt,const byte *PswCheck);
 
 void ConvertHashToMAC(HashValue *Value,byte *Key);
 
@@ -1,5 +1,10 @@
+// If ICtxOpt and RCtxOpt are not NULL, contexts after hashing the padded key
+// are stored there on first call and reused in next calls with the same key.
+// It saves two SHA-256 blocks per call in PBKDF2 loop.
 void hmac_sha256(const byte *Key,size_t KeyLength,const byte *Data,
-                 size_t DataLength,byte *ResDigest)
+                 size_t DataLength,byte *ResDigest,
+                 sha256_context *ICtxOpt,bool *SetIOpt,
+                 sha256_context *RCtxOpt,bool *SetROpt)
 {
   const size_t Sha256BlockSize=64; // As defined in RFC 4868.
 
@@ -16,31 +21,60 @@ void hmac_sha256(const byte *Key,size_t KeyLength,const byte *Data,
   }
 
   byte KeyBuf[Sha256BlockSize]; // Store the padded key here.
-  for (size_t I = 0; I < KeyLength; I++) // Use 0x36 padding for inner digest.
-    KeyBuf[I] = Key[I] ^ 0x36;
-  for (size_t I = KeyLength; I < Sha256BlockSize; I++)
-    KeyBuf[I] = 0x36;
-
   sha256_context ICtx;
-  sha256_init(&ICtx);
-  sha256_process(&ICtx, KeyBuf, Sha256BlockSize); // Hash padded key.
+
+  if (ICtxOpt != NULL && *SetIOpt)
+    ICtx = *ICtxOpt; // Use already calculated first block context.
+  else
+  {
+    for (size_t I = 0; I < KeyLength; I++) // Use 0x36 padding for inner digest.
+      KeyBuf[I] = Key[I] ^ 0x36;
+    for (size_t I = KeyLength; I < Sha256BlockSize; I++)
+      KeyBuf[I] = 0x36;
+
+    sha256_init(&ICtx);
+    sha256_process(&ICtx, KeyBuf, Sha256BlockSize); // Hash padded key.
+  }
+
+  if (ICtxOpt != NULL && !*SetIOpt) // Store constant context for further reuse.
+  {
+    *ICtxOpt = ICtx;
+    *SetIOpt = true;
+  }
+
   sha256_process(&ICtx, Data, DataLength); // Hash data.
 
   byte IDig[SHA256_DIGEST_SIZE]; // Internal digest for padded key and data.
   sha256_done(&ICtx, IDig);
 
   sha256_context RCtx;
-  sha256_init(&RCtx);
 
-  for (size_t I = 0; I < KeyLength; I++) // Use 0x5c for outer key padding.
-    KeyBuf[I] = Key[I] ^ 0x5c;
-  for (size_t I = KeyLength; I < Sha256BlockSize; I++)
-    KeyBuf[I] = 0x5c;
+  if (RCtxOpt != NULL && *SetROpt)
+    RCtx = *RCtxOpt; // Use already calculated first block context.
+  else
+  {
+    for (size_t I = 0; I < KeyLength; I++) // Use 0x5c for outer key padding.
+      KeyBuf[I] = Key[I] ^ 0x5c;
+    for (size_t I = KeyLength; I < Sha256BlockSize; I++)
+      KeyBuf[I] = 0x5c;
+
+    sha256_init(&RCtx);
+    sha256_process(&RCtx, KeyBuf, Sha256BlockSize); // Hash padded key.
+  }
+
+  if (RCtxOpt != NULL && !*SetROpt) // Store constant context for further reuse.
+  {
+    *RCtxOpt = RCtx;
+    *SetROpt = true;
+  }
 
-  sha256_process(&RCtx, KeyBuf, Sha256BlockSize); // Hash padded key.
   sha256_process(&RCtx, IDig, SHA256_DIGEST_SIZE); // Hash internal digest.
 
   sha256_done(&RCtx, ResDigest);
+
+  cleandata(KeyBuf, sizeof(KeyBuf));
+  cleandata(&ICtx, sizeof(ICtx));
+  cleandata(&RCtx, sizeof(RCtx));
 }
 
 
@@ -53,16 +87,21 @@ void pbkdf2(const byte *Pwd, size_t PwdLength,
 {
   const size_t MaxSalt=64;
   byte SaltData[MaxSalt+4];
-	memcpy(SaltData, Salt, Min(SaltLength,MaxSalt));
+	SaltLength=Min(SaltLength,MaxSalt);
+	memcpy(SaltData, Salt, SaltLength);
 
 	SaltData[SaltLength + 0] = 0; // Salt concatenated to 1.
 	SaltData[SaltLength + 1] = 0;
 	SaltData[SaltLength + 2] = 0;
 	SaltData[SaltLength + 3] = 1;
 
+  // Padded password contexts are the same for all iterations.
+  sha256_context ICtx,RCtx;
+  bool SetI=false,SetR=false;
+
   // First iteration: HMAC of password, salt and block index (1).
   byte U1[SHA256_DIGEST_SIZE];
-	hmac_sha256(Pwd, PwdLength, SaltData, SaltLength + 4, U1);
+	hmac_sha256(Pwd, PwdLength, SaltData, SaltLength + 4, U1, &ICtx, &SetI, &RCtx, &SetR);
   byte Fn[SHA256_DIGEST_SIZE]; // Current function value.
 	memcpy(Fn, U1, sizeof(Fn)); // Function at first iteration.
 
@@ -74,7 +113,8 @@ void pbkdf2(const byte *Pwd, size_t PwdLength,
   {
   	for (uint J = 0; J < CurCount[I]; J++) 
     {
-      hmac_sha256(Pwd, PwdLength, U1, sizeof(U1), U2); // U2 = PRF (P, U1).
+      // U2 = PRF (P, U1).
+      hmac_sha256(Pwd, PwdLength, U1, sizeof(U1), U2, &ICtx, &SetI, &RCtx, &SetR);
   		memcpy(U1, U2, sizeof(U1));
   		for (uint K = 0; K < sizeof(Fn); K++) // Function ^= U.
   			Fn[K] ^= U1[K];
@@ -86,6 +126,94 @@ void pbkdf2(const byte *Pwd, size_t PwdLength,
   cleandata(Fn, sizeof(Fn));
 	cleandata(U1, sizeof(U1));
 	cleandata(U2, sizeof(U2));
+  cleandata(&ICtx, sizeof(ICtx));
+  cleandata(&RCtx, sizeof(RCtx));
+}
+
+
+// PBKDF2 for several passwords with the same salt and iteration count.
+// It returns the same values as pbkdf2 for every password, but computes
+// SHA256_MB_LANES passwords at once with sha256_transform_mb.
+// Every iteration is HMAC of 32 byte U value, so we hash only one block
+// for inner and one for outer digest, starting from the padded key states.
+// Key, V1 and V2 are arrays of PwdCount digests, any of them can be NULL.
+void pbkdf2_mb(const byte **Pwd, const size_t *PwdLength, size_t PwdCount,
+               const byte *Salt, size_t SaltLength,
+               byte *Key, byte *V1, byte *V2, uint Count)
+{
+  const size_t MaxSalt=64;
+  byte SaltData[MaxSalt+4];
+  SaltLength=Min(SaltLength,MaxSalt);
+  memcpy(SaltData, Salt, SaltLength);
+
+  SaltData[SaltLength + 0] = 0; // Salt concatenated to 1.
+  SaltData[SaltLength + 1] = 0;
+  SaltData[SaltLength + 2] = 0;
+  SaltData[SaltLength + 3] = 1;
+
+  const uint Lanes=SHA256_MB_LANES;
+  uint32 IState[8][Lanes],RState[8][Lanes]; // Padded key states.
+  uint32 U[8][Lanes],Fn[8][Lanes],H[8][Lanes],W[16][Lanes];
+
+  // Message block is 32 byte digest followed by padding for 64+32 bytes.
+  for (uint I=8;I<16;I++)
+    for (uint L=0;L<Lanes;L++)
+      W[I][L]=I==8 ? 0x80000000 : I==15 ? (64+32)*8 : 0;
+
+  for (size_t First=0;First<PwdCount;First+=Lanes)
+  {
+    for (uint L=0;L<Lanes;L++)
+    {
+      // Fill unused lanes of the last group with the last password.
+      size_t P=Min(First+L,PwdCount-1);
+
+      sha256_context ICtx,RCtx;
+      bool SetI=false,SetR=false;
+      byte U1[SHA256_DIGEST_SIZE];
+      hmac_sha256(Pwd[P], PwdLength[P], SaltData, SaltLength + 4, U1, &ICtx, &SetI, &RCtx, &SetR);
+      for (uint I=0;I<8;I++)
+      {
+        IState[I][L]=ICtx.H[I];
+        RState[I][L]=RCtx.H[I];
+        U[I][L]=Fn[I][L]=RawGetBE4(U1+I*4);
+      }
+      cleandata(&ICtx, sizeof(ICtx));
+      cleandata(&RCtx, sizeof(RCtx));
+      cleandata(U1, sizeof(U1));
+    }
+
+    uint  CurCount[] = { Count-1, 16, 16 };
+    byte *CurValue[] = { Key    , V1, V2 };
+
+    for (uint I = 0; I < 3; I++) // For output key and 2 supplementary values.
+    {
+      for (uint J = 0; J < CurCount[I]; J++)
+      {
+        memcpy(W, U, sizeof(U));
+        memcpy(H, IState, sizeof(H));
+        sha256_transform_mb(H, W); // Inner digest.
+        memcpy(W, H, sizeof(H));
+        memcpy(H, RState, sizeof(H));
+        sha256_transform_mb(H, W); // Outer digest, new U.
+        memcpy(U, H, sizeof(U));
+        for (uint K = 0; K < 8; K++) // Function ^= U.
+          for (uint L = 0; L < Lanes; L++)
+            Fn[K][L] ^= U[K][L];
+      }
+      if (CurValue[I]!=NULL)
+        for (uint L = 0; L < Lanes && First + L < PwdCount; L++)
+          for (uint K = 0; K < 8; K++)
+            RawPutBE4(Fn[K][L], CurValue[I] + (First + L) * SHA256_DIGEST_SIZE + K * 4);
+    }
+  }
+
+  cleandata(SaltData, sizeof(SaltData));
+  cleandata(IState, sizeof(IState));
+  cleandata(RState, sizeof(RState));
+  cleandata(U, sizeof(U));
+  cleandata(Fn, sizeof(Fn));
+  cleandata(H, sizeof(H));
+  cleandata(W, sizeof(W));
 }
 
 
@@ -151,6 +279,63 @@ void CryptData::SetKey50(bool Encrypt,SecPassword *Password,const wchar *PwdW,
 }
 
 
+// Check several candidate passwords against RAR5 password check value.
+// If SHA-256 can process several buffers in parallel, KDF is calculated
+// for a group of passwords at once. Returns index of the first matching
+// password or -1 if none matches.
+int CheckPasswords50(SecPassword *Passwords,size_t PwdCount,const byte *Salt,
+                     uint Lg2Cnt,const byte *PswCheck)
+{
+  if (Lg2Cnt>CRYPT5_KDF_LG2_COUNT_MAX)
+    return -1;
+
+  const size_t GroupSize=sha256_mb_fast() ? SHA256_MB_LANES:1;
+
+  char PwdUtf[SHA256_MB_LANES][MAXPASSWORD*4];
+  const byte *Pwd[SHA256_MB_LANES];
+  size_t PwdLength[SHA256_MB_LANES];
+  byte PswCheckValue[SHA256_MB_LANES][SHA256_DIGEST_SIZE];
+
+  int Found=-1;
+  for (size_t First=0;First<PwdCount && Found<0;First+=GroupSize)
+  {
+    size_t Count=Min(GroupSize,PwdCount-First);
+    for (size_t I=0;I<Count;I++)
+    {
+      wchar PwdW[MAXPASSWORD];
+      Passwords[First+I].Get(PwdW,ASIZE(PwdW));
+      WideToUtf(PwdW,PwdUtf[I],ASIZE(PwdUtf[I]));
+      cleandata(PwdW,sizeof(PwdW));
+      Pwd[I]=(byte *)PwdUtf[I];
+      PwdLength[I]=strlen(PwdUtf[I]);
+    }
+
+    if (Count>1)
+      pbkdf2_mb(Pwd,PwdLength,Count,Salt,SIZE_SALT50,NULL,NULL,PswCheckValue[0],1<<Lg2Cnt);
+    else
+    {
+      byte Key[32],HashKeyValue[SHA256_DIGEST_SIZE];
+      pbkdf2(Pwd[0],PwdLength[0],Salt,SIZE_SALT50,Key,HashKeyValue,PswCheckValue[0],1<<Lg2Cnt);
+      cleandata(Key,sizeof(Key));
+      cleandata(HashKeyValue,sizeof(HashKeyValue));
+    }
+
+    for (size_t I=0;I<Count && Found<0;I++)
+    {
+      byte Check[SIZE_PSWCHECK];
+      memset(Check,0,sizeof(Check));
+      for (uint J=0;J<SHA256_DIGEST_SIZE;J++)
+        Check[J%SIZE_PSWCHECK]^=PswCheckValue[I][J];
+      if (memcmp(Check,PswCheck,SIZE_PSWCHECK)==0)
+        Found=int(First+I);
+    }
+  }
+  cleandata(PwdUtf,sizeof(PwdUtf));
+  cleandata(PswCheckValue,sizeof(PswCheckValue));
+  return Found;
+}
+
+
 void ConvertHashToMAC(HashValue *Value,byte *Key)
 {
   if (Value->Type==HASH_CRC32)
@@ -191,5 +376,27 @@ void TestPBKDF2() // Test PBKDF2 HMAC-SHA256
   pbkdf2((byte *)"just some long string pretending to be a password", 49, (byte *)"salt, salt, salt, a lot of salt", 31, Key, V1, V2, 65536);
   byte Res3[32]={0x08, 0x0f, 0xa3, 0x1d, 0x42, 0x2d, 0xb0, 0x47, 0x83, 0x9b, 0xce, 0x3a, 0x3b, 0xce, 0x49, 0x51, 0xe2, 0x62, 0xb9, 0xff, 0x76, 0x2f, 0x57, 0xe9, 0xc4, 0x71, 0x96, 0xce, 0x4b, 0x6b, 0x6e, 0xbf};
   mprintf(L"\nPBKDF2 test3: %s", memcmp(Key,Res3,32)==0 ? L"OK":L"Failed");
+
+  const byte *Pwd[3]={(byte *)"password",(byte *)"pass",(byte *)"password"};
+  size_t PwdLength[3]={8,4,8};
+  byte KeyMB[3][32];
+  pbkdf2_mb(Pwd, PwdLength, 3, (byte *)"salt", 4, KeyMB[0], NULL, NULL, 4096);
+  mprintf(L"\nPBKDF2 test4: %s", memcmp(KeyMB[0],Res2,32)==0 &&
+          memcmp(KeyMB[2],Res2,32)==0 && memcmp(KeyMB[1],Res2,32)!=0 ? L"OK":L"Failed");
+
+  // More candidates than SHA256_MB_LANES to check the last partial group.
+  byte Salt[SIZE_SALT50]={0},PswCheck[SIZE_PSWCHECK]={0};
+  pbkdf2((byte *)"pwd9", 4, Salt, SIZE_SALT50, Key, V1, V2, 1<<10);
+  for (uint I=0;I<SHA256_DIGEST_SIZE;I++)
+    PswCheck[I%SIZE_PSWCHECK]^=V2[I];
+  SecPassword Passwords[10];
+  for (uint I=0;I<ASIZE(Passwords);I++)
+  {
+    wchar PwdW[10];
+    swprintf(PwdW,ASIZE(PwdW),L"pwd%u",I);
+    Passwords[I].Set(PwdW);
+  }
+  mprintf(L"\nPBKDF2 test5: %s", CheckPasswords50(Passwords,ASIZE(Passwords),Salt,10,PswCheck)==9 &&
+          CheckPasswords50(Passwords,9,Salt,10,PswCheck)==-1 ? L"OK":L"Failed");
 }
 #endif
@@ -1,6 +1,18 @@
 #include "rar.hpp"
 
 
+// Messages and prompts are issued only in the main thread. Errors raised
+// in worker threads are thrown silently and reported by the main thread.
+static bool WorkerThread()
+{
+#if defined(RAR_SMP) && !defined(RARDLL)
+  return !IsMainThread();
+#else
+  return false;
+#endif
+}
+
+
 ErrorHandler::ErrorHandler()
 {
   Clean();
@@ -21,7 +33,8 @@ void ErrorHandler::Clean()
 
 void ErrorHandler::MemoryError()
 {
-  MemoryErrorMsg();
+  if (!WorkerThread())
+    MemoryErrorMsg();
   Throw(RARX_MEMORY);
 }
 
@@ -38,7 +51,7 @@ void ErrorHandler::OpenError(const wchar *FileName)
 void ErrorHandler::CloseError(const wchar *FileName)
 {
 #ifndef SILENT
-  if (!UserBreak)
+  if (!UserBreak && !WorkerThread())
   {
     Log(NULL,St(MErrFClose),FileName);
     SysErrMsg();
@@ -53,7 +66,8 @@ void ErrorHandler::CloseError(const wchar *FileName)
 void ErrorHandler::ReadError(const wchar *FileName)
 {
 #ifndef SILENT
-  ReadErrorMsg(FileName);
+  if (!WorkerThread())
+    ReadErrorMsg(FileName);
 #endif
 #if !defined(SILENT) || defined(RARDLL)
   Throw(RARX_FATAL);
@@ -64,7 +78,7 @@ void ErrorHandler::ReadError(const wchar *FileName)
 bool ErrorHandler::AskRepeatRead(const wchar *FileName)
 {
 #if !defined(SILENT) && !defined(SFX_MODULE)
-  if (!Silent)
+  if (!Silent && !WorkerThread())
   {
     SysErrMsg();
     mprintf(L"\n");
@@ -79,7 +93,8 @@ bool ErrorHandler::AskRepeatRead(const wchar *FileName)
 void ErrorHandler::WriteError(const wchar *ArcName,const wchar *FileName)
 {
 #ifndef SILENT
-  WriteErrorMsg(ArcName,FileName);
+  if (!WorkerThread())
+    WriteErrorMsg(ArcName,FileName);
 #endif
 #if !defined(SILENT) || defined(RARDLL)
   Throw(RARX_WRITE);
@@ -104,7 +119,7 @@ void ErrorHandler::WriteErrorFAT(const wchar *FileName)
 bool ErrorHandler::AskRepeatWrite(const wchar *FileName,bool DiskFull)
 {
 #ifndef SILENT
-  if (!Silent)
+  if (!Silent && !WorkerThread())
   {
     SysErrMsg();
     mprintf(L"\n");
@@ -119,7 +134,7 @@ bool ErrorHandler::AskRepeatWrite(const wchar *FileName,bool DiskFull)
 void ErrorHandler::SeekError(const wchar *FileName)
 {
 #ifndef SILENT
-  if (!UserBreak)
+  if (!UserBreak && !WorkerThread())
   {
     Log(NULL,St(MErrSeek),FileName);
     SysErrMsg();
@@ -239,7 +254,8 @@ void ErrorHandler::WriteErrorMsg(const wchar *ArcName,const wchar *FileName)
 void ErrorHandler::Exit(RAR_EXIT ExitCode)
 {
 #ifndef GUI
-  Alarm();
+  if (!WorkerThread())
+    Alarm();
 #endif
   Throw(ExitCode);
 }
@@ -337,6 +353,8 @@ void ErrorHandler::Throw(RAR_EXIT Code)
 {
   if (Code==RARX_USERBREAK && !EnableBreak)
     return;
+  if (WorkerThread()) // Caller in main thread reports it.
+    throw Code;
 #if !defined(GUI) && !defined(SILENT)
   // Do not write "aborted" when just displaying online help.
   if (Code!=RARX_SUCCESS && Code!=RARX_USERERROR)
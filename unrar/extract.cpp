@@ -12,11 +12,22 @@ CmdExtract::CmdExtract(CommandData *Cmd)
 #ifdef RAR_SMP
   Unp->SetThreads(Cmd->Threads);
 #endif
+#ifdef RAR_EXTRACT_MT
+  JobPool=NULL;
+  JobCount=0;
+#endif
 }
 
 
 CmdExtract::~CmdExtract()
 {
+#ifdef RAR_EXTRACT_MT
+  // Jobs can be still running if we exit because of error,
+  // so we wait for them before deleting.
+  delete JobPool;
+  for (size_t I=0;I<Jobs.Size();I++)
+    delete Jobs[I];
+#endif
   delete Unp;
 }
 
@@ -205,6 +216,10 @@ EXTRACT_ARC_CODE CmdExtract::ExtractArchive(CommandData *Cmd)
         break;
   }
 
+#ifdef RAR_EXTRACT_MT
+  FinishJobs(Cmd);
+  CloseJobs();
+#endif
 
   return EXTRACT_ARC_NEXT;
 }
@@ -213,6 +228,12 @@ EXTRACT_ARC_CODE CmdExtract::ExtractArchive(CommandData *Cmd)
 bool CmdExtract::ExtractCurrentFile(CommandData *Cmd,Archive &Arc,size_t HeaderSize,bool &Repeat)
 {
   wchar Command=Cmd->Command[0];
+#ifdef RAR_EXTRACT_MT
+  // Complete queued files before processing anything, which can depend
+  // on their results or display messages.
+  if (HeaderSize==0 || Arc.GetHeaderType()!=HEAD_FILE || !IsParallelFile(Cmd,Arc))
+    FinishJobs(Cmd);
+#endif
   if (HeaderSize==0)
     if (DataIO.UnpVolume)
     {
@@ -456,7 +477,16 @@ bool CmdExtract::ExtractCurrentFile(CommandData *Cmd,Archive &Arc,size_t HeaderS
       }
       else
         if (ExtrFile) // Create files and file copies (FSREDIR_FILECOPY).
-          ExtrFile=ExtrCreateFile(Cmd,Arc,CurFile);
+#ifdef RAR_EXTRACT_MT
+          if (IsParallelFile(Cmd,Arc) && QueueFile(Cmd,Arc,ArcFileName))
+          {
+            // Queued file is unpacked in worker thread, so we proceed
+            // to next header as for not extracted file.
+            ExtrFile=false;
+          }
+          else
+#endif
+            ExtrFile=ExtrCreateFile(Cmd,Arc,CurFile);
 
     if (!ExtrFile && Arc.Solid)
     {
@@ -588,7 +618,7 @@ bool CmdExtract::ExtractCurrentFile(CommandData *Cmd,Archive &Arc,size_t HeaderS
             UnstoreFile(DataIO,Arc.FileHead.UnpSize);
           else
           {
-            Unp->Init(Arc.FileHead.WinSize,Arc.FileHead.Solid);
+            Unp->Init(GetUnpWinSize(Arc),Arc.FileHead.Solid);
             Unp->SetDestSize(Arc.FileHead.UnpSize);
 #ifndef SFX_MODULE
             if (Arc.Format!=RARFMT50 && Arc.FileHead.UnpVer<=15)
@@ -656,36 +686,7 @@ bool CmdExtract::ExtractCurrentFile(CommandData *Cmd,Archive &Arc,size_t HeaderS
           (!LinkEntry || Arc.FileHead.RedirType==FSREDIR_FILECOPY && LinkSuccess) && 
           (!BrokenFile || Cmd->KeepBroken))
       {
-        // We could preallocate more space that really written to broken file.
-        if (BrokenFile)
-          CurFile.Truncate();
-
-#if defined(_WIN_ALL) || defined(_EMX)
-        if (Cmd->ClearArc)
-          Arc.FileHead.FileAttr&=~FILE_ATTRIBUTE_ARCHIVE;
-#endif
-
-
-        CurFile.SetOpenFileTime(
-          Cmd->xmtime==EXTTIME_NONE ? NULL:&Arc.FileHead.mtime,
-          Cmd->xctime==EXTTIME_NONE ? NULL:&Arc.FileHead.ctime,
-          Cmd->xatime==EXTTIME_NONE ? NULL:&Arc.FileHead.atime);
-        CurFile.Close();
-#if defined(_WIN_ALL) && !defined(SFX_MODULE)
-        if (Cmd->SetCompressedAttr &&
-            (Arc.FileHead.FileAttr & FILE_ATTRIBUTE_COMPRESSED)!=0)
-          SetFileCompression(CurFile.FileName,true);
-#endif
-#ifdef _UNIX
-        if (Cmd->ProcessOwners && Arc.Format==RARFMT50 && Arc.FileHead.UnixOwnerSet)
-          SetUnixOwner(Arc,CurFile.FileName);
-#endif
-
-        CurFile.SetCloseFileTime(
-          Cmd->xmtime==EXTTIME_NONE ? NULL:&Arc.FileHead.mtime,
-          Cmd->xatime==EXTTIME_NONE ? NULL:&Arc.FileHead.atime);
-        if (!Cmd->IgnoreGeneralAttr)
-          SetFileAttr(CurFile.FileName,Arc.FileHead.FileAttr);
+        ExtrCloseFile(Cmd,Arc,CurFile,BrokenFile);
         PrevExtracted=true;
       }
     }
@@ -704,6 +705,42 @@ bool CmdExtract::ExtractCurrentFile(CommandData *Cmd,Archive &Arc,size_t HeaderS
 }
 
 
+// Set times and attributes of extracted file and close it.
+void CmdExtract::ExtrCloseFile(CommandData *Cmd,Archive &Arc,File &CurFile,bool BrokenFile)
+{
+  // We could preallocate more space that really written to broken file.
+  if (BrokenFile)
+    CurFile.Truncate();
+
+#if defined(_WIN_ALL) || defined(_EMX)
+  if (Cmd->ClearArc)
+    Arc.FileHead.FileAttr&=~FILE_ATTRIBUTE_ARCHIVE;
+#endif
+
+
+  CurFile.SetOpenFileTime(
+    Cmd->xmtime==EXTTIME_NONE ? NULL:&Arc.FileHead.mtime,
+    Cmd->xctime==EXTTIME_NONE ? NULL:&Arc.FileHead.ctime,
+    Cmd->xatime==EXTTIME_NONE ? NULL:&Arc.FileHead.atime);
+  CurFile.Close();
+#if defined(_WIN_ALL) && !defined(SFX_MODULE)
+  if (Cmd->SetCompressedAttr &&
+      (Arc.FileHead.FileAttr & FILE_ATTRIBUTE_COMPRESSED)!=0)
+    SetFileCompression(CurFile.FileName,true);
+#endif
+#ifdef _UNIX
+  if (Cmd->ProcessOwners && Arc.Format==RARFMT50 && Arc.FileHead.UnixOwnerSet)
+    SetUnixOwner(Arc,CurFile.FileName);
+#endif
+
+  CurFile.SetCloseFileTime(
+    Cmd->xmtime==EXTTIME_NONE ? NULL:&Arc.FileHead.mtime,
+    Cmd->xatime==EXTTIME_NONE ? NULL:&Arc.FileHead.atime);
+  if (!Cmd->IgnoreGeneralAttr)
+    SetFileAttr(CurFile.FileName,Arc.FileHead.FileAttr);
+}
+
+
 void CmdExtract::UnstoreFile(ComprDataIO &DataIO,int64 DestUnpSize)
 {
   Array<byte> Buffer(0x40000);
@@ -1061,3 +1098,281 @@ bool CmdExtract::CheckUnpVer(Archive &Arc,const wchar *ArcFileName)
   }
   return !WrongVer;
 }
+
+
+// File in non-solid archive cannot refer to data beyond its own size,
+// so we do not allocate more than needed for small files.
+// Window size must be a power of 2.
+size_t CmdExtract::GetUnpWinSize(Archive &Arc)
+{
+  FileHeader *hd=&Arc.FileHead;
+  size_t WinSize=hd->WinSize;
+  if (!Arc.Solid && !hd->Solid && !hd->UnknownUnpSize)
+    while (WinSize>1 && (uint64)hd->UnpSize<=WinSize/2)
+      WinSize/=2;
+  return WinSize;
+}
+
+
+#ifdef RAR_EXTRACT_MT
+ExtractJob::ExtractJob(CommandData *Cmd):Arc(Cmd)
+{
+  Unp=new Unpack(&DataIO);
+  Unp->SetThreads(1); // Threads are already used by parallel jobs.
+  DataIO.EnableShowProgress(false);
+  CurFile=NULL;
+  *ArcFileName=0;
+  *DestFileName=0;
+  DataPos=0;
+  TestMode=false;
+  ErrCode=RARX_SUCCESS;
+  SysErrCode=0;
+}
+
+
+ExtractJob::~ExtractJob()
+{
+  delete CurFile; // Deletes incomplete file if we exit because of error.
+  delete Unp;
+}
+
+
+THREAD_PROC(ExtractJobThread)
+{
+  CmdExtract::UnpackJob((ExtractJob *)Data);
+}
+
+
+// Check if file can be unpacked independently from other files.
+bool CmdExtract::IsParallelFile(CommandData *Cmd,Archive &Arc)
+{
+  wchar Command=Cmd->Command[0];
+  FileHeader *hd=&Arc.FileHead;
+  return Cmd->Threads>1 && (Command=='X' || Command=='E' || Command=='T') &&
+         !Arc.Solid && !Arc.Volume && !hd->Solid && !hd->Encrypted &&
+         !hd->SplitBefore && !hd->SplitAfter && !Arc.IsArcDir() &&
+         hd->RedirType==FSREDIR_NONE && !hd->UnknownUnpSize &&
+         hd->UnpSize<=EXTRACT_MT_MAX_SIZE;
+}
+
+
+// Create the destination file and start unpacking it in worker thread.
+// Return false if file must be extracted in main thread.
+bool CmdExtract::QueueFile(CommandData *Cmd,Archive &Arc,const wchar *ArcFileName)
+{
+  // Overwrite prompt must not be mixed with messages of queued files.
+  if (JobCount>=Cmd->Threads ||
+      (Cmd->Overwrite==OVERWRITE_DEFAULT && FileExist(DestFileName)))
+  {
+    // FinishJobs sets DestFileName to name of last finished file.
+    wchar CurDestName[NM];
+    wcsncpyz(CurDestName,DestFileName,ASIZE(CurDestName));
+    FinishJobs(Cmd);
+    wcsncpyz(DestFileName,CurDestName,ASIZE(DestFileName));
+  }
+
+  if (JobPool==NULL)
+    JobPool=new ThreadPool(Cmd->Threads);
+  if (JobCount==Jobs.Size())
+    Jobs.Push(new ExtractJob(Cmd));
+  ExtractJob *Job=Jobs[JobCount];
+
+  Archive &JobArc=Job->Arc;
+  if (!JobArc.IsOpened() || wcscmp(JobArc.FileName,Arc.FileName)!=0)
+  {
+    JobArc.Close();
+    if (!JobArc.Open(Arc.FileName))
+      return false;
+  }
+
+  Job->CurFile=new File;
+  if (!ExtrCreateFile(Cmd,Arc,*Job->CurFile))
+  {
+    delete Job->CurFile;
+    Job->CurFile=NULL;
+    return true;
+  }
+
+  Job->TestMode=Cmd->Test;
+  if (!Job->TestMode && Job->CurFile->IsDevice())
+  {
+    Log(Arc.FileName,St(MInvalidName),DestFileName);
+    ErrHandler.WriteError(Arc.FileName,DestFileName);
+  }
+  TotalFileCount++;
+  FileCount++;
+
+  JobArc.FileHead=Arc.FileHead;
+  JobArc.Format=Arc.Format;
+  Job->DataPos=Arc.NextBlockPos-Arc.FileHead.PackSize;
+  wcsncpyz(Job->ArcFileName,ArcFileName,ASIZE(Job->ArcFileName));
+  wcsncpyz(Job->DestFileName,DestFileName,ASIZE(Job->DestFileName));
+  InitJob(Job);
+  if (!Job->TestMode && !Arc.BrokenHeader &&
+      (Arc.FileHead.PackSize<<11)>Arc.FileHead.UnpSize)
+    Job->CurFile->Prealloc(Arc.FileHead.UnpSize);
+  Job->CurFile->SetAllowDelete(!Cmd->KeepBroken);
+
+  JobCount++;
+  JobPool->AddTask(ExtractJobThread,(void *)Job);
+  JobPool->StartTasks();
+  return true;
+}
+
+
+// Prepare the job to unpack its file from beginning of packed data.
+void CmdExtract::InitJob(ExtractJob *Job)
+{
+  Archive &JobArc=Job->Arc;
+  FileHeader *hd=&JobArc.FileHead;
+  JobArc.ErrorType=FILE_SUCCESS;
+  JobArc.Seek(Job->DataPos,SEEK_SET);
+  Job->ErrCode=RARX_SUCCESS;
+  Job->SysErrCode=0;
+
+  ComprDataIO &JobIO=Job->DataIO;
+  JobIO.CurUnpRead=0;
+  JobIO.CurUnpWrite=0;
+  JobIO.UnpHash.Init(hd->FileHash.Type,1);
+  JobIO.PackedDataHash.Init(hd->FileHash.Type,1);
+  JobIO.SetPackedSizeToRead(hd->PackSize);
+  JobIO.SetFiles(&JobArc,Job->CurFile);
+  JobIO.SetTestMode(Job->TestMode);
+  JobIO.SetSkipUnpCRC(false);
+}
+
+
+void CmdExtract::DoUnpackJob(ExtractJob *Job)
+{
+  FileHeader *hd=&Job->Arc.FileHead;
+  if (hd->Method==0)
+    UnstoreFile(Job->DataIO,hd->UnpSize);
+  else
+  {
+    Job->Unp->Init(GetUnpWinSize(Job->Arc),false);
+    Job->Unp->SetDestSize(hd->UnpSize);
+    if (Job->Arc.Format!=RARFMT50 && hd->UnpVer<=15)
+      Job->Unp->DoUnpack(15,false);
+    else
+      Job->Unp->DoUnpack(hd->UnpVer,false);
+  }
+}
+
+
+// Unpack the queued file. Called in worker thread, where ErrHandler
+// does not display messages and prompts, so errors are passed
+// to main thread in ErrCode.
+void CmdExtract::UnpackJob(ExtractJob *Job)
+{
+  try
+  {
+    DoUnpackJob(Job);
+  }
+  catch (RAR_EXIT ErrCode)
+  {
+    Job->ErrCode=ErrCode;
+    Job->SysErrCode=ErrHandler.GetSystemErrorCode();
+  }
+  catch (std::bad_alloc &)
+  {
+    Job->ErrCode=RARX_MEMORY;
+  }
+}
+
+
+// Wait for queued files and complete them in archive order.
+void CmdExtract::FinishJobs(CommandData *Cmd)
+{
+  if (JobCount==0)
+    return;
+  JobPool->WaitDone();
+  size_t Count=JobCount;
+  JobCount=0;
+  for (size_t I=0;I<Count;I++)
+    FinishJob(Cmd,Jobs[I]);
+}
+
+
+// Check the unpacked file, display the result and close the file
+// same as it is done for files extracted in main thread.
+void CmdExtract::FinishJob(CommandData *Cmd,ExtractJob *Job)
+{
+  if (Job->CurFile==NULL) // File was not created.
+    return;
+  Archive &JobArc=Job->Arc;
+  PrevExtracted=false;
+  wcsncpyz(DestFileName,Job->DestFileName,ASIZE(DestFileName));
+#ifndef GUI
+  if (Job->TestMode)
+    mprintf(St(MExtrTestFile),Job->ArcFileName);
+  else
+    mprintf(St(MExtrFile),Job->DestFileName);
+#endif
+  if (Job->ErrCode!=RARX_SUCCESS)
+  {
+    // Display the message or prompt skipped in worker thread. If user
+    // chooses to retry, unpack the file again in main thread, where
+    // further errors are handled as usual.
+    ErrHandler.SetSystemErrorCode(Job->SysErrCode);
+    bool ReadError=JobArc.ErrorType==FILE_READERROR;
+    while (true)
+    {
+      if (ReadError)
+      {
+        if (!ErrHandler.AskRepeatRead(JobArc.FileName))
+          ErrHandler.ReadError(JobArc.FileName);
+      }
+      else
+        if (Job->ErrCode==RARX_WRITE)
+        {
+          if (!ErrHandler.AskRepeatWrite(Job->CurFile->FileName,false))
+            ErrHandler.WriteError(NULL,Job->CurFile->FileName);
+        }
+        else
+        {
+          if (Job->ErrCode==RARX_MEMORY)
+            ErrHandler.MemoryError();
+          ErrHandler.Exit(Job->ErrCode);
+        }
+#ifndef _WIN_ALL
+      if (Job->CurFile->IsOpened())
+        clearerr(Job->CurFile->GetHandle());
+#endif
+      // Seek flushes data left in write buffer, so it can fail again.
+      if (Job->CurFile->RawSeek(0,SEEK_SET))
+        break;
+    }
+    InitJob(Job);
+    DoUnpackJob(Job);
+  }
+
+  FileHeader *hd=&JobArc.FileHead;
+  bool BrokenFile=!Job->DataIO.UnpHash.Cmp(&hd->FileHash,hd->UseHashKey ? hd->HashKey:NULL);
+  if (BrokenFile)
+  {
+    Log(JobArc.FileName,St(MCRCFailed),Job->ArcFileName);
+    ErrHandler.SetErrorCode(RARX_CRC);
+  }
+#ifndef GUI
+  else
+    mprintf(L" %s ",hd->FileHash.Type==HASH_NONE ? L"  ?":St(MOk));
+#endif
+
+  if (!Job->TestMode && (!BrokenFile || Cmd->KeepBroken))
+  {
+    ExtrCloseFile(Cmd,JobArc,*Job->CurFile,BrokenFile);
+    PrevExtracted=true;
+  }
+
+  // Close the file or delete it if it is broken.
+  delete Job->CurFile;
+  Job->CurFile=NULL;
+}
+
+
+void CmdExtract::CloseJobs()
+{
+  for (size_t I=0;I<Jobs.Size();I++)
+    Jobs[I]->Arc.Close();
+}
+#endif
@@ -3,6 +3,33 @@
 
 enum EXTRACT_ARC_CODE {EXTRACT_ARC_NEXT,EXTRACT_ARC_REPEAT};
 
+#if defined(RAR_SMP) && !defined(RARDLL) && !defined(SFX_MODULE)
+#define RAR_EXTRACT_MT // Extract independent files in parallel threads.
+
+// Maximum unpacked size of file extracted in parallel. Larger files
+// are extracted one by one, so their unpack code can use all threads.
+const int64 EXTRACT_MT_MAX_SIZE=0x1000000;
+
+// File of non-solid archive extracted in worker thread. Every job has
+// its own archive handle, unpack object and destination file.
+struct ExtractJob
+{
+  ExtractJob(CommandData *Cmd);
+  ~ExtractJob();
+
+  Archive Arc; // Contains the copy of file header.
+  ComprDataIO DataIO;
+  Unpack *Unp;
+  File *CurFile;
+  wchar ArcFileName[NM];
+  wchar DestFileName[NM];
+  int64 DataPos; // Packed data position in archive.
+  bool TestMode;
+  RAR_EXIT ErrCode; // Worker thread error reported in main thread.
+  int SysErrCode; // System error code for worker thread error message.
+};
+#endif
+
 class CmdExtract
 {
   private:
@@ -19,7 +46,22 @@ class CmdExtract
 #endif
     void ExtrCreateDir(CommandData *Cmd,Archive &Arc,const wchar *ArcFileName);
     bool ExtrCreateFile(CommandData *Cmd,Archive &Arc,File &CurFile);
+    void ExtrCloseFile(CommandData *Cmd,Archive &Arc,File &CurFile,bool BrokenFile);
     bool CheckUnpVer(Archive &Arc,const wchar *ArcFileName);
+    static size_t GetUnpWinSize(Archive &Arc);
+#ifdef RAR_EXTRACT_MT
+    bool IsParallelFile(CommandData *Cmd,Archive &Arc);
+    bool QueueFile(CommandData *Cmd,Archive &Arc,const wchar *ArcFileName);
+    static void InitJob(ExtractJob *Job);
+    static void DoUnpackJob(ExtractJob *Job);
+    void FinishJobs(CommandData *Cmd);
+    void FinishJob(CommandData *Cmd,ExtractJob *Job);
+    void CloseJobs();
+
+    ThreadPool *JobPool;
+    Array<ExtractJob *> Jobs;
+    size_t JobCount; // Number of started jobs.
+#endif
 
     RarTime StartTime; // time when extraction started
 
@@ -54,6 +96,9 @@ class CmdExtract
     bool ExtractCurrentFile(CommandData *Cmd,Archive &Arc,size_t HeaderSize,
                             bool &Repeat);
     static void UnstoreFile(ComprDataIO &DataIO,int64 DestUnpSize);
+#ifdef RAR_EXTRACT_MT
+    static void UnpackJob(ExtractJob *Job);
+#endif
 };
 
 #endif
@@ -13,10 +13,20 @@ File::File()
   OpenShared=false;
   AllowDelete=true;
   AllowExceptions=true;
+  AllowMap=false;
 #ifdef _WIN_ALL
   NoSequentialRead=false;
   CreateMode=FMF_UNDEFINED;
 #endif
+#ifdef USE_MMAP_READ
+  MapData=NULL;
+  MapSize=MapPos=MapAdvised=0;
+#endif
+#ifdef USE_RAW_WRITE
+  UseWriteBuf=false;
+  WriteBufUsed=0;
+  RawWritePos=SyncPos=0;
+#endif
 }
 
 
@@ -36,6 +46,18 @@ void File::operator = (File &SrcFile)
   NewFile=SrcFile.NewFile;
   LastWrite=SrcFile.LastWrite;
   HandleType=SrcFile.HandleType;
+#ifdef USE_MMAP_READ
+  MapData=SrcFile.MapData;
+  MapSize=SrcFile.MapSize;
+  MapPos=SrcFile.MapPos;
+  MapAdvised=SrcFile.MapAdvised;
+#endif
+#ifdef USE_RAW_WRITE
+  SrcFile.FlushWriteBuf();
+  UseWriteBuf=SrcFile.UseWriteBuf;
+  RawWritePos=SrcFile.RawWritePos;
+  SyncPos=SrcFile.SyncPos;
+#endif
   SrcFile.SkipClose=true;
 }
 
@@ -122,11 +144,44 @@ bool File::Open(const wchar *Name,uint Mode)
   {
     hFile=hNewFile;
     wcsncpyz(FileName,Name,ASIZE(FileName));
+#ifdef USE_MMAP_READ
+    if (AllowMap && !UpdateMode && !WriteMode)
+      MapFile();
+#endif
   }
   return Success;
 }
 
 
+#ifdef USE_MMAP_READ
+// Map the entire file to memory for reading. It saves the stdio buffer copy
+// and read calls, especially for numerous small archive header reads.
+// Pipes and devices are still read with stdio.
+bool File::MapFile()
+{
+  struct stat st;
+  int fd=fileno(hFile);
+  if (fd<0 || fstat(fd,&st)!=0 || !S_ISREG(st.st_mode) || st.st_size==0)
+    return false;
+
+  // Do not waste the 32-bit address space needed for unpack dictionary.
+  if (sizeof(size_t)<8 && st.st_size>=0x40000000)
+    return false;
+
+  void *Addr=mmap(NULL,(size_t)st.st_size,PROT_READ,MAP_SHARED,fd,0);
+  if (Addr==MAP_FAILED)
+    return false;
+#ifdef MADV_SEQUENTIAL
+  madvise(Addr,(size_t)st.st_size,MADV_SEQUENTIAL);
+#endif
+  MapData=(byte *)Addr;
+  MapSize=st.st_size;
+  MapPos=MapAdvised=0;
+  return true;
+}
+#endif
+
+
 #if !defined(SHELL_EXT) && !defined(SFX_MODULE)
 void File::TOpen(const wchar *Name)
 {
@@ -170,6 +225,14 @@ bool File::Create(const wchar *Name,uint Mode)
   char NameA[NM];
   WideToChar(Name,NameA,ASIZE(NameA));
   hFile=fopen(NameA,WriteMode ? WRITEBINARY:CREATEBINARY);
+#ifdef USE_RAW_WRITE
+  // We never read write only files, so we can write them bypassing stdio.
+  struct stat st;
+  UseWriteBuf=hFile!=BAD_HANDLE && WriteMode && fstat(fileno(hFile),&st)==0 &&
+              S_ISREG(st.st_mode);
+  WriteBufUsed=0;
+  RawWritePos=SyncPos=0;
+#endif
 #endif
   NewFile=true;
   HandleType=FILE_HANDLENORMAL;
@@ -204,6 +267,15 @@ bool File::Close()
 
   if (hFile!=BAD_HANDLE)
   {
+#ifdef USE_MMAP_READ
+    if (MapData!=NULL && !SkipClose)
+      munmap(MapData,(size_t)MapSize);
+    MapData=NULL;
+#endif
+#ifdef USE_RAW_WRITE
+    if (UseWriteBuf && !SkipClose && !FlushWriteBuf())
+      Success=false;
+#endif
     if (!SkipClose)
     {
 #ifdef _WIN_ALL
@@ -212,12 +284,17 @@ bool File::Close()
       if (HandleType==FILE_HANDLENORMAL)
         Success=CloseHandle(hFile)==TRUE;
 #else
-      Success=fclose(hFile)!=EOF;
+      if (fclose(hFile)==EOF)
+        Success=false;
 #endif
     }
     hFile=BAD_HANDLE;
   }
   HandleType=FILE_HANDLENORMAL;
+#ifdef USE_RAW_WRITE
+  UseWriteBuf=false;
+  WriteBufUsed=0;
+#endif
   if (!Success && AllowExceptions)
     ErrHandler.CloseError(FileName);
   return Success;
@@ -229,6 +306,10 @@ void File::Flush()
 #ifdef _WIN_ALL
   FlushFileBuffers(hFile);
 #else
+#ifdef USE_RAW_WRITE
+  if (UseWriteBuf)
+    FlushWriteBuf();
+#endif
   fflush(hFile);
 #endif
 }
@@ -238,6 +319,9 @@ bool File::Delete()
 {
   if (HandleType!=FILE_HANDLENORMAL)
     return false;
+#ifdef USE_RAW_WRITE
+  WriteBufUsed=0; // No need to write data of deleted file.
+#endif
   if (hFile!=BAD_HANDLE)
     Close();
   if (!AllowDelete)
@@ -261,10 +345,10 @@ bool File::Rename(const wchar *NewName)
 }
 
 
-void File::Write(const void *Data,size_t Size)
+bool File::Write(const void *Data,size_t Size)
 {
   if (Size==0)
-    return;
+    return true;
   if (HandleType==FILE_HANDLESTD)
   {
 #ifdef _WIN_ALL
@@ -294,8 +378,24 @@ void File::Write(const void *Data,size_t Size)
     else
       Success=WriteFile(hFile,Data,(DWORD)Size,&Written,NULL)==TRUE;
 #else
-    int Written=fwrite(Data,1,Size,hFile);
-    Success=Written==Size && !ferror(hFile);
+    int Written;
+#ifdef USE_RAW_WRITE
+    if (UseWriteBuf)
+    {
+      // Not written data stay in buffer, so if user asks to repeat,
+      // we continue from first not accepted byte without seeking back.
+      size_t Done=BufWrite(Data,Size);
+      Success=Done==Size;
+      Data=(const byte *)Data+Done;
+      Size-=Done;
+      Written=0;
+    }
+    else
+#endif
+    {
+      Written=fwrite(Data,1,Size,hFile);
+      Success=Written==Size && !ferror(hFile);
+    }
 #endif
     if (!Success && AllowExceptions && HandleType==FILE_HANDLENORMAL)
     {
@@ -318,10 +418,92 @@ void File::Write(const void *Data,size_t Size)
       }
       ErrHandler.WriteError(NULL,FileName);
     }
-    break;
+    LastWrite=true;
+    return Success;
+  }
+}
+
+
+#ifdef USE_RAW_WRITE
+// Collect small blocks in buffer and write large blocks directly.
+// Return the number of bytes written or stored in buffer.
+size_t File::BufWrite(const void *Data,size_t Size)
+{
+  if (WriteBuf.Size()==0)
+    WriteBuf.Alloc(WriteBufSize);
+  const byte *Src=(const byte *)Data;
+  size_t Done=0;
+  while (Done<Size)
+  {
+    if (WriteBufUsed==0 && Size-Done>=WriteBufSize)
+    {
+      // Write whole buffer sized blocks without copying.
+      size_t BlockSize=(Size-Done) & ~(WriteBufSize-1);
+      size_t Written=RawWrite(Src+Done,BlockSize);
+      Done+=Written;
+      if (Written<BlockSize)
+        break;
+      continue;
+    }
+    size_t CopySize=Min(Size-Done,WriteBufSize-WriteBufUsed);
+    memcpy(&WriteBuf[WriteBufUsed],Src+Done,CopySize);
+    WriteBufUsed+=CopySize;
+    Done+=CopySize;
+    if (WriteBufUsed==WriteBufSize && !FlushWriteBuf())
+      break;
+  }
+  return Done;
+}
+
+
+// Return the number of written bytes, which is less than Size
+// only in case of error.
+size_t File::RawWrite(const void *Data,size_t Size)
+{
+  int fd=fileno(hFile);
+  size_t Done=0;
+  while (Done<Size)
+  {
+    ssize_t Written=write(fd,(const byte *)Data+Done,Size-Done);
+    if (Written<0 && errno==EINTR)
+      continue;
+    if (Written<=0)
+      break;
+    Done+=Written;
+  }
+  RawWritePos+=Done;
+#ifdef USE_SYNC_FILE_RANGE
+  // Start writeback of completed area. Wait only for the area written
+  // SyncWaitSize bytes ago, which is usually on disk already. So amount
+  // of dirty pages stays limited and we do not stall the entire system
+  // when kernel flushes gigabytes of them.
+  while (RawWritePos>=SyncMinSize && RawWritePos-SyncPos>=(int64)SyncRangeSize)
+  {
+    sync_file_range(fd,SyncPos,SyncRangeSize,SYNC_FILE_RANGE_WRITE);
+    if (SyncPos>=SyncWaitSize)
+      sync_file_range(fd,SyncPos-SyncWaitSize,SyncRangeSize,
+                      SYNC_FILE_RANGE_WAIT_BEFORE|SYNC_FILE_RANGE_WRITE|
+                      SYNC_FILE_RANGE_WAIT_AFTER);
+    SyncPos+=SyncRangeSize;
   }
-  LastWrite=true;
+#endif
+  return Done;
+}
+
+
+bool File::FlushWriteBuf()
+{
+  if (WriteBufUsed==0)
+    return true;
+  size_t Written=RawWrite(&WriteBuf[0],WriteBufUsed);
+  WriteBufUsed-=Written;
+
+  // Keep not written data for next attempt.
+  if (WriteBufUsed>0)
+    memmove(&WriteBuf[0],&WriteBuf[Written],WriteBufUsed);
+  return WriteBufUsed==0;
 }
+#endif
 
 
 int File::Read(void *Data,size_t Size)
@@ -402,6 +584,29 @@ int File::DirectRead(void *Data,size_t Size)
   }
   return Read;
 #else
+#ifdef USE_MMAP_READ
+  if (MapData!=NULL)
+  {
+    if (MapPos>=MapSize)
+      return 0;
+    size_t ReadSize=(size_t)Min((int64)Size,MapSize-MapPos);
+
+    // Ask the system to read the current and next areas in background,
+    // so we do not wait for page faults when accessing them.
+#ifdef MADV_WILLNEED
+    int64 AheadEnd=Min(((MapPos+(int64)ReadSize)&~int64(MapReadAhead-1))+2*int64(MapReadAhead),MapSize);
+    if (AheadEnd>MapAdvised)
+    {
+      int64 AheadStart=Max(MapAdvised,MapPos&~int64(MapReadAhead-1));
+      madvise(MapData+AheadStart,size_t(AheadEnd-AheadStart),MADV_WILLNEED);
+      MapAdvised=AheadEnd;
+    }
+#endif
+    memcpy(Data,MapData+MapPos,ReadSize);
+    MapPos+=ReadSize;
+    return (int)ReadSize;
+  }
+#endif
   if (LastWrite)
   {
     fflush(hFile);
@@ -432,12 +637,37 @@ bool File::RawSeek(int64 Offset,int Method)
     Offset=(Method==SEEK_CUR ? Tell():FileLength())+Offset;
     Method=SEEK_SET;
   }
+#ifdef USE_MMAP_READ
+  if (MapData!=NULL)
+  {
+    if (Method==SEEK_CUR)
+      Offset+=MapPos;
+    if (Method==SEEK_END)
+      Offset+=MapSize;
+    if (Offset<0)
+      return false;
+    MapPos=Offset;
+    return true;
+  }
+#endif
 #ifdef _WIN_ALL
   LONG HighDist=(LONG)(Offset>>32);
   if (SetFilePointer(hFile,(LONG)Offset,&HighDist,Method)==0xffffffff &&
       GetLastError()!=NO_ERROR)
     return false;
 #else
+#ifdef USE_RAW_WRITE
+  if (UseWriteBuf)
+  {
+    if (!FlushWriteBuf())
+      return false;
+    off_t NewPos=lseek(fileno(hFile),Offset,Method);
+    if (NewPos==-1)
+      return false;
+    RawWritePos=NewPos;
+    return true;
+  }
+#endif
   LastWrite=false;
 #if defined(_LARGEFILE_SOURCE) && !defined(_OSF_SOURCE) && !defined(__VMS)
   if (fseeko(hFile,Offset,Method)!=0)
@@ -457,6 +687,14 @@ int64 File::Tell()
       ErrHandler.SeekError(FileName);
     else
       return -1;
+#ifdef USE_MMAP_READ
+  if (MapData!=NULL)
+    return MapPos;
+#endif
+#ifdef USE_RAW_WRITE
+  if (UseWriteBuf)
+    return RawWritePos+WriteBufUsed;
+#endif
 #ifdef _WIN_ALL
   LONG HighDist=0;
   uint LowDist=SetFilePointer(hFile,0,&HighDist,FILE_CURRENT);
@@ -487,11 +725,16 @@ void File::Prealloc(int64 Size)
 #endif
 
 #if defined(_UNIX) && defined(USE_FALLOCATE)
-  // fallocate is rather new call. Only latest kernels support it.
-  // So we are not using it by default yet.
-  int fd = fileno(hFile);
-  if (fd >= 0)
-    fallocate(fd, 0, 0, Size);
+  // Reserve space without changing the file size, so we do not leave
+  // zero padded file if extraction fails. fallocate fails harmlessly
+  // for file systems not supporting it. Stdout handle is not opened
+  // until first write, so check for BAD_HANDLE.
+  if (hFile!=BAD_HANDLE && HandleType==FILE_HANDLENORMAL)
+  {
+    int fd = fileno(hFile);
+    if (fd >= 0)
+      fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, Size);
+  }
 #endif
 }
 
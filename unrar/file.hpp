@@ -50,9 +50,44 @@ class File
 #ifdef _WIN_ALL
     bool NoSequentialRead;
     uint CreateMode;
+#endif
+#ifdef USE_MMAP_READ
+    bool MapFile();
+
+    byte *MapData; // Mapped file data or NULL if file is read with stdio.
+    int64 MapSize;
+    int64 MapPos;
+    int64 MapAdvised; // End of area requested to be read ahead.
+
+    // Size of read ahead area requested at once. Must be a power of 2.
+    static const size_t MapReadAhead=0x400000;
+#endif
+#ifdef USE_RAW_WRITE
+    size_t BufWrite(const void *Data,size_t Size);
+    size_t RawWrite(const void *Data,size_t Size);
+    bool FlushWriteBuf();
+
+    bool UseWriteBuf; // Write only regular file, which bypasses stdio.
+    Array<byte> WriteBuf;
+    size_t WriteBufUsed;
+    int64 RawWritePos; // File position of first byte in write buffer.
+    int64 SyncPos; // Data below this position are sent to disk.
+
+    // Write buffer size. Must be a power of 2. Blocks of this size
+    // are written to file positions aligned to this size.
+    static const size_t WriteBufSize=0x100000;
+
+    // Start writeback of every area of this size after writing SyncMinSize
+    // bytes and wait for the area SyncWaitSize bytes behind, so extracting
+    // huge files does not fill all memory with dirty pages. Waiting for
+    // nearer areas would make extraction as slow as the disk itself.
+    static const size_t SyncRangeSize=0x800000;
+    static const int64 SyncMinSize=0x4000000;
+    static const int64 SyncWaitSize=0x10000000;
 #endif
   protected:
     bool OpenShared; // Set by 'Archive' class.
+    bool AllowMap; // Set by 'Archive' class.
   public:
     wchar FileName[NM];
 
@@ -71,7 +106,7 @@ class File
     void Flush();
     bool Delete();
     bool Rename(const wchar *NewName);
-    void Write(const void *Data,size_t Size);
+    bool Write(const void *Data,size_t Size);
     virtual int Read(void *Data,size_t Size);
     int DirectRead(void *Data,size_t Size);
     virtual void Seek(int64 Offset,int Method);
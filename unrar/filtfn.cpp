@@ -0,0 +1,206 @@
+// SIMD helpers for E8 and DELTA filters. This file is included
+// to both RAR 5.0 unpack and RAR 3.x VM standard filter code.
+// We use SSE2 only if compiler targets it, so it is always available
+// in x64 mode, but not necessary in 32-bit x86 builds.
+
+#if (defined(__SSE2__) || defined(_M_X64) || defined(_M_IX86_FP) && _M_IX86_FP>=2) && defined(LITTLE_ENDIAN)
+  #define USE_FILT_SSE
+  #include <emmintrin.h>
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && defined(LITTLE_ENDIAN)
+  #define USE_FILT_NEON
+  #include <arm_neon.h>
+#endif
+
+
+#if defined(USE_FILT_SSE) || defined(USE_FILT_NEON)
+// Return the number of trailing zero bits in non-zero Mask.
+static inline uint FiltLowBit(uint64 Mask)
+{
+#ifdef _MSC_VER
+  unsigned long Pos;
+#ifdef _M_X64
+  _BitScanForward64(&Pos,Mask);
+#else
+  if (!_BitScanForward(&Pos,(unsigned long)Mask))
+  {
+    _BitScanForward(&Pos,(unsigned long)(Mask>>32));
+    Pos+=32;
+  }
+#endif
+  return Pos;
+#else
+  return __builtin_ctzll(Mask);
+#endif
+}
+#endif
+
+
+// Return the position of first 0xe8 or CmpByte2 byte in Data[Pos..Border)
+// or Border if there are no such bytes. Opcodes are rare comparing to
+// other bytes, so we check 16 bytes at once.
+static inline uint FindE8(const byte *Data,uint Pos,uint Border,byte CmpByte2)
+{
+#ifdef USE_FILT_SSE
+  const __m128i E8=_mm_set1_epi8((char)0xe8),E9=_mm_set1_epi8((char)CmpByte2);
+  for (;Pos+16<=Border;Pos+=16)
+  {
+    __m128i D=_mm_loadu_si128((__m128i *)(Data+Pos));
+    uint Mask=_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(D,E8),_mm_cmpeq_epi8(D,E9)));
+    if (Mask!=0)
+      return Pos+FiltLowBit(Mask);
+  }
+#endif
+#ifdef USE_FILT_NEON
+  const uint8x16_t E8=vdupq_n_u8(0xe8),E9=vdupq_n_u8(CmpByte2);
+  for (;Pos+16<=Border;Pos+=16)
+  {
+    uint8x16_t D=vld1q_u8(Data+Pos);
+    uint8x16_t Cmp=vorrq_u8(vceqq_u8(D,E8),vceqq_u8(D,E9));
+
+    // Narrow every compared byte to 4 bits, so we get 64-bit mask.
+    uint8x8_t Narrow=vshrn_n_u16(vreinterpretq_u16_u8(Cmp),4);
+    uint64 Mask=vget_lane_u64(vreinterpret_u64_u8(Narrow),0);
+    if (Mask!=0)
+      return Pos+FiltLowBit(Mask)/4;
+  }
+#endif
+  for (;Pos<Border;Pos++)
+    if (Data[Pos]==0xe8 || Data[Pos]==CmpByte2)
+      return Pos;
+  return Border;
+}
+
+
+#ifdef USE_FILT_SSE
+// Subtract running sum of 16 delta bytes from previous channel byte.
+static inline __m128i DeltaSum(__m128i D,byte &PrevByte)
+{
+  D=_mm_add_epi8(D,_mm_slli_si128(D,1));
+  D=_mm_add_epi8(D,_mm_slli_si128(D,2));
+  D=_mm_add_epi8(D,_mm_slli_si128(D,4));
+  D=_mm_add_epi8(D,_mm_slli_si128(D,8));
+  D=_mm_sub_epi8(_mm_set1_epi8((char)PrevByte),D);
+  PrevByte=(byte)(_mm_extract_epi16(D,7)>>8);
+  return D;
+}
+#endif
+
+
+#ifdef USE_FILT_NEON
+static inline uint8x16_t DeltaSum(uint8x16_t D,byte &PrevByte)
+{
+  const uint8x16_t Zero=vdupq_n_u8(0);
+  D=vaddq_u8(D,vextq_u8(Zero,D,15));
+  D=vaddq_u8(D,vextq_u8(Zero,D,14));
+  D=vaddq_u8(D,vextq_u8(Zero,D,12));
+  D=vaddq_u8(D,vextq_u8(Zero,D,8));
+  D=vsubq_u8(vdupq_n_u8(PrevByte),D);
+  PrevByte=vgetq_lane_u8(D,15);
+  return D;
+}
+#endif
+
+
+// Decode 16 rows of all channels at once, where row contains one byte
+// of every channel. Return the number of decoded rows and last decoded
+// byte of every channel in PrevByte.
+static uint DeltaDecodeVec(byte *Dst,const byte *Src,uint DataSize,uint Channels,byte *PrevByte)
+{
+  uint Rows=0;
+#if defined(USE_FILT_SSE) || defined(USE_FILT_NEON)
+#ifdef USE_FILT_SSE
+  // SSE2 does not have byte shuffles needed to interleave 3 channels.
+  if (Channels!=1 && Channels!=2 && Channels!=4)
+    return 0;
+#else
+  if (Channels<1 || Channels>4)
+    return 0;
+#endif
+  // Source position of every channel. Channel data size is the number
+  // of complete rows plus 1 for channels present in incomplete last row.
+  uint ChStart[4],Pos=0;
+  for (uint I=0;I<Channels;I++)
+  {
+    ChStart[I]=Pos;
+    Pos+=DataSize/Channels+(I<DataSize%Channels ? 1:0);
+  }
+  Rows=DataSize/Channels & ~15;
+  for (uint Row=0;Row<Rows;Row+=16)
+  {
+    byte *D=Dst+Row*Channels;
+#ifdef USE_FILT_SSE
+    __m128i V[4];
+    for (uint I=0;I<Channels;I++)
+      V[I]=DeltaSum(_mm_loadu_si128((__m128i *)(Src+ChStart[I]+Row)),PrevByte[I]);
+    switch(Channels)
+    {
+      case 1:
+        _mm_storeu_si128((__m128i *)D,V[0]);
+        break;
+      case 2:
+        _mm_storeu_si128((__m128i *)D,_mm_unpacklo_epi8(V[0],V[1]));
+        _mm_storeu_si128((__m128i *)(D+16),_mm_unpackhi_epi8(V[0],V[1]));
+        break;
+      case 4:
+        {
+          __m128i L01=_mm_unpacklo_epi8(V[0],V[1]),H01=_mm_unpackhi_epi8(V[0],V[1]);
+          __m128i L23=_mm_unpacklo_epi8(V[2],V[3]),H23=_mm_unpackhi_epi8(V[2],V[3]);
+          _mm_storeu_si128((__m128i *)D,_mm_unpacklo_epi16(L01,L23));
+          _mm_storeu_si128((__m128i *)(D+16),_mm_unpackhi_epi16(L01,L23));
+          _mm_storeu_si128((__m128i *)(D+32),_mm_unpacklo_epi16(H01,H23));
+          _mm_storeu_si128((__m128i *)(D+48),_mm_unpackhi_epi16(H01,H23));
+        }
+        break;
+    }
+#else
+    uint8x16x4_t V;
+    for (uint I=0;I<Channels;I++)
+      V.val[I]=DeltaSum(vld1q_u8(Src+ChStart[I]+Row),PrevByte[I]);
+    switch(Channels)
+    {
+      case 1:
+        vst1q_u8(D,V.val[0]);
+        break;
+      case 2:
+        {
+          uint8x16x2_t V2={{V.val[0],V.val[1]}};
+          vst2q_u8(D,V2);
+        }
+        break;
+      case 3:
+        {
+          uint8x16x3_t V3={{V.val[0],V.val[1],V.val[2]}};
+          vst3q_u8(D,V3);
+        }
+        break;
+      case 4:
+        vst4q_u8(D,V);
+        break;
+    }
+#endif
+  }
+#endif
+  return Rows;
+}
+
+
+// Place delta encoded bytes of every channel, which are stored
+// as continual data blocks, back to their interleaving positions.
+static void DeltaDecode(byte *Dst,const byte *Src,uint DataSize,uint Channels)
+{
+  byte Prev[4]={0,0,0,0};
+  uint Rows=DeltaDecodeVec(Dst,Src,DataSize,Channels,Prev);
+
+  for (uint CurChannel=0,SrcPos=0;CurChannel<Channels;CurChannel++)
+  {
+    byte PrevByte=0;
+    if (Rows>0)
+    {
+      // Continue after rows decoded with SIMD.
+      PrevByte=Prev[CurChannel];
+      SrcPos+=Rows;
+    }
+    for (uint DestPos=CurChannel+Rows*Channels;DestPos<DataSize;DestPos+=Channels)
+      Dst[DestPos]=(PrevByte-=Src[SrcPos++]);
+  }
+}
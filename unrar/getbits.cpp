@@ -5,11 +5,11 @@ BitInput::BitInput(bool AllocBuffer)
   ExternalBuffer=false;
   if (AllocBuffer)
   {
-    // getbits32 attempts to read data from InAddr, ... InAddr+3 positions.
-    // So let's allocate 3 additional bytes for situation, when we need to
+    // getbits32 attempts to read data from InAddr, ... InAddr+7 positions.
+    // So let's allocate 7 additional bytes for situation, when we need to
     // read only 1 byte from the last position of buffer and avoid a crash
-    // from access to next 3 bytes, which contents we do not need.
-    size_t BufSize=MAX_SIZE+3;
+    // from access to next 7 bytes, which contents we do not need.
+    size_t BufSize=MAX_SIZE+7;
     InBuf=new byte[BufSize];
 
     // Ensure that we get predictable results when accessing bytes in area
@@ -1,6 +1,15 @@
 #ifndef _RAR_GETBITS_
 #define _RAR_GETBITS_
 
+// Read bit fields with single unaligned big endian load instead of
+// assembling them from separate bytes. It is the only difference from
+// byte based reading. There is no bit buffer, InAddr and InBit remain
+// the entire reader state, because unpack code adjusts InAddr directly.
+#if defined(LITTLE_ENDIAN) && (defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64)) || \
+    defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__) || defined(__aarch64__)))
+#define BITINPUT_FAST_LOAD
+#endif
+
 class BitInput
 {
   public:
@@ -33,17 +42,26 @@ class BitInput
     // Bit at (InAddr,InBit) has the highest position in returning data.
     uint getbits()
     {
+#ifdef BITINPUT_FAST_LOAD
+      uint32 BitField=getbe4(InBuf+InAddr) << InBit;
+      return(BitField >> 16);
+#else
       uint BitField=(uint)InBuf[InAddr] << 16;
       BitField|=(uint)InBuf[InAddr+1] << 8;
       BitField|=(uint)InBuf[InAddr+2];
       BitField >>= (8-InBit);
       return(BitField & 0xffff);
+#endif
     }
 
     // Return 32 bits from current position in the buffer.
     // Bit at (InAddr,InBit) has the highest position in returning data.
     uint getbits32()
     {
+#ifdef BITINPUT_FAST_LOAD
+      uint64 BitField=getbe8(InBuf+InAddr) << InBit;
+      return(uint(BitField >> 32));
+#else
       uint BitField=(uint)InBuf[InAddr] << 24;
       BitField|=(uint)InBuf[InAddr+1] << 16;
       BitField|=(uint)InBuf[InAddr+2] << 8;
@@ -51,7 +69,34 @@ class BitInput
       BitField <<= InBit;
       BitField|=(uint)InBuf[InAddr+4] >> (8-InBit);
       return(BitField & 0xffffffff);
+#endif
     }
+
+#ifdef BITINPUT_FAST_LOAD
+    // Up to 4 and 8 bytes are read from InAddr by these functions,
+    // so input buffers must have at least 7 bytes after the last used.
+    static uint32 getbe4(const byte *Data)
+    {
+      uint32 Value;
+      memcpy(&Value,Data,sizeof(Value));
+#ifdef _MSC_VER
+      return _byteswap_ulong(Value);
+#else
+      return __builtin_bswap32(Value);
+#endif
+    }
+
+    static uint64 getbe8(const byte *Data)
+    {
+      uint64 Value;
+      memcpy(&Value,Data,sizeof(Value));
+#ifdef _MSC_VER
+      return _byteswap_uint64(Value);
+#else
+      return __builtin_bswap64(Value);
+#endif
+    }
+#endif
     
     void faddbits(uint Bits);
     uint fgetbits();
@@ -39,12 +39,23 @@ bool HashValue::operator == (const HashValue &cmp)
 }
 
 
+#ifdef RAR_SMP
+THREAD_PROC(DataHashAsyncThread)
+{
+  ((DataHash *)Data)->HashAsyncBuf();
+}
+#endif
+
+
 DataHash::DataHash()
 {
   HashType=HASH_NONE;
 #ifdef RAR_SMP
   ThPool=NULL;
   MaxThreads=0;
+  AsyncPool=NULL;
+  AsyncFill=0;
+  UseAsync=false;
 #endif
 }
 
@@ -52,7 +63,8 @@ DataHash::DataHash()
 DataHash::~DataHash()
 {
 #ifdef RAR_SMP
-  DestroyThreadPool(ThPool);
+  delete AsyncPool; // Wait for background hashing before destroying ThPool.
+  delete ThPool;
 #endif
   cleandata(&blake2ctx, sizeof(blake2ctx));
   cleandata(&CurCRC32, sizeof(CurCRC32));
@@ -61,6 +73,13 @@ DataHash::~DataHash()
 
 void DataHash::Init(HASH_TYPE Type,uint MaxThreads)
 {
+#ifdef RAR_SMP
+  // Discard data of previous hashing.
+  if (AsyncPool!=NULL)
+    AsyncPool->WaitDone();
+  AsyncBuf[0].SoftReset();
+  AsyncBuf[1].SoftReset();
+#endif
   HashType=Type;
   if (Type==HASH_RAR14)
     CurCRC32=0;
@@ -70,12 +89,65 @@ void DataHash::Init(HASH_TYPE Type,uint MaxThreads)
     blake2sp_init( &blake2ctx );
 #ifdef RAR_SMP
   DataHash::MaxThreads=Min(MaxThreads,MaxHashThreads);
+
+  // Query once, Init is called for every file.
+  static const uint NumCPU=GetNumberOfCPU();
+  UseAsync=DataHash::MaxThreads>1 && NumCPU>1;
 #endif
 }
 
 
 void DataHash::Update(const void *Data,size_t DataSize)
 {
+#ifdef RAR_SMP
+  if (UseAsync && HashType!=HASH_NONE)
+  {
+    // Copy data and hash them in background thread, so caller can reuse
+    // its buffer and continue processing while we are hashing. We wait
+    // for previous block here, so at most two blocks are in memory.
+    AsyncBuf[AsyncFill].Append((byte *)Data,DataSize);
+    if (AsyncBuf[AsyncFill].Size()>=AsyncBlockSize)
+    {
+      if (AsyncPool==NULL)
+        AsyncPool=new ThreadPool(1);
+      AsyncPool->WaitDone();
+      AsyncFill^=1;
+      AsyncBuf[AsyncFill].SoftReset();
+      AsyncPool->AddTask(DataHashAsyncThread,(void*)this);
+      AsyncPool->StartTasks();
+    }
+    return;
+  }
+#endif
+  HashData(Data,DataSize);
+}
+
+
+#ifdef RAR_SMP
+void DataHash::HashAsyncBuf()
+{
+  Array<byte> *Buf=&AsyncBuf[AsyncFill^1];
+  HashData(&(*Buf)[0],Buf->Size());
+}
+
+
+// Complete background hashing and hash the rest of collected data.
+void DataHash::WaitAsync()
+{
+  if (AsyncPool!=NULL)
+    AsyncPool->WaitDone();
+  Array<byte> *Buf=&AsyncBuf[AsyncFill];
+  if (Buf->Size()>0)
+  {
+    HashData(&(*Buf)[0],Buf->Size());
+    Buf->SoftReset();
+  }
+}
+#endif
+
+
+void DataHash::HashData(const void *Data,size_t DataSize)
+{
 #ifndef SFX_MODULE
   if (HashType==HASH_RAR14)
     CurCRC32=Checksum14((ushort)CurCRC32,Data,DataSize);
@@ -86,8 +158,10 @@ void DataHash::Update(const void *Data,size_t DataSize)
   if (HashType==HASH_BLAKE2)
   {
 #ifdef RAR_SMP
+    // Unpack data hash can be updated in unpack writer thread, while main
+    // thread uses the global pool, so we need our own pool here.
     if (MaxThreads>1 && ThPool==NULL)
-      ThPool=CreateThreadPool();
+      ThPool=new ThreadPool(MaxThreads);
     blake2ctx.ThPool=ThPool;
     blake2ctx.MaxThreads=MaxThreads;
 #endif
@@ -98,6 +172,9 @@ void DataHash::Update(const void *Data,size_t DataSize)
 
 void DataHash::Result(HashValue *Result)
 {
+#ifdef RAR_SMP
+  WaitAsync();
+#endif
   Result->Type=HashType;
   if (HashType==HASH_RAR14)
     Result->CRC32=CurCRC32;
@@ -114,6 +191,9 @@ void DataHash::Result(HashValue *Result)
 
 uint DataHash::GetCRC32()
 {
+#ifdef RAR_SMP
+  WaitAsync();
+#endif
   return HashType==HASH_CRC32 ? CurCRC32^0xffffffff : 0;
 }
 
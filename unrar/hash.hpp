@@ -31,12 +31,31 @@ class DataHash
     uint CurCRC32;
     blake2sp_state blake2ctx;
 
+    void HashData(const void *Data,size_t DataSize);
+
 #ifdef RAR_SMP
+    void WaitAsync();
+
     ThreadPool *ThPool;
 
     uint MaxThreads;
     // Upper limit for maximum threads to prevent wasting threads in pool.
     static const uint MaxHashThreads=8;
+
+    // Single thread pool hashing data in background.
+    ThreadPool *AsyncPool;
+
+    // Data are collected in AsyncBuf[AsyncFill] while the other buffer
+    // is hashed in background.
+    Array<byte> AsyncBuf[2];
+    uint AsyncFill;
+
+    // Background hashing only pays off if another CPU can run it.
+    bool UseAsync;
+
+    // Minimum amount of collected data to start the background hashing.
+    // Smaller blocks would waste time to thread switching.
+    static const size_t AsyncBlockSize=0x100000;
 #endif
   public:
     DataHash();
@@ -47,6 +66,9 @@ class DataHash
     uint GetCRC32();
     bool Cmp(HashValue *CmpValue,byte *Key);
     HASH_TYPE Type() {return HashType;}
+#ifdef RAR_SMP
+    void HashAsyncBuf(); // Called in background hashing thread.
+#endif
 };
 
 #endif
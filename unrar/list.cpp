@@ -5,9 +5,16 @@ static void ListSymLink(Archive &Arc);
 static void ListFileAttr(uint A,HOST_SYSTEM_TYPE HostType,wchar *AttrStr,size_t AttrSize);
 static void ListOldSubHeader(Archive &Arc);
 static void ListNewSubHeader(CommandData *Cmd,Archive &Arc);
+static void ListArchiveFast(CommandData *Cmd);
 
 void ListArchive(CommandData *Cmd)
 {
+  if (Cmd->Command[1]=='F')
+  {
+    ListArchiveFast(Cmd);
+    return;
+  }
+
   int64 SumPackSize=0,SumUnpSize=0;
   uint ArcCount=0,SumFileCount=0;
   bool Technical=(Cmd->Command[1]=='T');
@@ -465,3 +472,303 @@ void ListFileAttr(uint A,HOST_SYSTEM_TYPE HostType,wchar *AttrStr,size_t AttrSiz
       break;
   }
 }
+
+
+// Fast listing for 'lf' and 'vf' commands. It displays only names, sizes
+// and modification times in machine readable format and does not view
+// the archive comment. Every file is displayed as a separate line with
+// tab separated file type ('F' for file or 'D' for directory), unpacked
+// size, packed size, modification time as Unix time and name. '?' is
+// displayed for unknown size or time. Backslash, tab and line break
+// characters in names are escaped with backslash and '/' is used as
+// path separator.
+
+// Output lines are collected in the buffer and displayed with a single
+// mprintf call, which is much faster than displaying them separately.
+// Buffer size must be enough for longest line with escaped name
+// and less than mprintf message size limit.
+static const size_t FastOutSize=2*NM+100;
+
+// RAR 5.0 headers are read with increasing portions starting from
+// FastReadMin bytes up to FastReadMax.
+static const size_t FastReadMin=0x4000;
+static const size_t FastReadMax=0x100000;
+
+
+static void FastListFlush(Array<wchar> &Out,size_t &OutSize)
+{
+  if (OutSize>0)
+  {
+    Out[OutSize]=0;
+    mprintf(L"%ls",&Out[0]);
+    OutSize=0;
+  }
+}
+
+
+static void FastListFile(FileHeader &hd,Array<wchar> &Out,size_t &OutSize)
+{
+  wchar Line[FastOutSize];
+  wchar *s=Line;
+
+  *(s++)=hd.Dir ? 'D':'F';
+  *(s++)='\t';
+  if (hd.UnpSize==INT64NDF)
+    *(s++)='?';
+  else
+  {
+    itoa(hd.UnpSize,s);
+    s+=wcslen(s);
+  }
+  *(s++)='\t';
+  itoa(hd.PackSize,s);
+  s+=wcslen(s);
+  *(s++)='\t';
+  int64 UnixTime=hd.mtime.IsSet() ? (int64)hd.mtime.GetUnix():-1;
+  if (UnixTime<0)
+    *(s++)='?';
+  else
+  {
+    itoa(UnixTime,s);
+    s+=wcslen(s);
+  }
+  *(s++)='\t';
+  for (const wchar *Name=hd.FileName;*Name!=0;Name++)
+  {
+    wchar c=*Name==CPATHDIVIDER ? '/':*Name;
+    switch(c)
+    {
+      case '\\':
+        *(s++)='\\';
+        *(s++)='\\';
+        break;
+      case '\t':
+        *(s++)='\\';
+        *(s++)='t';
+        break;
+      case '\n':
+        *(s++)='\\';
+        *(s++)='n';
+        break;
+      case '\r':
+        *(s++)='\\';
+        *(s++)='r';
+        break;
+      default:
+        *(s++)=c;
+        break;
+    }
+  }
+  *(s++)='\n';
+
+  size_t LineSize=s-Line;
+  if (OutSize+LineSize>FastOutSize)
+    FastListFlush(Out,OutSize);
+  memcpy(&Out[OutSize],Line,LineSize*sizeof(wchar));
+  OutSize+=LineSize;
+}
+
+
+// Return pointer to Size bytes at archive position Pos loaded to Buf
+// or NULL if they are not available. We read headers sequentially
+// increasing the read size and seek over data areas exceeding it.
+static byte* FastListData(Archive &Arc,Array<byte> &Buf,int64 &BufPos,size_t &BufSize,
+                          size_t &ReadSize,int64 Pos,size_t Size)
+{
+  int64 BufEnd=BufPos+BufSize;
+  if (Pos>=BufPos && Pos+(int64)Size<=BufEnd)
+    return &Buf[size_t(Pos-BufPos)];
+
+  size_t KeepSize=0;
+  if (Pos>=BufPos && Pos<=BufEnd)
+  {
+    KeepSize=size_t(BufEnd-Pos);
+    memmove(&Buf[0],&Buf[size_t(Pos-BufPos)],KeepSize);
+    ReadSize=Min(ReadSize*2,FastReadMax);
+  }
+  else
+  {
+    if (Pos<BufPos || Pos-BufEnd>=(int64)ReadSize)
+      ReadSize=FastReadMin;
+    Arc.Seek(Pos,SEEK_SET);
+  }
+  BufPos=Pos;
+  BufSize=KeepSize;
+
+  size_t FillSize=Max(Size,ReadSize);
+  Buf.Alloc(FillSize);
+  int ReadCode=Arc.Read(&Buf[KeepSize],FillSize-KeepSize);
+  if (ReadCode>0)
+    BufSize+=ReadCode;
+  return Size<=BufSize ? &Buf[0]:NULL;
+}
+
+
+// List RAR 5.0 headers starting from Pos parsing only fields required
+// for fast listing. Stop and return the position of first header, which
+// we cannot process here, such as end of archive or broken header.
+// Caller reads it with regular ReadHeader, so all errors are reported
+// as usual and archive state is suitable to open a next volume.
+static int64 ListFast50(CommandData *Cmd,Archive &Arc,int64 Pos,Array<wchar> &Out,size_t &OutSize)
+{
+  Array<byte> Buf;
+  int64 BufPos=0;
+  size_t BufSize=0,ReadSize=FastReadMin;
+  RawRead Raw(NULL);
+  FileHeader &hd=Arc.FileHead;
+
+  // Name matching is relatively expensive comparing to parsing a header,
+  // so we avoid it when listing all files.
+  Cmd->FileArgs.Rewind();
+  wchar *FirstMask=Cmd->FileArgs.GetString();
+  bool AllFiles=Cmd->FileArgs.ItemsCount()==1 && wcscmp(FirstMask,MASKALL)==0 &&
+                Cmd->ExclArgs.ItemsCount()==0 && Cmd->InclArgs.ItemsCount()==0 &&
+                !Cmd->AnyFiltersActive();
+
+  while (true)
+  {
+    const size_t FirstReadSize=7;
+    byte *Data=FastListData(Arc,Buf,BufPos,BufSize,ReadSize,Pos,FirstReadSize);
+    if (Data==NULL)
+      return Pos;
+    Raw.Reset();
+    Raw.Read(Data,FirstReadSize);
+    uint HeadCRC=Raw.Get4();
+    uint SizeBytes=Raw.GetVSize(4);
+    uint64 BlockSize=Raw.GetV();
+    if (SizeBytes==0 || BlockSize==0)
+      return Pos;
+    size_t HeaderSize=4+SizeBytes+(size_t)BlockSize;
+
+    if ((Data=FastListData(Arc,Buf,BufPos,BufSize,ReadSize,Pos,HeaderSize))==NULL)
+      return Pos;
+    Raw.Reset();
+    Raw.Read(Data,HeaderSize);
+    if (HeadCRC!=Raw.GetCRC50())
+      return Pos;
+    Raw.SetPos(4+SizeBytes);
+
+    HEADER_TYPE HeaderType=(HEADER_TYPE)Raw.GetV();
+    uint Flags=(uint)Raw.GetV();
+    uint64 ExtraSize=(Flags & HFL_EXTRA)!=0 ? Raw.GetV():0;
+    uint64 DataSize=(Flags & HFL_DATA)!=0 ? Raw.GetV():0;
+    int64 NextPos=Pos+HeaderSize+DataSize;
+    if (HeaderType==HEAD_ENDARC || ExtraSize>=HeaderSize || NextPos<=Pos)
+      return Pos;
+
+    // Skip service headers and data areas without reading them.
+    if (HeaderType==HEAD_FILE)
+    {
+      hd.HeaderType=HEAD_FILE;
+      hd.PackSize=DataSize;
+      uint FileFlags=(uint)Raw.GetV();
+      hd.UnpSize=Raw.GetV();
+      if ((FileFlags & FHFL_UNPUNKNOWN)!=0)
+        hd.UnpSize=INT64NDF;
+      hd.FileAttr=(uint)Raw.GetV();
+      hd.mtime.Reset();
+      if ((FileFlags & FHFL_UTIME)!=0)
+        hd.mtime=(time_t)Raw.Get4();
+      if ((FileFlags & FHFL_CRC32)!=0)
+        Raw.Get4();
+      Raw.GetV(); // Compression information.
+      Raw.GetV(); // Host OS.
+      size_t NameSize=(size_t)Raw.GetV();
+
+      char FileName[NM*4];
+      size_t ReadNameSize=Min(NameSize,ASIZE(FileName)-1);
+      Raw.GetB((byte *)FileName,ReadNameSize);
+      FileName[ReadNameSize]=0;
+      UtfToWide(FileName,hd.FileName,ASIZE(hd.FileName)-1);
+      for (wchar *s=hd.FileName;*s!=0;s++)
+        if (*s=='/')
+          *s=CPATHDIVIDER;
+
+      hd.Dir=(FileFlags & FHFL_DIRECTORY)!=0;
+      hd.SplitBefore=(Flags & HFL_SPLITBEFORE)!=0;
+      hd.SplitAfter=(Flags & HFL_SPLITAFTER)!=0;
+
+      // Only the high precision modification time is needed from extra area.
+      if (ExtraSize!=0)
+      {
+        Raw.SetPos(Raw.Size()-(size_t)ExtraSize);
+        while (Raw.DataLeft()>=2)
+        {
+          int64 FieldSize=Raw.GetV();
+          if (FieldSize==0 || Raw.DataLeft()==0 || FieldSize>(int64)Raw.DataLeft())
+            break;
+          size_t NextFieldPos=size_t(Raw.GetPos()+FieldSize);
+          if (Raw.GetV()==FHEXTRA_HTIME && FieldSize>=9)
+          {
+            byte TimeFlags=(byte)Raw.GetV();
+            if ((TimeFlags & FHEXTRA_HTIME_MTIME)!=0)
+            {
+              if ((TimeFlags & FHEXTRA_HTIME_UNIXTIME)!=0)
+                hd.mtime=(time_t)Raw.Get4();
+              else
+                hd.mtime.SetRaw(Raw.Get8());
+            }
+          }
+          Raw.SetPos(NextFieldPos);
+        }
+      }
+
+      if (AllFiles || Cmd->IsProcessFile(hd)!=0)
+        FastListFile(hd,Out,OutSize);
+    }
+    Pos=NextPos;
+  }
+}
+
+
+void ListArchiveFast(CommandData *Cmd)
+{
+  Array<wchar> Out(FastOutSize+1);
+  size_t OutSize=0;
+
+  wchar ArcName[NM];
+  while (Cmd->GetArcName(ArcName,ASIZE(ArcName)))
+  {
+    Archive Arc(Cmd);
+#ifdef _WIN_ALL
+    Arc.RemoveSequentialFlag();
+#endif
+    if (!Arc.WOpen(ArcName))
+      continue;
+    while (Arc.IsArchive(true))
+    {
+      // Older formats and encrypted headers are processed by regular
+      // ReadHeader, but we still skip service headers and comments.
+      if (Arc.Format==RARFMT50 && !Arc.Encrypted)
+      {
+        int64 Pos=Arc.Tell();
+#ifdef USE_QOPEN
+        // We read headers directly, so quick open data are not needed.
+        // Also it prevents saving the quick open cache without headers.
+        Arc.QOpenUnload();
+#endif
+        Arc.Seek(ListFast50(Cmd,Arc,Pos,Out,OutSize),SEEK_SET);
+      }
+      while (Arc.ReadHeader()>0)
+      {
+        HEADER_TYPE HeaderType=Arc.GetHeaderType();
+        if (HeaderType==HEAD_ENDARC)
+          break;
+        if (HeaderType==HEAD_FILE && Cmd->IsProcessFile(Arc.FileHead)!=0)
+          FastListFile(Arc.FileHead,Out,OutSize);
+        Arc.SeekToNext();
+      }
+#ifndef NOVOLUME
+      if (Cmd->VolSize!=0 && (Arc.FileHead.SplitAfter ||
+          (Arc.GetHeaderType()==HEAD_ENDARC && Arc.EndArcHead.NextVolume)) &&
+          MergeArchive(Arc,NULL,false,Cmd->Command[0]))
+      {
+        Arc.Seek(0,SEEK_SET);
+      }
+      else
+#endif
+        break;
+    }
+  }
+  FastListFlush(Out,OutSize);
+}
@@ -34,7 +34,7 @@
 #define   MCHelpCmdF         "\n  f             Freshen files in archive"
 #define   MCHelpCmdI         "\n  i[par]=<str>  Find string in archives"
 #define   MCHelpCmdK         "\n  k             Lock archive"
-#define   MCHelpCmdL         "\n  l[t[a],b]     List archive contents [technical[all], bare]"
+#define   MCHelpCmdL         "\n  l[t[a],b,f]   List archive contents [technical[all], bare, fast]"
 #define   MCHelpCmdM         "\n  m[f]          Move to archive [files only]"
 #define   MCHelpCmdP         "\n  p             Print file to stdout"
 #define   MCHelpCmdR         "\n  r             Repair archive"
@@ -45,7 +45,7 @@
 #define   MCHelpCmdS         "\n  s[name|-]     Convert archive to or from SFX"
 #define   MCHelpCmdT         "\n  t             Test archive files"
 #define   MCHelpCmdU         "\n  u             Update files in archive"
-#define   MCHelpCmdV         "\n  v[t[a],b]     Verbosely list archive contents [technical[all],bare]"
+#define   MCHelpCmdV         "\n  v[t[a],b,f]   Verbosely list archive contents [technical[all],bare,fast]"
 #define   MCHelpCmdX         "\n  x             Extract files with full path"
 #define   MCHelpSw           "\n\n<Switches>"
 #define   MCHelpSwm          "\n  -             Stop switches scanning"
@@ -107,6 +107,7 @@
 #define   MCHelpSwP          "\n  p[password]   Set password"
 #define   MCHelpSwPm         "\n  p-            Do not query password"
 #define   MCHelpSwQO         "\n  qo[-|+]       Add quick open information [none|force]"
+#define   MCHelpSwQOC        "\n  qoc           Cache headers of archives without quick open information"
 #define   MCHelpSwR          "\n  r             Recurse subdirectories"
 #define   MCHelpSwRm         "\n  r-            Disable recursion"
 #define   MCHelpSwR0         "\n  r0            Recurse subdirectories for wildcard names only"
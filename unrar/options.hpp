@@ -88,6 +88,7 @@ class RAROptions
 #ifdef USE_QOPEN
     wchar SFXModule[NM];
     QOPEN_MODE QOpenMode;
+    bool QOpenCache; // Switch -qoc.
 #endif
     bool ConfigDisabled; // Switch -cfg-.
     wchar ExtrPath[NM];
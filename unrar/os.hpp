@@ -134,6 +134,21 @@
   #include <sys/statvfs.h>
 #endif
 #endif
+#ifndef __AROS__ // AROS does not provide mmap.
+  #include <sys/mman.h>
+  #if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+    #define MAP_ANONYMOUS MAP_ANON
+  #endif
+  #ifdef MAP_ANONYMOUS
+    #define USE_MMAP_ALLOC
+  #endif
+  #define USE_MMAP_READ // Map archives to memory instead of stdio reading.
+  #define USE_RAW_WRITE // Write extracted files with 'write' and own buffer.
+  #ifdef __linux__
+    #define USE_FALLOCATE
+    #define USE_SYNC_FILE_RANGE
+  #endif
+#endif
 #if defined(__FreeBSD__) || defined (__NetBSD__) || defined (__OpenBSD__) || defined(__APPLE__)
 #endif
 #include <pwd.h>
@@ -25,6 +25,11 @@ void QuickOpen::Init(Archive *Arc,bool WriteMode)
   ListStart=NULL;
   ListEnd=NULL;
 
+  DataFile=Arc;
+  DataEncrypted=false;
+  CacheRecord=false;
+  CacheHeaderActive=false;
+
   if (Buf==NULL)
     Buf=new byte[MaxBufSize];
 
@@ -44,6 +49,8 @@ void QuickOpen::Close()
     delete Item;
     Item=Next;
   }
+  CacheFile.Close();
+  CacheData.Reset();
 }
 
 
@@ -74,11 +81,13 @@ void QuickOpen::Load(uint64 BlockPos)
     QLHeaderPos=Arc->CurBlockPos;
     RawDataStart=Arc->Tell();
     RawDataSize=Arc->SubHead.UnpSize;
+    DataFile=Arc;
+    DataEncrypted=Arc->SubHead.Encrypted;
 
     Loaded=true; // Set only after all file processing calls like Tell, Seek, ReadHeader.
   }
 
-  if (Arc->SubHead.Encrypted)
+  if (DataEncrypted)
   {
     RAROptions *Cmd=Arc->GetRAROptions();
 #ifndef RAR_NOCRYPT
@@ -186,17 +195,17 @@ bool QuickOpen::Tell(int64 *Pos)
 uint QuickOpen::ReadBuffer()
 {
   SaveFilePos SavePos(*Arc);
-  Arc->File::Seek(RawDataStart+RawDataPos,SEEK_SET);
+  DataFile->File::Seek(RawDataStart+RawDataPos,SEEK_SET);
   size_t SizeToRead=(size_t)Min(RawDataSize-RawDataPos,MaxBufSize-ReadBufSize);
-  if (Arc->SubHead.Encrypted)
+  if (DataEncrypted)
     SizeToRead &= ~CRYPT_BLOCK_MASK;
   if (SizeToRead==0)
     return 0;
-  int ReadSize=Arc->File::Read(Buf+ReadBufSize,SizeToRead);
+  int ReadSize=DataFile->File::Read(Buf+ReadBufSize,SizeToRead);
   if (ReadSize<=0)
     return 0;
 #ifndef RAR_NOCRYPT
-  if (Arc->SubHead.Encrypted)
+  if (DataEncrypted)
     Crypt.DecryptBlock(Buf+ReadBufSize,ReadSize & ~CRYPT_BLOCK_MASK);
 #endif
   RawDataPos+=ReadSize;
@@ -270,3 +279,452 @@ bool QuickOpen::ReadNext()
   LastReadHeaderPos=QLHeaderPos-Offset;
   return true;
 }
+
+
+// Quick open cache stores headers of archives without quick open record
+// in user's configuration directory, so repeated processing of the same
+// archive reads headers from cache instead of walking through the entire
+// archive. Cache file includes the header with archive properties followed
+// by records in the same format as quick open data stored in archive.
+// Record offsets are calculated from the end of archive.
+//
+// Cache header layout:
+//   0   signature
+//   8   CRC32 of all following header fields, name and sample table
+//   12  archive size
+//   20  archive modification time
+//   28  main archive header position
+//   36  archive change time, only in Unix
+//   44  archive inode number, only in Unix
+//   52  size of quick open records
+//   60  BLAKE2sp of quick open records
+//   92  BLAKE2sp of archive headers listed in sample table
+//   124 number of sample table entries
+//   126 archive name size
+//   128 full archive name in UTF-8
+//   Sample table entries, 8 bytes of header position and 4 bytes of size.
+static const byte CacheSign[]={'R','a','r','Q','O','C',0x1a,2};
+static const size_t CacheHeadSize=128; // Cache header size without archive name and samples.
+static const size_t CacheSampleSize=12;
+static const uint CacheMaxHeaderSize=0x200000; // Larger headers are not sampled.
+
+
+// Unlike modification time, Unix change time is updated by any write
+// and cannot be restored by the program which modified the archive.
+static void GetArcChangeTime(Archive *Arc,uint64 *ChangeTime,uint64 *FileId)
+{
+  *ChangeTime=*FileId=0;
+#ifdef _UNIX
+  struct stat st;
+  if (fstat(fileno(Arc->GetHandle()),&st)==0)
+  {
+    *ChangeTime=(uint64)st.st_ctime;
+    *FileId=(uint64)st.st_ino;
+  }
+#endif
+}
+
+
+void QuickOpen::InitCache(Archive *Arc,uint64 MainPos)
+{
+  if (Loaded) // Archive contains quick open data, we do not need the cache.
+    return;
+  Init(Arc,false);
+
+  CacheArcSize=Arc->FileLength();
+  Arc->GetOpenFileTime(&CacheArcTime);
+  GetArcChangeTime(Arc,&CacheArcChangeTime,&CacheArcId);
+  CacheMainPos=MainPos;
+  if (!LoadCache())
+  {
+    CacheRecord=true;
+    CacheLastPos=MainPos;
+    CacheHeaderCount=0;
+    CacheSampleStep=1;
+    CacheSamples.Reset();
+
+    // Main header is read from archive also when using the cache,
+    // but we check it to be sure that cache belongs to this archive.
+    CacheSample Main;
+    Main.Pos=MainPos;
+    Main.Size=(uint)(Arc->NextBlockPos-MainPos);
+    CacheSamples.Push(Main);
+  }
+}
+
+
+bool QuickOpen::GetCacheName(wchar *Name,size_t MaxSize,bool Create)
+{
+  if (!EnumConfigPaths(0,Name,MaxSize,Create))
+    return false;
+  AddEndSlash(Name,MaxSize);
+#ifdef _UNIX
+  wcsncatz(Name,L".rarqocache",MaxSize);
+  if (Create && !FileExist(Name))
+    MakeDir(Name,true,0700);
+
+  // Other users must not be able to replace cache files.
+  char NameA[NM];
+  WideToChar(Name,NameA,ASIZE(NameA));
+  struct stat st;
+  if (lstat(NameA,&st)!=0 || !S_ISDIR(st.st_mode) || st.st_uid!=getuid())
+    return false;
+  if ((st.st_mode & 077)!=0 && chmod(NameA,0700)!=0)
+    return false;
+#else
+  wcsncatz(Name,L"QOCache",MaxSize);
+  if (Create && !FileExist(Name))
+    MakeDir(Name,false,0);
+#endif
+
+  // Name the cache by the first 128 bits of full archive name hash.
+  wchar FullArcName[NM];
+  ConvertNameToFull(Arc->FileName,FullArcName,ASIZE(FullArcName));
+  DataHash NameHash;
+  NameHash.Init(HASH_BLAKE2,1);
+  NameHash.Update(FullArcName,wcslen(FullArcName)*sizeof(wchar));
+  HashValue Value;
+  NameHash.Result(&Value);
+  wchar CacheName[40];
+  for (uint I=0;I<16;I++)
+    swprintf(CacheName+I*2,3,L"%02x",Value.Digest[I]);
+  wcsncatz(CacheName,L".qoc",ASIZE(CacheName));
+  AddEndSlash(Name,MaxSize);
+  wcsncatz(Name,CacheName,MaxSize);
+  return true;
+}
+
+
+// Read bytes from archive without changing the archive file pointer.
+bool QuickOpen::ReadArcBytes(uint64 Pos,byte *Data,size_t Size)
+{
+  int64 SavePos=Arc->File::Tell();
+  Arc->File::Seek(Pos,SEEK_SET);
+  bool Success=Arc->File::Read(Data,Size)==(int)Size;
+  Arc->File::Seek(SavePos,SEEK_SET);
+  return Success;
+}
+
+
+// Calculate BLAKE2sp of archive headers in sample table. Cache is valid
+// only if these headers did not change since the cache was written.
+bool QuickOpen::HashCacheSamples(byte *Digest)
+{
+  DataHash Hash;
+  Hash.Init(HASH_BLAKE2,1);
+  Array<byte> Data;
+  for (size_t I=0;I<CacheSamples.Size();I++)
+  {
+    CacheSample *Sample=&CacheSamples[I];
+    if (Sample->Size==0 || Sample->Size>CacheMaxHeaderSize ||
+        Sample->Pos+Sample->Size>CacheArcSize)
+      return false;
+    Data.Alloc(Sample->Size);
+    if (!ReadArcBytes(Sample->Pos,&Data[0],Sample->Size))
+      return false;
+    Hash.Update(&Data[0],Sample->Size);
+  }
+  HashValue Value;
+  Hash.Result(&Value);
+  memcpy(Digest,Value.Digest,SHA256_DIGEST_SIZE);
+  return true;
+}
+
+
+bool QuickOpen::LoadCache()
+{
+  wchar Name[NM];
+  if (!GetCacheName(Name,ASIZE(Name),false) || !CacheFile.Open(Name))
+    return false;
+
+  Array<byte> Head(CacheHeadSize);
+  if (CacheFile.Read(&Head[0],CacheHeadSize)!=CacheHeadSize ||
+      memcmp(&Head[0],CacheSign,ASIZE(CacheSign))!=0)
+  {
+    CacheFile.Close();
+    return false;
+  }
+  size_t SampleCount=RawGet2(&Head[124]);
+  size_t NameSize=RawGet2(&Head[126]);
+  size_t TailSize=NameSize+SampleCount*CacheSampleSize;
+  Head.Add(TailSize);
+  if (TailSize>0 && CacheFile.Read(&Head[CacheHeadSize],TailSize)!=(int)TailSize)
+  {
+    CacheFile.Close();
+    return false;
+  }
+
+  wchar FullArcName[NM];
+  ConvertNameToFull(Arc->FileName,FullArcName,ASIZE(FullArcName));
+  char NameUtf[NM*4];
+  WideToUtf(FullArcName,NameUtf,ASIZE(NameUtf));
+
+  // Archive size and modification and change times detect most of archive
+  // changes. Also we compare archive name to exclude cache name collisions.
+  bool Valid=RawGet4(&Head[8])==(CRC32(0xffffffff,&Head[12],Head.Size()-12)^0xffffffff) &&
+             RawGet8(&Head[12])==CacheArcSize &&
+             RawGet8(&Head[20])==CacheArcTime.GetRaw() &&
+             RawGet8(&Head[28])==CacheMainPos &&
+             RawGet8(&Head[36])==CacheArcChangeTime &&
+             RawGet8(&Head[44])==CacheArcId &&
+             NameSize==strlen(NameUtf) && memcmp(&Head[CacheHeadSize],NameUtf,NameSize)==0;
+
+  // Compare headers spread over the archive with their state when writing
+  // the cache. It detects archives modified in place without changing
+  // their size and time.
+  if (Valid)
+  {
+    byte *SampleData=&Head[CacheHeadSize+NameSize];
+    CacheSamples.Alloc(SampleCount);
+    for (size_t I=0;I<SampleCount;I++)
+    {
+      CacheSamples[I].Pos=RawGet8(SampleData+I*CacheSampleSize);
+      CacheSamples[I].Size=RawGet4(SampleData+I*CacheSampleSize+8);
+    }
+    byte Digest[SHA256_DIGEST_SIZE];
+    Valid=SampleCount>0 && HashCacheSamples(Digest) &&
+          memcmp(&Head[92],Digest,SHA256_DIGEST_SIZE)==0;
+    CacheSamples.Reset();
+  }
+
+  // Verify the entire cache data, so we never use damaged records.
+  uint64 DataSize=RawGet8(&Head[52]);
+  if (Valid)
+  {
+    DataHash Hash;
+    Hash.Init(HASH_BLAKE2,1);
+    uint64 Done=0;
+    while (Done<DataSize)
+    {
+      size_t ReadSize=(size_t)Min(DataSize-Done,MaxBufSize);
+      if (CacheFile.Read(Buf,ReadSize)!=(int)ReadSize)
+        break;
+      Hash.Update(Buf,ReadSize);
+      Done+=ReadSize;
+    }
+    HashValue Value;
+    Hash.Result(&Value);
+    Valid=Done==DataSize && memcmp(&Head[60],Value.Digest,SHA256_DIGEST_SIZE)==0;
+  }
+
+  if (!Valid)
+  {
+    CacheFile.Close();
+    return false;
+  }
+
+  DataFile=&CacheFile;
+  DataEncrypted=false;
+  QLHeaderPos=CacheArcSize;
+  RawDataStart=Head.Size();
+  RawDataSize=DataSize;
+  SeekPos=Arc->Tell();
+  UnsyncSeekPos=false;
+  Loaded=true;
+
+  // Since Loaded is already set, it only prepares to read the first record.
+  Load(QLHeaderPos);
+  return true;
+}
+
+
+// Store variable length integer and return its size.
+static size_t CachePutV(byte *Data,uint64 Value)
+{
+  size_t Size=0;
+  for (;Value>=0x80;Value>>=7)
+    Data[Size++]=byte(Value|0x80);
+  Data[Size++]=byte(Value);
+  return Size;
+}
+
+
+void QuickOpen::CacheHeaderStart(uint64 Pos)
+{
+  // Skip headers already recorded, such as headers read in IsArchive
+  // before processing archive contents.
+  CacheHeaderActive=CacheRecord && Pos>CacheLastPos;
+  if (CacheHeaderActive)
+  {
+    CacheHeaderPos=Pos;
+    CacheHeader.Reset();
+  }
+}
+
+
+void QuickOpen::CacheHeaderRead(const void *Data,size_t Size)
+{
+  if (CacheHeaderActive)
+  {
+    size_t Pos=CacheHeader.Size();
+    CacheHeader.Add(Size);
+    memcpy(&CacheHeader[Pos],Data,Size);
+  }
+}
+
+
+void QuickOpen::CacheHeaderEnd(bool Valid,bool EndArc)
+{
+  if (!CacheHeaderActive)
+    return;
+  CacheHeaderActive=false;
+
+  // Do not save the cache for broken archives or if header data were not
+  // read sequentially.
+  size_t HeaderSize=CacheHeader.Size();
+  if (!Valid || HeaderSize==0 || (uint64)Arc->File::Tell()!=CacheHeaderPos+HeaderSize)
+  {
+    CacheRecord=false;
+    CacheData.Reset();
+    return;
+  }
+
+  byte Fields[30],SizeField[10];
+  size_t FieldsSize=CachePutV(Fields,0); // Flags.
+  FieldsSize+=CachePutV(Fields+FieldsSize,CacheArcSize-CacheHeaderPos);
+  FieldsSize+=CachePutV(Fields+FieldsSize,HeaderSize);
+  size_t SizeBytes=CachePutV(SizeField,FieldsSize+HeaderSize);
+
+  size_t RecPos=CacheData.Size();
+  size_t RecSize=4+SizeBytes+FieldsSize+HeaderSize;
+  CacheData.Add(RecSize);
+  byte *Rec=&CacheData[RecPos];
+  memcpy(Rec+4,SizeField,SizeBytes);
+  memcpy(Rec+4+SizeBytes,Fields,FieldsSize);
+  memcpy(Rec+4+SizeBytes+FieldsSize,&CacheHeader[0],HeaderSize);
+  RawPut4(CRC32(0xffffffff,Rec+4,RecSize-4)^0xffffffff,Rec);
+  CacheLastPos=CacheHeaderPos;
+
+  // Sample every CacheSampleStep header and the end of archive header.
+  // When the sample table is full, we remove every second sample
+  // and double the step, so samples are spread over the entire archive.
+  if ((CacheHeaderCount++ % CacheSampleStep==0 || EndArc) &&
+      HeaderSize<=CacheMaxHeaderSize)
+  {
+    if (CacheSamples.Size()>CacheMaxSamples)
+    {
+      size_t Count=1; // Keep the main header sample.
+      for (size_t I=1;I<CacheSamples.Size();I+=2)
+        CacheSamples[Count++]=CacheSamples[I];
+      CacheSamples.Alloc(Count);
+      CacheSampleStep*=2;
+    }
+    CacheSample Sample;
+    Sample.Pos=CacheHeaderPos;
+    Sample.Size=(uint)HeaderSize;
+    CacheSamples.Push(Sample);
+  }
+
+  if (EndArc)
+  {
+    WriteCache();
+    CacheRecord=false;
+    CacheData.Reset();
+    CacheSamples.Reset();
+  }
+}
+
+
+// Create a new temporary file for the cache. Other processes cannot
+// read or replace it before we rename it.
+static bool CreateCacheTemp(const wchar *Name,wchar *TempName,size_t MaxSize,File &Out)
+{
+#ifdef _UNIX
+  char TempA[NM];
+  WideToChar(Name,TempA,ASIZE(TempA));
+  strncatz(TempA,".XXXXXX",ASIZE(TempA));
+  int fd=mkstemp(TempA); // Uses O_EXCL and 0600 mode.
+  if (fd==-1)
+    return false;
+  FILE *f=fdopen(fd,WRITEBINARY);
+  if (f==NULL)
+  {
+    close(fd);
+    unlink(TempA);
+    return false;
+  }
+  Out.SetHandle(f);
+  CharToWide(TempA,TempName,MaxSize);
+  return true;
+#elif defined(_WIN_ALL)
+  for (uint I=0;I<100;I++)
+  {
+    swprintf(TempName,MaxSize,L"%ls.%u.tmp",Name,GetCurrentProcessId()+I);
+    HANDLE hFile=CreateFile(TempName,GENERIC_WRITE,0,NULL,CREATE_NEW,
+                            FILE_ATTRIBUTE_TEMPORARY,NULL);
+    if (hFile!=INVALID_HANDLE_VALUE)
+    {
+      Out.SetHandle(hFile);
+      return true;
+    }
+    if (GetLastError()!=ERROR_FILE_EXISTS)
+      break;
+  }
+  return false;
+#else
+  return false;
+#endif
+}
+
+
+void QuickOpen::WriteCache()
+{
+  wchar Name[NM];
+  if (!GetCacheName(Name,ASIZE(Name),true))
+    return;
+
+  wchar FullArcName[NM];
+  ConvertNameToFull(Arc->FileName,FullArcName,ASIZE(FullArcName));
+  char NameUtf[NM*4];
+  WideToUtf(FullArcName,NameUtf,ASIZE(NameUtf));
+  size_t NameSize=strlen(NameUtf);
+
+  size_t SampleCount=CacheSamples.Size();
+  Array<byte> Head(CacheHeadSize+NameSize+SampleCount*CacheSampleSize);
+  memcpy(&Head[0],CacheSign,ASIZE(CacheSign));
+  RawPut8(CacheArcSize,&Head[12]);
+  RawPut8(CacheArcTime.GetRaw(),&Head[20]);
+  RawPut8(CacheMainPos,&Head[28]);
+  RawPut8(CacheArcChangeTime,&Head[36]);
+  RawPut8(CacheArcId,&Head[44]);
+  RawPut8(CacheData.Size(),&Head[52]);
+
+  DataHash Hash;
+  Hash.Init(HASH_BLAKE2,1);
+  Hash.Update(&CacheData[0],CacheData.Size());
+  HashValue Value;
+  Hash.Result(&Value);
+  memcpy(&Head[60],Value.Digest,SHA256_DIGEST_SIZE);
+  if (!HashCacheSamples(&Head[92]))
+    return;
+
+  RawPut2((uint)SampleCount,&Head[124]);
+  RawPut2((uint)NameSize,&Head[126]);
+  memcpy(&Head[CacheHeadSize],NameUtf,NameSize);
+  byte *SampleData=&Head[CacheHeadSize+NameSize];
+  for (size_t I=0;I<SampleCount;I++)
+  {
+    RawPut8(CacheSamples[I].Pos,SampleData+I*CacheSampleSize);
+    RawPut4(CacheSamples[I].Size,SampleData+I*CacheSampleSize+8);
+  }
+  RawPut4(CRC32(0xffffffff,&Head[12],Head.Size()-12)^0xffffffff,&Head[8]);
+
+  // Write to temporary file and rename it after, so other processes
+  // never read the incomplete cache.
+  wchar TempName[NM];
+  File CacheOut;
+  CacheOut.SetExceptions(false);
+  if (!CreateCacheTemp(Name,TempName,ASIZE(TempName),CacheOut))
+    return;
+  bool Success=CacheOut.Write(&Head[0],Head.Size()) &&
+               CacheOut.Write(&CacheData[0],CacheData.Size());
+  if (!CacheOut.Close())
+    Success=false;
+  if (Success)
+  {
+    DelFile(Name);
+    Success=RenameFile(TempName,Name);
+  }
+  if (!Success)
+    DelFile(TempName);
+}
@@ -22,10 +22,18 @@ class QuickOpen
     uint ReadBuffer();
     bool ReadRaw(RawRead &Raw);
     bool ReadNext();
+    bool ReadArcBytes(uint64 Pos,byte *Data,size_t Size);
+    bool HashCacheSamples(byte *Digest);
+    bool GetCacheName(wchar *Name,size_t MaxSize,bool Create);
+    bool LoadCache();
+    void WriteCache();
 
     Archive *Arc;
     bool WriteMode;
 
+    File *DataFile; // Archive or cache file containing quick open records.
+    bool DataEncrypted;
+
     QuickOpenItem *ListStart;
     QuickOpenItem *ListEnd;
     
@@ -47,12 +55,35 @@ class QuickOpen
     uint64 LastReadHeaderPos;
     uint64 SeekPos;
     bool UnsyncSeekPos; // QOpen SeekPos does not match an actual file pointer.
+
+    File CacheFile;
+    bool CacheRecord; // Collect headers read from archive to save them to cache.
+    bool CacheHeaderActive; // Archive::ReadHeader is reading a header now.
+    uint64 CacheArcSize;
+    RarTime CacheArcTime;
+    uint64 CacheArcChangeTime;
+    uint64 CacheArcId;
+    uint64 CacheMainPos;
+    uint64 CacheHeaderPos;
+    uint64 CacheLastPos; // Position of last recorded header.
+    Array<byte> CacheHeader; // Data of currently read header.
+    Array<byte> CacheData; // Collected quick open records.
+
+    struct CacheSample {uint64 Pos;uint Size;};
+    Array<CacheSample> CacheSamples; // Headers compared to archive when loading the cache.
+    uint64 CacheHeaderCount; // Number of recorded headers.
+    uint64 CacheSampleStep; // Sample every CacheSampleStep recorded header.
+    static const size_t CacheMaxSamples=256;
   public:
     QuickOpen();
     ~QuickOpen();
     void Init(Archive *Arc,bool WriteMode);
     void Load(uint64 BlockPos);
-    void Unload() { Loaded=false; }
+    void Unload() { Loaded=false; CacheRecord=false; }
+    void InitCache(Archive *Arc,uint64 MainPos);
+    void CacheHeaderStart(uint64 Pos);
+    void CacheHeaderRead(const void *Data,size_t Size);
+    void CacheHeaderEnd(bool Valid,bool EndArc);
     bool Read(void *Data,size_t Size,size_t &Result);
     bool Seek(int64 Offset,int Method);
     bool Tell(int64 *Pos);
@@ -1,6 +1,7 @@
 #include "rar.hpp"
 
 #include "rarvmtbl.cpp"
+#include "filtfn.cpp"
 
 RarVM::RarVM()
 :BitInput(true)
@@ -889,6 +890,13 @@ void RarVM::ExecuteStandardFilter(VM_StandardFilters FilterType)
         byte CmpByte2=FilterType==VMSF_E8E9 ? 0xe9:0xe8;
         for (int CurPos=0;CurPos<DataSize-4;)
         {
+          // Skip bytes which are not opcodes.
+          int NextPos=FindE8(Mem,CurPos,DataSize-4,CmpByte2);
+          Data+=NextPos-CurPos;
+          CurPos=NextPos;
+          if (CurPos>=DataSize-4)
+            break;
+
           byte CurByte=*(Data++);
           CurPos++;
           if (CurByte==0xe8 || CurByte==CmpByte2)
@@ -963,19 +971,15 @@ void RarVM::ExecuteStandardFilter(VM_StandardFilters FilterType)
       break;
     case VMSF_DELTA:
       {
-        int DataSize=R[4],Channels=R[0],SrcPos=0,Border=DataSize*2;
+        int DataSize=R[4],Channels=R[0];
         SET_VALUE(false,&Mem[VM_GLOBALMEMADDR+0x20],DataSize);
         if ((uint)DataSize>=VM_GLOBALMEMADDR/2)
           break;
 
         // Bytes from same channels are grouped to continual data blocks,
         // so we need to place them back to their interleaving positions.
-        for (int CurChannel=0;CurChannel<Channels;CurChannel++)
-        {
-          byte PrevByte=0;
-          for (int DestPos=DataSize+CurChannel;DestPos<Border;DestPos+=Channels)
-            Mem[DestPos]=(PrevByte-=Mem[SrcPos++]);
-        }
+        if (Channels>0)
+          DeltaDecode(Mem+DataSize,Mem,DataSize,Channels);
       }
       break;
     case VMSF_RGB:
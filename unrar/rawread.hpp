@@ -55,6 +55,13 @@ inline uint64 RawGet8(const byte *D)
 }
 
 
+// Big endian values are used in SHA-256 calculations.
+inline uint32 RawGetBE4(const byte *D)
+{
+  return D[3]+(D[2]<<8)+(D[1]<<16)+((uint32)D[0]<<24);
+}
+
+
 // We need these "put" functions also in UnRAR code. This is why they are
 // in rawread.hpp file even though they are "write" functions.
 inline void RawPut2(uint Field,byte *Data)
@@ -73,6 +80,15 @@ inline void RawPut4(uint Field,byte *Data)
 }
 
 
+inline void RawPutBE4(uint32 Field,byte *Data)
+{
+  Data[0]=(byte)(Field>>24);
+  Data[1]=(byte)(Field>>16);
+  Data[2]=(byte)(Field>>8);
+  Data[3]=(byte)(Field);
+}
+
+
 inline void RawPut8(uint64 Field,byte *Data)
 {
   Data[0]=(byte)(Field);
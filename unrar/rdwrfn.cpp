@@ -183,6 +183,34 @@ void ComprDataIO::UnpWrite(byte *Addr,size_t Count)
 #endif
 
 
+// Return the destination file position or 0 if we do not write a file.
+int64 ComprDataIO::GetDestPos()
+{
+  if (UnpackToMemory || TestMode || DestFile==NULL || !DestFile->IsOpened() ||
+      DestFile->GetHandleType()!=FILE_HANDLENORMAL)
+    return 0;
+  return DestFile->Tell();
+}
+
+
+// Ask to repeat the write failed in unpack writer thread, which does not
+// display prompts, and seek back to position Pos of failed data.
+void ComprDataIO::AskRepeatWrite(int64 Pos)
+{
+  while (true)
+  {
+    if (!ErrHandler.AskRepeatWrite(DestFile->FileName,false))
+      ErrHandler.WriteError(NULL,DestFile->FileName);
+#ifndef _WIN_ALL
+    clearerr(DestFile->GetHandle());
+#endif
+    // Seek writes data left in write buffer, so it can fail again.
+    if (DestFile->RawSeek(Pos,SEEK_SET))
+      break;
+  }
+}
+
+
 
 
 
@@ -52,6 +52,8 @@ class ComprDataIO
     void Init();
     int UnpRead(byte *Addr,size_t Count);
     void UnpWrite(byte *Addr,size_t Count);
+    int64 GetDestPos();
+    void AskRepeatWrite(int64 Pos);
     void EnableShowProgress(bool Show) {ShowProgress=Show;}
     void GetUnpackedData(byte **Data,size_t *Size);
     void SetPackedSizeToRead(int64 Size) {UnpPackedSize=Size;}
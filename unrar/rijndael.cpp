@@ -7,6 +7,21 @@
  ***************************************************************************/
 #include "rar.hpp"
 
+#ifdef USE_AES_NI
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#ifdef _MSC_VER
+#define AES_NI_ATTR
+#else
+#include <cpuid.h>
+#define AES_NI_ATTR __attribute__((target("sse2,aes")))
+#endif
+#endif
+
+#ifdef USE_AES_ARM
+#include <arm_neon.h>
+#endif
+
 static byte S[256],S5[256],rcon[30];
 static byte T1[256][4],T2[256][4],T3[256][4],T4[256][4];
 static byte T5[256][4],T6[256][4],T7[256][4],T8[256][4];
@@ -66,6 +81,20 @@ Rijndael::Rijndael()
 
 void Rijndael::Init(bool Encrypt,const byte *key,uint keyLen,const byte * initVector)
 {
+#ifdef USE_AES_NI
+  // Check CPU here instead of constructor, so if object is a part of some
+  // structure memset'ed before use, this variable is not lost.
+  uint CPUInfo[4];
+#ifdef _MSC_VER
+  __cpuid((int *)CPUInfo,1);
+#else
+  if (!__get_cpuid(1,&CPUInfo[0],&CPUInfo[1],&CPUInfo[2],&CPUInfo[3]))
+    CPUInfo[2]=CPUInfo[3]=0;
+#endif
+  // ECX bit 25 is AES, EDX bit 26 is SSE2.
+  AES_NI=(CPUInfo[2] & 0x2000000)!=0 && (CPUInfo[3] & 0x4000000)!=0;
+#endif
+
   uint uKeyLenInBytes;
   switch(keyLen)
   {
@@ -104,10 +133,22 @@ size_t Rijndael::blockDecrypt(const byte *input, size_t inputLen, byte *outBuffe
   if (input == 0 || inputLen <= 0)
     return 0;
 
+  size_t numBlocks=inputLen/16;
+#ifdef USE_AES_NI
+  if (AES_NI)
+  {
+    blockDecryptNI(input,numBlocks,outBuffer);
+    return 16*numBlocks;
+  }
+#endif
+#ifdef USE_AES_ARM
+  blockDecryptARM(input,numBlocks,outBuffer);
+  return 16*numBlocks;
+#endif
+
   byte block[16], iv[4][4];
   memcpy(iv,m_initVector,16); 
 
-  size_t numBlocks=inputLen/16;
   for (size_t i = numBlocks; i > 0; i--)
   {
     decrypt(input, block);
@@ -129,6 +170,100 @@ size_t Rijndael::blockDecrypt(const byte *input, size_t inputLen, byte *outBuffe
 }
 
 
+// Decryption with hardware AES instructions. m_expandedKey already contains
+// the equivalent inverse cipher key schedule prepared by keyEncToDec,
+// so it is passed to AESDEC as is. CBC decryption of different blocks
+// is independent, so we process 4 blocks at once to hide the latency
+// of AES instructions.
+#ifdef USE_AES_NI
+AES_NI_ATTR void Rijndael::blockDecryptNI(const byte *input, size_t numBlocks, byte *outBuffer)
+{
+  __m128i Key[_MAX_ROUNDS+1];
+  for (int I=0;I<=m_uRounds;I++)
+    Key[I]=_mm_loadu_si128((__m128i*)m_expandedKey[I]);
+
+  __m128i IV=_mm_loadu_si128((__m128i*)m_initVector);
+  const __m128i *Src=(const __m128i *)input;
+  __m128i *Dest=(__m128i *)outBuffer;
+
+  for (;numBlocks>=4;numBlocks-=4,Src+=4,Dest+=4)
+  {
+    // Load all blocks before storing, input and output can be the same.
+    __m128i C0=_mm_loadu_si128(Src),C1=_mm_loadu_si128(Src+1);
+    __m128i C2=_mm_loadu_si128(Src+2),C3=_mm_loadu_si128(Src+3);
+    __m128i D0=_mm_xor_si128(C0,Key[m_uRounds]);
+    __m128i D1=_mm_xor_si128(C1,Key[m_uRounds]);
+    __m128i D2=_mm_xor_si128(C2,Key[m_uRounds]);
+    __m128i D3=_mm_xor_si128(C3,Key[m_uRounds]);
+    for (int R=m_uRounds-1;R>0;R--)
+    {
+      D0=_mm_aesdec_si128(D0,Key[R]);
+      D1=_mm_aesdec_si128(D1,Key[R]);
+      D2=_mm_aesdec_si128(D2,Key[R]);
+      D3=_mm_aesdec_si128(D3,Key[R]);
+    }
+    _mm_storeu_si128(Dest,  _mm_xor_si128(_mm_aesdeclast_si128(D0,Key[0]),IV));
+    _mm_storeu_si128(Dest+1,_mm_xor_si128(_mm_aesdeclast_si128(D1,Key[0]),C0));
+    _mm_storeu_si128(Dest+2,_mm_xor_si128(_mm_aesdeclast_si128(D2,Key[0]),C1));
+    _mm_storeu_si128(Dest+3,_mm_xor_si128(_mm_aesdeclast_si128(D3,Key[0]),C2));
+    IV=C3;
+  }
+  for (;numBlocks>0;numBlocks--,Src++,Dest++)
+  {
+    __m128i C=_mm_loadu_si128(Src);
+    __m128i D=_mm_xor_si128(C,Key[m_uRounds]);
+    for (int R=m_uRounds-1;R>0;R--)
+      D=_mm_aesdec_si128(D,Key[R]);
+    _mm_storeu_si128(Dest,_mm_xor_si128(_mm_aesdeclast_si128(D,Key[0]),IV));
+    IV=C;
+  }
+  _mm_storeu_si128((__m128i*)m_initVector,IV);
+}
+#endif
+
+
+// ARMv8 AESD performs AddRoundKey before inverse SubBytes and ShiftRows,
+// so the round keys are applied one step earlier than with AES-NI.
+#ifdef USE_AES_ARM
+void Rijndael::blockDecryptARM(const byte *input, size_t numBlocks, byte *outBuffer)
+{
+  uint8x16_t Key[_MAX_ROUNDS+1];
+  for (int I=0;I<=m_uRounds;I++)
+    Key[I]=vld1q_u8(m_expandedKey[I][0]);
+
+  uint8x16_t IV=vld1q_u8(m_initVector);
+
+  for (;numBlocks>=4;numBlocks-=4,input+=64,outBuffer+=64)
+  {
+    uint8x16_t C0=vld1q_u8(input),C1=vld1q_u8(input+16);
+    uint8x16_t C2=vld1q_u8(input+32),C3=vld1q_u8(input+48);
+    uint8x16_t D0=C0,D1=C1,D2=C2,D3=C3;
+    for (int R=m_uRounds;R>1;R--)
+    {
+      D0=vaesimcq_u8(vaesdq_u8(D0,Key[R]));
+      D1=vaesimcq_u8(vaesdq_u8(D1,Key[R]));
+      D2=vaesimcq_u8(vaesdq_u8(D2,Key[R]));
+      D3=vaesimcq_u8(vaesdq_u8(D3,Key[R]));
+    }
+    vst1q_u8(outBuffer,   veorq_u8(veorq_u8(vaesdq_u8(D0,Key[1]),Key[0]),IV));
+    vst1q_u8(outBuffer+16,veorq_u8(veorq_u8(vaesdq_u8(D1,Key[1]),Key[0]),C0));
+    vst1q_u8(outBuffer+32,veorq_u8(veorq_u8(vaesdq_u8(D2,Key[1]),Key[0]),C1));
+    vst1q_u8(outBuffer+48,veorq_u8(veorq_u8(vaesdq_u8(D3,Key[1]),Key[0]),C2));
+    IV=C3;
+  }
+  for (;numBlocks>0;numBlocks--,input+=16,outBuffer+=16)
+  {
+    uint8x16_t C=vld1q_u8(input),D=C;
+    for (int R=m_uRounds;R>1;R--)
+      D=vaesimcq_u8(vaesdq_u8(D,Key[R]));
+    vst1q_u8(outBuffer,veorq_u8(veorq_u8(vaesdq_u8(D,Key[1]),Key[0]),IV));
+    IV=C;
+  }
+  vst1q_u8(m_initVector,IV);
+}
+#endif
+
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // ALGORITHM
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
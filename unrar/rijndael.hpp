@@ -13,6 +13,17 @@
 #define _MAX_ROUNDS      14
 #define MAX_IV_SIZE      16
 
+// Hardware AES decryption. AES-NI is detected at runtime, ARMv8 AES
+// instructions are used if the compiler targets them.
+#if defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES)
+  #define USE_AES_ARM
+#elif defined(_MSC_VER) && _MSC_VER>=1500 && (defined(_M_IX86) || defined(_M_X64))
+  #define USE_AES_NI
+#elif (defined(__i386__) || defined(__x86_64__)) && (defined(__clang__) || \
+      __GNUC__>4 || __GNUC__==4 && __GNUC_MINOR__>=9)
+  #define USE_AES_NI
+#endif
+
 class Rijndael
 { 
   private:
@@ -21,6 +32,13 @@ class Rijndael
     void encrypt(const byte a[16], byte b[16]);
     void decrypt(const byte a[16], byte b[16]);
     void GenerateTables();
+#ifdef USE_AES_NI
+    void blockDecryptNI(const byte *input, size_t numBlocks, byte *outBuffer);
+    bool AES_NI;
+#endif
+#ifdef USE_AES_ARM
+    void blockDecryptARM(const byte *input, size_t numBlocks, byte *outBuffer);
+#endif
 
     int      m_uRounds;
     byte     m_initVector[MAX_IV_SIZE];
@@ -1,6 +1,69 @@
 #include "rar.hpp"
 #include "sha256.hpp"
 
+// x86 SHA extensions are used for single hashes and AVX2 for multi-buffer
+// hashing if CPU supports them. Both are detected at startup.
+#if defined(_MSC_VER) && _MSC_VER>=1900 && (defined(_M_IX86) || defined(_M_X64))
+  #define USE_SHA256_NI
+  #define USE_SHA256_AVX2
+  #define SHA256_NI_ATTR
+  #define SHA256_AVX2_ATTR
+  #include <intrin.h>
+#elif (defined(__i386__) || defined(__x86_64__)) && (defined(__clang__) || \
+      __GNUC__>4 || __GNUC__==4 && __GNUC_MINOR__>=9)
+  #define USE_SHA256_NI
+  #define USE_SHA256_AVX2
+  #define SHA256_NI_ATTR __attribute__((target("sha,sse4.1,ssse3")))
+  #define SHA256_AVX2_ATTR __attribute__((target("avx2")))
+  #include <cpuid.h>
+#endif
+
+#ifdef USE_SHA256_NI
+#include <immintrin.h>
+
+static bool UseSHA_NI,UseAVX2;
+
+static void InitSHA256()
+{
+  uint CPUInfo[4],MaxFunc;
+#ifdef _MSC_VER
+  __cpuid((int *)CPUInfo,0);
+  MaxFunc=CPUInfo[0];
+  __cpuid((int *)CPUInfo,1);
+#else
+  MaxFunc=__get_cpuid_max(0,NULL);
+  __cpuid(1,CPUInfo[0],CPUInfo[1],CPUInfo[2],CPUInfo[3]);
+#endif
+  // ECX bits 9, 19, 27 are SSSE3, SSE4.1, OSXSAVE.
+  bool SSE41=(CPUInfo[2] & 0x80200)==0x80200;
+  bool OSXSave=(CPUInfo[2] & 0x8000000)!=0;
+  if (MaxFunc<7)
+    return;
+#ifdef _MSC_VER
+  __cpuidex((int *)CPUInfo,7,0);
+#else
+  __cpuid_count(7,0,CPUInfo[0],CPUInfo[1],CPUInfo[2],CPUInfo[3]);
+#endif
+  // EBX bit 29 is SHA, bit 5 is AVX2.
+  UseSHA_NI=SSE41 && (CPUInfo[1] & 0x20000000)!=0;
+
+  // AVX2 also needs the OS to save YMM registers, XCR0 bits 1 and 2.
+  if (OSXSave && (CPUInfo[1] & 0x20)!=0)
+  {
+#ifdef _MSC_VER
+    uint64 XCR0=_xgetbv(0);
+#else
+    uint XCR0Lo,XCR0Hi;
+    __asm__ __volatile__ ("xgetbv" : "=a" (XCR0Lo), "=d" (XCR0Hi) : "c" (0));
+    uint64 XCR0=XCR0Lo;
+#endif
+    UseAVX2=(XCR0 & 6)==6;
+  }
+}
+
+struct CallInitSHA256 {CallInitSHA256() {InitSHA256();}} static CallInitSHA;
+#endif
+
 static const uint32 K[64] = 
 {
   0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
@@ -59,12 +122,12 @@ inline uint32 b2i(const byte *b) // Big endian bytes to integer.
 }
 
 
-static void sha256_transform(sha256_context *ctx)
+static void sha256_transform_c(uint32 *H,const byte *Data)
 {
   uint32 W[64]; // Words of message schedule.
   uint32 v[8];  // FIPS a, b, c, d, e, f, g, h working variables.
 
-  if (ctx == NULL) // Clean variables and return.
+  if (H == NULL) // Clean variables and return.
   {
     cleandata(v,sizeof(v));
     cleandata(W,sizeof(W));
@@ -72,19 +135,18 @@ static void sha256_transform(sha256_context *ctx)
   }
 
   // Prepare message schedule. Loop unrolling provides some small gain here.
-  W[0] =  b2i(ctx->Data + 0 * 4 );   W[1] =  b2i(ctx->Data + 1 * 4 );
-  W[2] =  b2i(ctx->Data + 2 * 4 );   W[3] =  b2i(ctx->Data + 3 * 4 );
-  W[4] =  b2i(ctx->Data + 4 * 4 );   W[5] =  b2i(ctx->Data + 5 * 4 );
-  W[6] =  b2i(ctx->Data + 6 * 4 );   W[7] =  b2i(ctx->Data + 7 * 4 );
-  W[8] =  b2i(ctx->Data + 8 * 4 );   W[9] =  b2i(ctx->Data + 9 * 4 );
-  W[10] = b2i(ctx->Data + 10 * 4 );  W[11] = b2i(ctx->Data + 11 * 4 );
-  W[12] = b2i(ctx->Data + 12 * 4 );  W[13] = b2i(ctx->Data + 13 * 4 );
-  W[14] = b2i(ctx->Data + 14 * 4 );  W[15] = b2i(ctx->Data + 15 * 4 );
+  W[0] =  b2i(Data + 0 * 4 );   W[1] =  b2i(Data + 1 * 4 );
+  W[2] =  b2i(Data + 2 * 4 );   W[3] =  b2i(Data + 3 * 4 );
+  W[4] =  b2i(Data + 4 * 4 );   W[5] =  b2i(Data + 5 * 4 );
+  W[6] =  b2i(Data + 6 * 4 );   W[7] =  b2i(Data + 7 * 4 );
+  W[8] =  b2i(Data + 8 * 4 );   W[9] =  b2i(Data + 9 * 4 );
+  W[10] = b2i(Data + 10 * 4 );  W[11] = b2i(Data + 11 * 4 );
+  W[12] = b2i(Data + 12 * 4 );  W[13] = b2i(Data + 13 * 4 );
+  W[14] = b2i(Data + 14 * 4 );  W[15] = b2i(Data + 15 * 4 );
 
   for (uint I = 16; I < 64; I++)
     W[I] = sg1(W[I-2]) + W[I-7] + sg0(W[I-15]) + W[I-16];
 
-  uint32 *H=ctx->H;
   v[0]=H[0]; v[1]=H[1]; v[2]=H[2]; v[3]=H[3];
   v[4]=H[4]; v[5]=H[5]; v[6]=H[6]; v[7]=H[7];
 
@@ -115,6 +177,173 @@ static void sha256_transform(sha256_context *ctx)
 }
 
 
+#ifdef USE_SHA256_NI
+// SHA-256 with x86 SHA extensions. SHA256RNDS2 keeps the state as ABEF and
+// CDGH register pairs and performs two rounds, so every group of four
+// message words needs two instructions. Next message words are calculated
+// with SHA256MSG1 and SHA256MSG2 while earlier groups are processed.
+#define SHA_NI_ROUNDS(G,M) \
+  Msg=_mm_add_epi32(M,_mm_loadu_si128((const __m128i *)(K+4*(G)))); \
+  State1=_mm_sha256rnds2_epu32(State1,State0,Msg); \
+  State0=_mm_sha256rnds2_epu32(State0,State1,_mm_shuffle_epi32(Msg,0x0e));
+
+#define SHA_NI_SCHEDULE(M0,M1,M2,M3) \
+  M0=_mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(M0,M1), \
+                          _mm_alignr_epi8(M3,M2,4)),M3);
+
+SHA256_NI_ATTR static void sha256_transform_ni(uint32 *H,const byte *Data)
+{
+  const __m128i Swap=_mm_set_epi64x(0x0c0d0e0f08090a0bLL,0x0405060700010203LL);
+
+  __m128i Tmp=_mm_shuffle_epi32(_mm_loadu_si128((__m128i *)H),0xb1); // CDAB
+  __m128i State1=_mm_shuffle_epi32(_mm_loadu_si128((__m128i *)(H+4)),0x1b); // EFGH
+  __m128i State0=_mm_alignr_epi8(Tmp,State1,8); // ABEF
+  State1=_mm_blend_epi16(State1,Tmp,0xf0); // CDGH
+  __m128i SavedState0=State0,SavedState1=State1,Msg;
+
+  __m128i M0=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)Data),Swap);
+  __m128i M1=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(Data+16)),Swap);
+  __m128i M2=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(Data+32)),Swap);
+  __m128i M3=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(Data+48)),Swap);
+
+  for (uint G=0;G<12;G+=4)
+  {
+    SHA_NI_ROUNDS(G,M0)   SHA_NI_SCHEDULE(M0,M1,M2,M3)
+    SHA_NI_ROUNDS(G+1,M1) SHA_NI_SCHEDULE(M1,M2,M3,M0)
+    SHA_NI_ROUNDS(G+2,M2) SHA_NI_SCHEDULE(M2,M3,M0,M1)
+    SHA_NI_ROUNDS(G+3,M3) SHA_NI_SCHEDULE(M3,M0,M1,M2)
+  }
+  SHA_NI_ROUNDS(12,M0)
+  SHA_NI_ROUNDS(13,M1)
+  SHA_NI_ROUNDS(14,M2)
+  SHA_NI_ROUNDS(15,M3)
+
+  State0=_mm_add_epi32(State0,SavedState0);
+  State1=_mm_add_epi32(State1,SavedState1);
+
+  Tmp=_mm_shuffle_epi32(State0,0x1b); // FEBA
+  State1=_mm_shuffle_epi32(State1,0xb1); // DCHG
+  _mm_storeu_si128((__m128i *)H,_mm_blend_epi16(Tmp,State1,0xf0)); // DCBA
+  _mm_storeu_si128((__m128i *)(H+4),_mm_alignr_epi8(State1,Tmp,8)); // HGFE
+}
+#endif
+
+
+static void sha256_transform(sha256_context *ctx)
+{
+#ifdef USE_SHA256_NI
+  if (UseSHA_NI)
+  {
+    // SHA-NI code does not keep any data in memory, nothing to clean.
+    if (ctx != NULL)
+      sha256_transform_ni(ctx->H,ctx->Data);
+    return;
+  }
+#endif
+  if (ctx == NULL)
+    sha256_transform_c(NULL,NULL);
+  else
+    sha256_transform_c(ctx->H,ctx->Data);
+}
+
+
+#ifdef USE_SHA256_AVX2
+// Process 8 independent hashes in parallel, one per 32 bit element of AVX2
+// registers. It is the same algorithm as in sha256_transform_c.
+#define MB_ROTR(x,n) _mm256_or_si256(_mm256_srli_epi32(x,n),_mm256_slli_epi32(x,32-(n)))
+#define MB_XOR3(x,y,z) _mm256_xor_si256(_mm256_xor_si256(x,y),z)
+#define MB_ADD(x,y) _mm256_add_epi32(x,y)
+
+#define MB_ROUND(a,b,c,d,e,f,g,h,I) \
+  { \
+    __m256i T1=MB_ADD(MB_ADD(MB_ADD(h,MB_XOR3(MB_ROTR(e,6),MB_ROTR(e,11),MB_ROTR(e,25))), \
+        _mm256_xor_si256(_mm256_and_si256(e,f),_mm256_andnot_si256(e,g))), \
+        MB_ADD(_mm256_set1_epi32((int)K[I]),W[(I)&15])); \
+    __m256i T2=MB_ADD(MB_XOR3(MB_ROTR(a,2),MB_ROTR(a,13),MB_ROTR(a,22)), \
+        MB_XOR3(_mm256_and_si256(a,b),_mm256_and_si256(a,c),_mm256_and_si256(b,c))); \
+    d=MB_ADD(d,T1); \
+    h=MB_ADD(T1,T2); \
+  }
+
+SHA256_AVX2_ATTR static void sha256_transform_avx2(uint32 H[8][SHA256_MB_LANES],
+                                                  const uint32 Data[16][SHA256_MB_LANES])
+{
+  __m256i W[16],v[8];
+  for (uint I=0;I<16;I++)
+    W[I]=_mm256_loadu_si256((const __m256i *)Data[I]);
+  for (uint I=0;I<8;I++)
+    v[I]=_mm256_loadu_si256((const __m256i *)H[I]);
+
+  __m256i a=v[0],b=v[1],c=v[2],d=v[3],e=v[4],f=v[5],g=v[6],h=v[7];
+  for (uint I=0;I<64;I+=8)
+  {
+    if (I>=16)
+      for (uint J=I;J<I+8;J++)
+      {
+        __m256i W2=W[(J-2)&15],W15=W[(J-15)&15];
+        __m256i S1=MB_XOR3(MB_ROTR(W2,17),MB_ROTR(W2,19),_mm256_srli_epi32(W2,10));
+        __m256i S0=MB_XOR3(MB_ROTR(W15,7),MB_ROTR(W15,18),_mm256_srli_epi32(W15,3));
+        W[J&15]=MB_ADD(MB_ADD(S1,W[(J-7)&15]),MB_ADD(S0,W[J&15]));
+      }
+    MB_ROUND(a,b,c,d,e,f,g,h,I);
+    MB_ROUND(h,a,b,c,d,e,f,g,I+1);
+    MB_ROUND(g,h,a,b,c,d,e,f,I+2);
+    MB_ROUND(f,g,h,a,b,c,d,e,I+3);
+    MB_ROUND(e,f,g,h,a,b,c,d,I+4);
+    MB_ROUND(d,e,f,g,h,a,b,c,I+5);
+    MB_ROUND(c,d,e,f,g,h,a,b,I+6);
+    MB_ROUND(b,c,d,e,f,g,h,a,I+7);
+  }
+  v[0]=MB_ADD(v[0],a); v[1]=MB_ADD(v[1],b); v[2]=MB_ADD(v[2],c); v[3]=MB_ADD(v[3],d);
+  v[4]=MB_ADD(v[4],e); v[5]=MB_ADD(v[5],f); v[6]=MB_ADD(v[6],g); v[7]=MB_ADD(v[7],h);
+  for (uint I=0;I<8;I++)
+    _mm256_storeu_si256((__m256i *)H[I],v[I]);
+}
+#endif
+
+
+bool sha256_mb_fast()
+{
+  // With SHA-NI the one by one fallback is fast too, because it calls
+  // the transform directly without sha256_process and sha256_done overhead.
+#if defined(USE_SHA256_AVX2) && defined(USE_SHA256_NI)
+  return UseAVX2 || UseSHA_NI;
+#else
+  return false;
+#endif
+}
+
+
+void sha256_transform_mb(uint32 H[8][SHA256_MB_LANES],const uint32 W[16][SHA256_MB_LANES])
+{
+#ifdef USE_SHA256_AVX2
+  if (UseAVX2)
+  {
+    sha256_transform_avx2(H,W);
+    return;
+  }
+#endif
+  // Process lanes one by one with the single buffer code.
+  sha256_context ctx;
+  byte Data[64];
+  ctx.Data=Data;
+  for (uint L=0;L<SHA256_MB_LANES;L++)
+  {
+    for (uint I=0;I<16;I++)
+      for (uint J=0;J<4;J++)
+        Data[I*4+J]=byte(W[I][L]>>(24-J*8));
+    for (uint I=0;I<8;I++)
+      ctx.H[I]=H[I][L];
+    sha256_transform(&ctx);
+    for (uint I=0;I<8;I++)
+      H[I][L]=ctx.H[I];
+  }
+  cleandata(&ctx,sizeof(ctx));
+  cleandata(Data,sizeof(Data));
+  sha256_transform(NULL);
+}
+
+
 void sha256_process(sha256_context *ctx, const void *Data, size_t Size)
 {
   const byte *Src=(const byte *)Data;
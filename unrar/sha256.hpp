@@ -19,4 +19,17 @@ void sha256_init(sha256_context *ctx);
 void sha256_process(sha256_context *ctx, const void *Data, size_t Size);
 void sha256_done(sha256_context *ctx, byte *Digest);
 
+// Multi-buffer interface for hashing several independent messages,
+// such as PBKDF2 chains for different passwords, at once.
+#define SHA256_MB_LANES 8
+
+// Update SHA256_MB_LANES hash states with one 64 byte block each.
+// H[I][L] is the state word I of lane L and W[I][L] is the message word I
+// of lane L, already converted from big endian.
+void sha256_transform_mb(uint32 H[8][SHA256_MB_LANES],const uint32 W[16][SHA256_MB_LANES]);
+
+// Return true if sha256_transform_mb is notably faster than hashing
+// the same blocks with sha256_process.
+bool sha256_mb_fast();
+
 #endif
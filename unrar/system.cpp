@@ -101,6 +101,82 @@ void Shutdown()
 
 
 
+// Size of large pages, which we try to use for large allocations.
+static const size_t LargePageSize=0x200000;
+
+
+#if defined(_UNIX) && defined(USE_MMAP_ALLOC)
+// We round sizes of large blocks to large page size, so the entire block
+// can be mapped with large pages. LargeFree needs the same rounded size.
+static size_t LargeAllocSize(size_t Size)
+{
+  return Size<LargePageSize ? Size:(Size+LargePageSize-1) & ~(LargePageSize-1);
+}
+#endif
+
+
+// Allocate zero filled memory for large buffers like the unpack window.
+// If possible, we map memory directly from OS. It is zeroed on demand when
+// pages are touched for first time, so we do not need to memset the entire
+// block in advance, and we try to use large pages to reduce TLB misses.
+// Returns NULL if there is not enough address space or memory.
+// Memory must be released with LargeFree with the same Size.
+byte* LargeAlloc(size_t Size)
+{
+#if defined(_WIN_ALL)
+  return (byte *)VirtualAlloc(NULL,Size,MEM_COMMIT|MEM_RESERVE,PAGE_READWRITE);
+#elif defined(_UNIX) && defined(USE_MMAP_ALLOC)
+  size_t AllocSize=LargeAllocSize(Size);
+  const int Prot=PROT_READ|PROT_WRITE,Flags=MAP_PRIVATE|MAP_ANONYMOUS;
+  if (Size<LargePageSize) // Small block, no large pages.
+  {
+    void *Addr=mmap(NULL,Size,Prot,Flags,-1,0);
+    return Addr==MAP_FAILED ? NULL:(byte *)Addr;
+  }
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+  // Explicit huge pages are available only if administrator reserved them,
+  // otherwise mmap fails immediately and we continue with normal pages.
+  void *HugeAddr=mmap(NULL,AllocSize,Prot,Flags|MAP_HUGETLB|(21<<MAP_HUGE_SHIFT),-1,0);
+  if (HugeAddr!=MAP_FAILED)
+    return (byte *)HugeAddr;
+#endif
+
+  // Transparent huge pages need the block aligned to large page size,
+  // so we reserve more address space and unmap unaligned parts.
+  byte *Addr=(byte *)mmap(NULL,AllocSize+LargePageSize,Prot,Flags,-1,0);
+  if (Addr==(byte *)MAP_FAILED)
+    return NULL;
+  byte *Aligned=(byte *)ALIGN_VALUE(Addr,LargePageSize);
+  if (Aligned>Addr)
+    munmap(Addr,Aligned-Addr);
+  munmap(Aligned+AllocSize,Addr+LargePageSize-Aligned);
+#ifdef MADV_HUGEPAGE
+  madvise(Aligned,AllocSize,MADV_HUGEPAGE);
+#endif
+  return Aligned;
+#else
+  byte *Addr=(byte *)malloc(Size);
+  if (Addr!=NULL)
+    memset(Addr,0,Size);
+  return Addr;
+#endif
+}
+
+
+void LargeFree(byte *Addr,size_t Size)
+{
+  if (Addr==NULL)
+    return;
+#if defined(_WIN_ALL)
+  VirtualFree(Addr,0,MEM_RELEASE);
+#elif defined(_UNIX) && defined(USE_MMAP_ALLOC)
+  munmap(Addr,LargeAllocSize(Size));
+#else
+  free(Addr);
+#endif
+}
+
+
 #ifdef USE_SSE
 SSE_VERSION _SSE_Version=GetSSEVersion();
 
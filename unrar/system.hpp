@@ -23,6 +23,9 @@ void Wait();
 bool EmailFile(const wchar *FileName,const wchar *MailToW);
 void Shutdown();
 
+byte* LargeAlloc(size_t Size);
+void LargeFree(byte *Addr,size_t Size);
+
 
 
 #ifdef USE_SSE
@@ -26,6 +26,7 @@ static THREAD_HANDLE ThreadCreate(NATIVE_THREAD_PTR Proc,void *Data)
 
   pthread_t pt;
   int Code=pthread_create(&pt,&attr,Proc,Data);
+  pthread_attr_destroy(&attr);
   if (Code!=0)
   {
     wchar Msg[100];
@@ -118,6 +119,10 @@ uint GetNumberOfCPU()
   uint Count;
   size_t Size=sizeof(Count);
   return sysctlbyname("hw.ncpu",&Count,&Size,NULL,0)==0 ? Count:1;
+#else
+  // No portable way to query the number of CPUs here (AROS and similar).
+  // Use -mt<threads> switch to enable multithreading explicitly.
+  return 1;
 #endif
 #else // !_UNIX
   DWORD_PTR ProcessMask;
@@ -146,3 +151,22 @@ uint GetNumberOfThreads()
   return NumCPU;
 }
 
+
+// Static initializers run in the thread calling main().
+#ifdef _UNIX
+static pthread_t MainThreadId=pthread_self();
+#else
+static DWORD MainThreadId=GetCurrentThreadId();
+#endif
+
+
+// Return true if called from the main thread. Only the main thread
+// is allowed to display messages and prompts.
+bool IsMainThread()
+{
+#ifdef _UNIX
+  return pthread_equal(pthread_self(),MainThreadId)!=0;
+#else
+  return GetCurrentThreadId()==MainThreadId;
+#endif
+}
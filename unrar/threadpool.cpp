@@ -54,6 +54,7 @@ ThreadPool::ThreadPool(uint MaxThreads)
 
   QueueTop = 0;
   QueueBottom = 0;
+  QueueStarted = 0;
   ActiveThreads = 0;
 }
 
@@ -159,7 +160,7 @@ bool ThreadPool::GetQueuedTask(QueueEntry *Task)
 
 // Add task to queue. We assume that it is always called from main thread,
 // it allows to avoid any locks here. We process collected tasks only
-// when StartWait is called.
+// when StartTasks or WaitDone is called.
 void ThreadPool::AddTask(PTHREAD_PROC Proc,void *Data)
 {
   // If queue is full, wait until it is empty.
@@ -172,32 +173,54 @@ void ThreadPool::AddTask(PTHREAD_PROC Proc,void *Data)
 }
 
 
-// Start queued tasks and wait until all threads are inactive.
-// We assume that it is always called from main thread, when pool threads
-// are sleeping yet.
-void ThreadPool::WaitDone()
+// Start queued tasks and return without waiting for their completion,
+// so the main thread can do something else meanwhile. We assume that
+// it is always called from main thread.
+void ThreadPool::StartTasks()
 {
   // We add ASIZE(TaskQueue) for case if TaskQueue array size is not
   // a power of two. Negative numbers would not suit our purpose here.
-  ActiveThreads=(QueueTop+ASIZE(TaskQueue)-QueueBottom) % ASIZE(TaskQueue);
-  if (ActiveThreads==0)
+  uint NewTasks=(QueueTop+ASIZE(TaskQueue)-QueueStarted) % ASIZE(TaskQueue);
+  if (NewTasks==0)
     return;
+  QueueStarted=QueueTop;
+
+  // Threads can be still performing previously started tasks, so we must
+  // update the active state under the same lock as they use to reset it.
+  CriticalSectionStart(&CritSection); 
+  ActiveThreads+=NewTasks;
 #ifdef _WIN_ALL
   ResetEvent(NoneActive);
-  ReleaseSemaphore(QueuedTasksCnt,ActiveThreads,NULL);
-  CWaitForSingleObject(NoneActive);
 #elif defined(_UNIX)
+  pthread_mutex_lock(&AnyActiveMutex);
   AnyActive=true;
+  pthread_mutex_unlock(&AnyActiveMutex);
+#endif
+  CriticalSectionEnd(&CritSection); 
 
+#ifdef _WIN_ALL
+  ReleaseSemaphore(QueuedTasksCnt,NewTasks,NULL);
+#elif defined(_UNIX)
   // Threads reset AnyActive before accessing QueuedTasksCnt and even
   // preceding WaitDone() call does not guarantee that some slow thread
   // is not accessing QueuedTasksCnt now. So lock is necessary.
   pthread_mutex_lock(&QueuedTasksCntMutex);
-  QueuedTasksCnt+=ActiveThreads;
+  QueuedTasksCnt+=NewTasks;
   pthread_mutex_unlock(&QueuedTasksCntMutex);
 
   pthread_cond_broadcast(&QueuedTasksCntCond);
+#endif
+}
 
+
+// Start queued tasks and wait until all threads are inactive.
+// We assume that it is always called from main thread.
+void ThreadPool::WaitDone()
+{
+  StartTasks();
+#ifdef _WIN_ALL
+  CWaitForSingleObject(NoneActive);
+#elif defined(_UNIX)
   pthread_mutex_lock(&AnyActiveMutex);
   while (AnyActive)
     cpthread_cond_wait(&AnyActiveCond,&AnyActiveMutex);
@@ -32,6 +32,7 @@ typedef void (*PTHREAD_PROC)(void *Data);
 
 uint GetNumberOfCPU();
 uint GetNumberOfThreads();
+bool IsMainThread();
 
 
 class ThreadPool
@@ -56,6 +57,7 @@ class ThreadPool
   	QueueEntry TaskQueue[MaxPoolThreads];
   	uint QueueTop;
   	uint QueueBottom;
+    uint QueueStarted; // Queue position after last started task.
 
     bool Closing; // Set true to quit all threads.
   	
@@ -86,6 +88,7 @@ class ThreadPool
     ThreadPool(uint MaxThreads);
     ~ThreadPool();
     void AddTask(PTHREAD_PROC Proc,void *Data);
+    void StartTasks();
     void WaitDone();
 
 #ifdef _WIN_ALL
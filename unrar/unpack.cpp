@@ -4,6 +4,7 @@
 #include "suballoc.cpp"
 #include "model.cpp"
 #include "unpackinline.cpp"
+#include "filtfn.cpp"
 #ifdef RAR_SMP
 #include "unpack50mt.cpp"
 #endif
@@ -21,12 +22,21 @@ Unpack::Unpack(ComprDataIO *DataIO)
   UnpIO=DataIO;
   Window=NULL;
   Fragmented=false;
+  UnpPtr=WrPtr=0;
+  WinWrapped=false;
   Suspended=false;
   UnpAllBuf=false;
   UnpSomeRead=false;
 #ifdef RAR_SMP
   MaxUserThreads=1;
   UnpThreadPool=CreateThreadPool();
+  UnpWritePool=NULL;
+  WriteAsync=false;
+  WriteJobError=RARX_SUCCESS;
+  WriteJobSysErr=0;
+  WriteJobPos=0;
+  WriteJobOut=NULL;
+  WriteJobFilePos=0;
   ReadBufMT=NULL;
   UnpThreadData=NULL;
 #endif
@@ -47,10 +57,14 @@ Unpack::Unpack(ComprDataIO *DataIO)
 
 Unpack::~Unpack()
 {
+#ifdef RAR_SMP
+  // Writer thread can still access the window if unpacking was interrupted
+  // by exception, so we wait for it before releasing the window.
+  delete UnpWritePool;
+#endif
   InitFilters30();
 
-  if (Window!=NULL)
-    free(Window);
+  LargeFree(Window,MaxWinSize);
 #ifdef RAR_SMP
   DestroyThreadPool(UnpThreadPool);
   delete[] ReadBufMT;
@@ -87,26 +101,35 @@ void Unpack::Init(size_t WinSize,bool Solid)
   // extra cautious, we still handle the solid window grow case below.
   bool Grow=Solid && (Window!=NULL || Fragmented);
 
-  byte *NewWindow=(byte *)malloc(WinSize);
-
   // We do not handle growth for fragmented window now.
-  if (Grow && (NewWindow==NULL || Fragmented))
+  if (Grow && Fragmented)
     throw std::bad_alloc();
 
+  // Window must be clean to generate the same output when unpacking corrupt
+  // RAR files, which may access to unused areas of sliding dictionary.
+  // LargeAlloc returns zero filled memory. If it is mapped from OS,
+  // pages are zeroed when touched first time, so we do not need to clean
+  // the entire window before unpacking.
+  byte *NewWindow=LargeAlloc(WinSize);
+
   if (NewWindow==NULL)
-    if (WinSize<0x1000000) // Exclude RAR4 and small dictionaries.
+    if (Grow || WinSize<0x1000000) // Exclude RAR4 and small dictionaries.
       throw std::bad_alloc();
     else
     {
+      // Not enough address space for a single block, so use fragments.
+      LargeFree(Window,MaxWinSize);
+      Window=NULL;
       FragWindow.Init(WinSize);
       Fragmented=true;
     }
-
-  if (!Fragmented)
+  else
   {
-    // Clean the window to generate the same output when unpacking corrupt
-    // RAR files, which may access to unused areas of sliding dictionary.
-    memset(NewWindow,0,WinSize);
+    if (!Grow) // New window is clean, nothing to clean in UnpInitData.
+    {
+      UnpPtr=WrPtr=0;
+      WinWrapped=false;
+    }
 
     // If Window is not NULL, it means that window size has grown.
     // In solid streams we need to copy data to a new window in such case.
@@ -116,9 +139,13 @@ void Unpack::Init(size_t WinSize,bool Solid)
       for (size_t I=1;I<MaxWinSize;I++)
         NewWindow[(UnpPtr-I)&(WinSize-1)]=Window[(UnpPtr-I)&(MaxWinSize-1)];
 
-    if (Window!=NULL)
-      free(Window);
+    LargeFree(Window,MaxWinSize);
     Window=NewWindow;
+    if (Fragmented)
+    {
+      FragWindow.Reset();
+      Fragmented=false;
+    }
   }
 
   MaxWinSize=WinSize;
@@ -126,8 +153,42 @@ void Unpack::Init(size_t WinSize,bool Solid)
 }
 
 
+// Window must be clean to unpack corrupt RAR files, which may access
+// to unused areas of sliding dictionary, the same way regardless of
+// preceding files. We reuse the window for all files, so instead of
+// cleaning the entire window for every non-solid file, we clean only
+// the part, which could be used by previous file.
+void Unpack::CleanUsedWindow()
+{
+  size_t UsedSize=WinWrapped || UnpPtr<WrPtr ? MaxWinSize:UnpPtr;
+  if (Fragmented)
+    for (size_t Pos=0;Pos<UsedSize;)
+    {
+      size_t BlockSize=FragWindow.GetBlockSize(Pos,UsedSize-Pos);
+      memset(&FragWindow[Pos],0,BlockSize);
+      Pos+=BlockSize;
+    }
+  else
+    if (Window!=NULL)
+      memset(Window,0,UsedSize);
+}
+
+
 void Unpack::DoUnpack(int Method,bool Solid)
 {
+#ifdef RAR_SMP
+  UnpWriteWait();
+
+  // Write RAR 5.0 data in separate thread while decoding next window area.
+  // In smaller windows decoder would wait for writer too often. We do not
+  // use it in unrar.dll, because user callbacks can expect to be called
+  // in the same thread as unrar.dll functions.
+#ifdef RARDLL
+  WriteAsync=false;
+#else
+  WriteAsync=Method==0 && MaxUserThreads>1 && MaxWinSize>=2*UNPACK_MAX_WRITE;
+#endif
+#endif
   switch(Method)
   {
 #ifndef SFX_MODULE
@@ -161,6 +222,9 @@ void Unpack::DoUnpack(int Method,bool Solid)
       Unpack5(Solid);
       break;
   }
+#ifdef RAR_SMP
+  UnpWriteWait(); // Data must be written when we return.
+#endif
 }
 
 
@@ -171,9 +235,10 @@ void Unpack::UnpInitData(bool Solid)
     memset(OldDist,0,sizeof(OldDist));
     OldDistPtr=0;
     LastDist=LastLength=0;
-//    memset(Window,0,MaxWinSize);
+    CleanUsedWindow();
     memset(&BlockTables,0,sizeof(BlockTables));
     UnpPtr=WrPtr=0;
+    WinWrapped=false;
     WriteBorder=Min(MaxWinSize,UNPACK_MAX_WRITE)&MaxWinMask;
 
     InitFilters();
@@ -330,4 +395,48 @@ void Unpack::MakeDecodeTables(byte *LengthTable,DecodeTable *Dec,uint Size)
     else
       Dec->QuickNum[Code]=0;
   }
+
+  // Prepare the table for codes longer than QuickBits. Such codes start
+  // from DecodeLen[QuickBits] and we index them by bits following this
+  // start code. We use only as many bits as needed to resolve the longest
+  // code. If code space is not filled completely, we may need all 15 bits
+  // to reproduce the slow search result for damaged archives.
+  uint LongStart=Dec->DecodeLen[Dec->QuickBits];
+  uint LongBits=15;
+  for (uint I=Dec->QuickBits+1;I<15;I++)
+    if (Dec->DecodeLen[I]>=0x10000)
+    {
+      LongBits=I;
+      break;
+    }
+  Dec->LongShift=16-LongBits;
+  Dec->LongSize=0;
+  if (LongStart<0x10000)
+  {
+    uint LongDataSize=(0x10000-LongStart)>>Dec->LongShift;
+    if (LongDataSize<=ASIZE(Dec->LongLen))
+      Dec->LongSize=LongDataSize;
+  }
+
+  // Bit length for current code, continue from quick mode bit length.
+  CurBitLength=Dec->QuickBits+1;
+
+  for (uint Code=0;Code<Dec->LongSize;Code++)
+  {
+    // Restore the left aligned bit field for current table position.
+    uint BitField=LongStart+(Code<<Dec->LongShift);
+
+    // Same bit length calculation as in slow search in DecodeNumber.
+    while (CurBitLength<15 && BitField>=Dec->DecodeLen[CurBitLength])
+      CurBitLength++;
+
+    Dec->LongLen[Code]=CurBitLength;
+
+    uint Dist=BitField-Dec->DecodeLen[CurBitLength-1];
+    Dist>>=(16-CurBitLength);
+    uint Pos=Dec->DecodePos[CurBitLength]+Dist;
+
+    // Safety check for damaged archives.
+    Dec->LongNum[Code]=Dec->DecodeNum[Pos<Dec->MaxNum ? Pos:0];
+  }
 }
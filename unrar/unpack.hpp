@@ -4,6 +4,10 @@
 // Maximum allowed number of compressed bits processed in quick mode.
 #define MAX_QUICK_DECODE_BITS      10
 
+// Maximum number of entries in table translating codes longer than quick
+// mode bits. If it is not enough for current code, we use the slow search.
+#define MAX_LONG_DECODE_SIZE     0x1000
+
 // Maximum number of filters per entire data block.
 #define MAX_UNPACK_FILTERS       8192
 
@@ -44,6 +48,20 @@ struct DecodeTable
   // comparting to 'uint' here.
   ushort QuickNum[1<<MAX_QUICK_DECODE_BITS];
 
+  // Number of used LongLen and LongNum items. Zero if codes longer than
+  // QuickBits do not fit these tables and must be found with slow search.
+  uint LongSize;
+
+  // Shift applied to distance from DecodeLen[QuickBits] start code
+  // to get the index in LongLen and LongNum.
+  uint LongShift;
+
+  // Translate bit fields which are too lengthy for quick mode
+  // to bit length and position in alphabet, so every code is decoded
+  // in at most two table lookups.
+  byte LongLen[MAX_LONG_DECODE_SIZE];
+  ushort LongNum[MAX_LONG_DECODE_SIZE];
+
   // Translate the position in code list to position in alphabet.
   // We do not allocate it dynamically to avoid performance overhead
   // introduced by pointer, so we use the largest possible table size
@@ -139,6 +157,21 @@ struct UnpackFilter
 };
 
 
+#ifdef RAR_SMP
+// Data block queued for writing in writer thread. If Filter.Type is not
+// FILTER_NONE, DataPos is the offset of filter source in WriteJobData,
+// otherwise Data is the window address of unfiltered data.
+struct UnpackWriteItem
+{
+  UnpackFilter Filter;
+  byte *Data;
+  size_t DataPos;
+  size_t Size;
+  uint FileOffset; // Used by E8, ARM and Itanium filters.
+};
+#endif
+
+
 struct UnpackFilter30
 {
   unsigned int BlockStart;
@@ -165,8 +198,8 @@ struct AudioVariables // For RAR 2.0 archives only.
 };
 
 
-// We can use the fragmented dictionary in case heap does not have the single
-// large enough memory block. It is slower than normal dictionary.
+// We can use the fragmented dictionary in case address space does not have
+// the single large enough block. It is slower than normal dictionary.
 class FragmentedWindow
 {
   private:
@@ -177,6 +210,7 @@ class FragmentedWindow
     FragmentedWindow();
     ~FragmentedWindow();
     void Init(size_t WinSize);
+    void Reset();
     byte& operator [](size_t Item);
     void CopyString(uint Length,uint Distance,size_t &UnpPtr,size_t MaxWinMask);
     void CopyData(byte *Dest,size_t WinPos,size_t Size);
@@ -194,7 +228,7 @@ class Unpack
     void UnpWriteBuf();
     uint FilterItanium_GetBits(byte *Data,int BitPos,int BitCount);
     void FilterItanium_SetBits(byte *Data,uint BitField,int BitPos,int BitCount);
-    byte* ApplyFilter(byte *Data,uint DataSize,UnpackFilter *Flt);
+    byte* ApplyFilter(byte *Data,uint DataSize,UnpackFilter *Flt,uint FileOffset);
     void UnpWriteArea(size_t StartPtr,size_t EndPtr);
     void UnpWriteData(byte *Data,size_t Size);
     _forceinline uint SlotToLength(BitInput &Inp,uint Slot);
@@ -205,6 +239,7 @@ class Unpack
     void CopyString();
     inline void InsertOldDist(unsigned int Distance);
     void UnpInitData(bool Solid);
+    void CleanUsedWindow();
     _forceinline void CopyString(uint Length,uint Distance);
     uint ReadFilterData(BitInput &Inp);
     bool ReadFilter(BitInput &Inp,UnpackFilter &Filter);
@@ -219,11 +254,30 @@ class Unpack
     void InitMT();
     bool UnpackLargeBlock(UnpackThreadData &D);
     bool ProcessDecoded(UnpackThreadData &D);
+    void UnpWriteQueue(byte *Data,size_t Size,UnpackFilter *Flt);
+    void UnpWriteStart();
+    void UnpWriteWait();
+    void UnpWriteItems(bool Repeat);
 
     ThreadPool *UnpThreadPool;
     UnpackThreadData *UnpThreadData;
     uint MaxUserThreads;
     byte *ReadBufMT;
+
+    // Single thread pool writing data while we decode next window area.
+    ThreadPool *UnpWritePool;
+    bool WriteAsync; // Write RAR 5.0 data in UnpWritePool thread.
+    size_t WriteJobStart; // Window position of first queued data.
+    Array<UnpackWriteItem> WriteJob;
+    Array<byte> WriteJobData; // Copy of filter data queued for writing.
+    RAR_EXIT WriteJobError; // Error code raised in writer thread.
+    int WriteJobSysErr; // System error code of writer thread error.
+
+    // If write fails, these refer to the failed item, so the decoding
+    // thread can write it again without applying the filter twice.
+    size_t WriteJobPos; // Index of first not written item.
+    byte *WriteJobOut; // Data of WriteJobPos item, filtered if necessary.
+    int64 WriteJobFilePos; // Destination file position of WriteJobPos item.
 #endif
 
     Array<byte> FilterSrcMemory;
@@ -259,6 +313,11 @@ class Unpack
     FragmentedWindow FragWindow;
     bool Fragmented;
 
+    // Set if write pointer passed the window end when unpacking current
+    // non-solid stream, so the entire window can contain its data.
+    // Otherwise only data before UnpPtr are used.
+    bool WinWrapped;
+
 
     int64 DestUnpSize;
 
@@ -366,6 +425,7 @@ class Unpack
     void SetThreads(uint Threads) {MaxUserThreads=Min(Threads,8);}
 
     void UnpackDecode(UnpackThreadData &D);
+    void UnpWriteJob();
 #endif
 
     size_t MaxWinSize;
@@ -156,6 +156,7 @@ void Unpack::UnpWriteBuf20()
     UnpIO->UnpWrite(&Window[WrPtr],-(int)WrPtr & MaxWinMask);
     UnpIO->UnpWrite(Window,UnpPtr);
     UnpAllBuf=true;
+    WinWrapped=true;
   }
   else
     UnpIO->UnpWrite(&Window[WrPtr],UnpPtr-WrPtr);
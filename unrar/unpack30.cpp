@@ -677,6 +677,8 @@ void Unpack::UnpWriteBuf30()
           if (flt!=NULL && flt->NextWindow)
             flt->NextWindow=false;
         }
+        if (WrittenBorder<WrPtr)
+          WinWrapped=true;
         WrPtr=WrittenBorder;
         return;
       }
@@ -684,6 +686,8 @@ void Unpack::UnpWriteBuf30()
   }
       
   UnpWriteArea(WrittenBorder,UnpPtr);
+  if (UnpPtr<WrPtr)
+    WinWrapped=true;
   WrPtr=UnpPtr;
 }
 
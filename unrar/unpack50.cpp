@@ -246,6 +246,15 @@ bool Unpack::UnpReadBuf()
 
 void Unpack::UnpWriteBuf()
 {
+#ifdef RAR_SMP
+  if (WriteAsync)
+  {
+    // Wait until the previous data are written, so we can queue new data
+    // and reuse the window area occupied by previous data.
+    UnpWriteWait();
+    WriteJobStart=WrPtr;
+  }
+#endif
   size_t WrittenBorder=WrPtr;
   size_t FullWriteSize=(UnpPtr-WrittenBorder)&MaxWinMask;
   size_t WriteSizeLeft=FullWriteSize;
@@ -295,8 +304,21 @@ void Unpack::UnpWriteBuf()
         {
           uint BlockEnd=(BlockStart+BlockLength)&MaxWinMask;
 
-          FilterSrcMemory.Alloc(BlockLength);
-          byte *Mem=&FilterSrcMemory[0];
+          byte *Mem;
+#ifdef RAR_SMP
+          if (WriteAsync)
+          {
+            // Filter will be applied in writer thread, so we copy its data
+            // directly to write job buffer.
+            WriteJobData.Add(BlockLength);
+            Mem=&WriteJobData[WriteJobData.Size()-BlockLength];
+          }
+          else
+#endif
+          {
+            FilterSrcMemory.Alloc(BlockLength);
+            Mem=&FilterSrcMemory[0];
+          }
           if (BlockStart<BlockEnd || BlockEnd==0)
           {
             if (Fragmented)
@@ -319,13 +341,19 @@ void Unpack::UnpWriteBuf()
             }
           }
 
-          byte *OutMem=ApplyFilter(Mem,BlockLength,flt);
+#ifdef RAR_SMP
+          if (WriteAsync)
+            UnpWriteQueue(Mem,BlockLength,flt);
+          else
+#endif
+          {
+            byte *OutMem=ApplyFilter(Mem,BlockLength,flt,(uint)WrittenFileSize);
+            if (OutMem!=NULL)
+              UnpIO->UnpWrite(OutMem,BlockLength);
+          }
 
           Filters[I].Type=FILTER_NONE;
 
-          if (OutMem!=NULL)
-            UnpIO->UnpWrite(OutMem,BlockLength);
-
           UnpSomeRead=true;
           WrittenFileSize+=BlockLength;
           WrittenBorder=BlockEnd;
@@ -336,6 +364,8 @@ void Unpack::UnpWriteBuf()
       {
         // Current filter intersects the window write border, so we adjust
         // the window border to process this filter next time, not now.
+        if (WrittenBorder<WrPtr)
+          WinWrapped=true;
         WrPtr=WrittenBorder;
 
         // Since Filter start position can only increase, we quit processing
@@ -371,6 +401,8 @@ void Unpack::UnpWriteBuf()
   {
     // Write data left after last filter.
     UnpWriteArea(WrittenBorder,UnpPtr);
+    if (UnpPtr<WrPtr)
+      WinWrapped=true;
     WrPtr=UnpPtr;
   }
 
@@ -378,11 +410,28 @@ void Unpack::UnpWriteBuf()
   // instead of potentially huge MaxWinSize blocks.
   WriteBorder=(UnpPtr+Min(MaxWinSize,UNPACK_MAX_WRITE))&MaxWinMask;
 
-  // Choose the nearest among WriteBorder and WrPtr actual written border.
+  // Data before WrPtr can be still not written in asynchronous mode,
+  // so we must not overwrite them until the writer thread is done.
+  size_t UsedPtr=WrPtr;
+#ifdef RAR_SMP
+  if (WriteAsync && WriteJob.Size()>0)
+  {
+    UnpWriteStart();
+
+    // Decoder needs the space for longest match after this call. If queued
+    // data are too close, we have no choice but to wait for writer here.
+    if (((WriteJobStart-UnpPtr)&MaxWinMask)<MAX_LZ_MATCH+3)
+      UnpWriteWait();
+    else
+      UsedPtr=WriteJobStart;
+  }
+#endif
+
+  // Choose the nearest among WriteBorder and UsedPtr border of data to keep.
   // If border is equal to UnpPtr, it means that we have MaxWinSize data ahead.
   if (WriteBorder==UnpPtr || 
-      WrPtr!=UnpPtr && ((WrPtr-UnpPtr)&MaxWinMask)<((WriteBorder-UnpPtr)&MaxWinMask))
-    WriteBorder=WrPtr;
+      UsedPtr!=UnpPtr && ((UsedPtr-UnpPtr)&MaxWinMask)<((WriteBorder-UnpPtr)&MaxWinMask))
+    WriteBorder=UsedPtr;
 }
 
 
@@ -442,7 +491,49 @@ inline void SetFiltData32(byte *Data,uint Value)
 }
 
 
-byte* Unpack::ApplyFilter(byte *Data,uint DataSize,UnpackFilter *Flt)
+// Convert absolute addresses of ARM BL instructions to relative, 4 commands
+// at once. Return the number of processed bytes, remaining data must be
+// processed by caller.
+static uint FilterArmVec(byte *Data,uint DataSize,uint FileOffset)
+{
+  uint CurPos=0;
+#ifdef USE_FILT_SSE
+  const __m128i OpMask=_mm_set1_epi32(0xff000000),OpBL=_mm_set1_epi32(0xeb000000);
+  const __m128i AddrMask=_mm_set1_epi32(0xffffff),Step=_mm_set1_epi32(4);
+
+  // (FileOffset+CurPos)/4 for every command in vector.
+  __m128i Offset=_mm_add_epi32(_mm_set1_epi32(FileOffset/4),_mm_setr_epi32(0,1,2,3));
+  for (;CurPos+16<=DataSize;CurPos+=16)
+  {
+    __m128i D=_mm_loadu_si128((__m128i *)(Data+CurPos));
+    __m128i IsBL=_mm_cmpeq_epi32(_mm_and_si128(D,OpMask),OpBL);
+    __m128i NewD=_mm_or_si128(_mm_and_si128(_mm_sub_epi32(D,Offset),AddrMask),OpBL);
+    D=_mm_or_si128(_mm_and_si128(IsBL,NewD),_mm_andnot_si128(IsBL,D));
+    _mm_storeu_si128((__m128i *)(Data+CurPos),D);
+    Offset=_mm_add_epi32(Offset,Step);
+  }
+#endif
+#ifdef USE_FILT_NEON
+  const uint32x4_t OpMask=vdupq_n_u32(0xff000000),OpBL=vdupq_n_u32(0xeb000000);
+  const uint32x4_t AddrMask=vdupq_n_u32(0xffffff),Step=vdupq_n_u32(4);
+  const uint32_t Inc[4]={0,1,2,3};
+
+  uint32x4_t Offset=vaddq_u32(vdupq_n_u32(FileOffset/4),vld1q_u32(Inc));
+  for (;CurPos+16<=DataSize;CurPos+=16)
+  {
+    uint32x4_t D=vreinterpretq_u32_u8(vld1q_u8(Data+CurPos));
+    uint32x4_t IsBL=vceqq_u32(vandq_u32(D,OpMask),OpBL);
+    uint32x4_t NewD=vorrq_u32(vandq_u32(vsubq_u32(D,Offset),AddrMask),OpBL);
+    D=vbslq_u32(IsBL,NewD,D);
+    vst1q_u8(Data+CurPos,vreinterpretq_u8_u32(D));
+    Offset=vaddq_u32(Offset,Step);
+  }
+#endif
+  return CurPos;
+}
+
+
+byte* Unpack::ApplyFilter(byte *Data,uint DataSize,UnpackFilter *Flt,uint FileOffset)
 {
   byte *SrcData=Data;
   switch(Flt->Type)
@@ -450,12 +541,17 @@ byte* Unpack::ApplyFilter(byte *Data,uint DataSize,UnpackFilter *Flt)
     case FILTER_E8:
     case FILTER_E8E9:
       {
-        uint FileOffset=(uint)WrittenFileSize;
-
         const int FileSize=0x1000000;
         byte CmpByte2=Flt->Type==FILTER_E8E9 ? 0xe9:0xe8;
         for (uint CurPos=0;(int)CurPos<(int)DataSize-4;)
         {
+          // Skip bytes which are not opcodes.
+          uint NextPos=FindE8(SrcData,CurPos,DataSize-4,CmpByte2);
+          Data+=NextPos-CurPos;
+          CurPos=NextPos;
+          if (CurPos>=DataSize-4)
+            break;
+
           byte CurByte=*(Data++);
           CurPos++;
           if (CurByte==0xe8 || CurByte==CmpByte2)
@@ -482,8 +578,7 @@ byte* Unpack::ApplyFilter(byte *Data,uint DataSize,UnpackFilter *Flt)
       return SrcData;
     case FILTER_ARM:
       {
-        uint FileOffset=(uint)WrittenFileSize;
-        for (uint CurPos=0;(int)CurPos<(int)DataSize-3;CurPos+=4)
+        for (uint CurPos=FilterArmVec(Data,DataSize,FileOffset);(int)CurPos<(int)DataSize-3;CurPos+=4)
         {
           byte *D=Data+CurPos;
           if (D[3]==0xeb) // BL command with '1110' (Always) condition.
@@ -499,8 +594,6 @@ byte* Unpack::ApplyFilter(byte *Data,uint DataSize,UnpackFilter *Flt)
       return SrcData;
     case FILTER_ITANIUM:
       {
-        uint FileOffset=(uint)WrittenFileSize;
-
         uint CurPos=0;
 
         FileOffset>>=4;
@@ -602,19 +695,14 @@ byte* Unpack::ApplyFilter(byte *Data,uint DataSize,UnpackFilter *Flt)
       }
     case FILTER_DELTA:
       {
-        uint Channels=Flt->Channels,SrcPos=0;
+        uint Channels=Flt->Channels;
 
         FilterDstMemory.Alloc(DataSize);
         byte *DstData=&FilterDstMemory[0];
 
         // Bytes from same channels are grouped to continual data blocks,
         // so we need to place them back to their interleaving positions.
-        for (uint CurChannel=0;CurChannel<Channels;CurChannel++)
-        {
-          byte PrevByte=0;
-          for (uint DestPos=CurChannel;DestPos<DataSize;DestPos+=Channels)
-            DstData[DestPos]=(PrevByte-=Data[SrcPos++]);
-        }
+        DeltaDecode(DstData,Data,DataSize,Channels);
         return DstData;
       }
     case FILTER_RGB:
@@ -709,7 +797,12 @@ void Unpack::UnpWriteData(byte *Data,size_t Size)
   int64 LeftToWrite=DestUnpSize-WrittenFileSize;
   if ((int64)WriteSize>LeftToWrite)
     WriteSize=(size_t)LeftToWrite;
-  UnpIO->UnpWrite(Data,WriteSize);
+#ifdef RAR_SMP
+  if (WriteAsync)
+    UnpWriteQueue(Data,WriteSize,NULL);
+  else
+#endif
+    UnpIO->UnpWrite(Data,WriteSize);
   WrittenFileSize+=Size;
 }
 
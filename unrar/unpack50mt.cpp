@@ -17,6 +17,12 @@ THREAD_PROC(UnpackDecodeThread)
 }
 
 
+THREAD_PROC(UnpackWriteThread)
+{
+  ((Unpack *)Data)->UnpWriteJob();
+}
+
+
 void Unpack::InitMT()
 {
   if (ReadBufMT==NULL)
@@ -655,3 +661,114 @@ bool Unpack::UnpackLargeBlock(UnpackThreadData &D)
   }
   return true;
 }
+
+
+// Add data block to write job. If Flt is not NULL, Data must point
+// to filter source in WriteJobData.
+void Unpack::UnpWriteQueue(byte *Data,size_t Size,UnpackFilter *Flt)
+{
+  if (Size==0)
+    return;
+  UnpackWriteItem Item={};
+  if (Flt!=NULL)
+  {
+    Item.Filter=*Flt;
+    Item.Data=NULL;
+    Item.DataPos=Data-&WriteJobData[0];
+  }
+  else
+  {
+    Item.Filter.Type=FILTER_NONE;
+    Item.Data=Data;
+    Item.DataPos=0;
+  }
+  Item.Size=Size;
+  Item.FileOffset=(uint)WrittenFileSize;
+  WriteJob.Push(Item);
+}
+
+
+// Start writing queued data in writer thread.
+void Unpack::UnpWriteStart()
+{
+  if (UnpWritePool==NULL)
+    UnpWritePool=new ThreadPool(1);
+  WriteJobPos=0;
+  WriteJobFilePos=UnpIO->GetDestPos();
+  UnpWritePool->AddTask(UnpackWriteThread,(void*)this);
+  UnpWritePool->StartTasks();
+}
+
+
+// Wait until queued data are written and report writer thread errors.
+// Writer thread does not display messages and prompts, so we do it here.
+// If user chooses to repeat the failed write, we write the rest of job
+// in this thread.
+void Unpack::UnpWriteWait()
+{
+  if (UnpWritePool!=NULL)
+    UnpWritePool->WaitDone();
+  if (WriteJobError!=RARX_SUCCESS)
+  {
+    RAR_EXIT ErrCode=WriteJobError;
+    WriteJobError=RARX_SUCCESS;
+    ErrHandler.SetSystemErrorCode(WriteJobSysErr);
+    if (ErrCode==RARX_WRITE)
+    {
+      UnpIO->AskRepeatWrite(WriteJobFilePos);
+      UnpWriteItems(true);
+    }
+    else
+    {
+      if (ErrCode==RARX_MEMORY)
+        ErrHandler.MemoryError();
+      ErrHandler.Exit(ErrCode);
+    }
+  }
+  WriteJob.SoftReset();
+  WriteJobData.SoftReset();
+}
+
+
+// Apply filters and write queued items starting from WriteJobPos.
+// If Repeat is true, WriteJobOut already contains data of first item.
+void Unpack::UnpWriteItems(bool Repeat)
+{
+  for (;WriteJobPos<WriteJob.Size();WriteJobPos++)
+  {
+    UnpackWriteItem *Item=&WriteJob[WriteJobPos];
+    if (!Repeat)
+    {
+      WriteJobOut=Item->Data;
+      if (Item->Filter.Type!=FILTER_NONE)
+        WriteJobOut=ApplyFilter(&WriteJobData[Item->DataPos],(uint)Item->Size,
+                                &Item->Filter,Item->FileOffset);
+    }
+    Repeat=false;
+    if (WriteJobOut!=NULL)
+    {
+      UnpIO->UnpWrite(WriteJobOut,Item->Size);
+      WriteJobFilePos+=Item->Size;
+    }
+  }
+}
+
+
+// Apply filters and write data queued by UnpWriteBuf. Called in writer
+// thread, so exceptions are passed to decoding thread in WriteJobError.
+void Unpack::UnpWriteJob()
+{
+  try
+  {
+    UnpWriteItems(false);
+  }
+  catch (RAR_EXIT ErrCode)
+  {
+    WriteJobError=ErrCode;
+    WriteJobSysErr=ErrHandler.GetSystemErrorCode();
+  }
+  catch (std::bad_alloc &)
+  {
+    WriteJobError=RARX_MEMORY;
+  }
+}
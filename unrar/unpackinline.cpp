@@ -6,7 +6,10 @@ _forceinline void Unpack::InsertOldDist(uint Distance)
   OldDist[0]=Distance;
 }
 
-#ifdef _MSC_VER
+// Unaligned 16 byte memcpy is expanded inline to single vector load and
+// store on these platforms.
+#if defined(_MSC_VER) || (defined(__GNUC__) && (defined(__i386__) || \
+    defined(__x86_64__) || defined(__aarch64__)))
 #define FAST_MEMCPY
 #endif
 
@@ -23,36 +26,66 @@ _forceinline void Unpack::CopyString(uint Length,uint Distance)
     UnpPtr+=Length;
 
 #ifdef FAST_MEMCPY
-    if (Distance<Length) // Overlapping strings
-#endif
-      while (Length>=8)
+    if (Distance>=16)
+      while (Length>=16)
       {
-        Dest[0]=Src[0];
-        Dest[1]=Src[1];
-        Dest[2]=Src[2];
-        Dest[3]=Src[3];
-        Dest[4]=Src[4];
-        Dest[5]=Src[5];
-        Dest[6]=Src[6];
-        Dest[7]=Src[7];
-
-        Src+=8;
-        Dest+=8;
-        Length-=8;
+        // We never write beyond the end of string, because data after
+        // UnpPtr can be still referenced by subsequent matches.
+        memcpy(Dest,Src,16);
+
+        Src+=16;
+        Dest+=16;
+        Length-=16;
       }
-#ifdef FAST_MEMCPY
     else
-      while (Length>=8)
+      if (Distance==1 && Length>=16) // Run of same bytes.
       {
-        // This memcpy expanded inline by MSVC. We could also use uint64
-        // assignment, which seems to provide about the same speed.
-        memcpy(Dest,Src,8); 
-
-        Src+=8;
-        Dest+=8;
-        Length-=8;
+        memset(Dest,*Src,Length);
+        return;
       }
+      else
+        if (Distance>0 && Length>=128) // Overlapping strings.
+        {
+          // Replicate the short repeating pattern to local buffer. Reading
+          // 16 bytes just written by byte stores would stall the pipeline,
+          // so we always take data from this buffer, starting from current
+          // position inside of pattern. It pays off for long strings only.
+          byte Pattern[32];
+          for (uint I=0,J=0;I<ASIZE(Pattern);I++)
+          {
+            Pattern[I]=Src[J];
+            if (++J==Distance)
+              J=0;
+          }
+          uint Phase=0,Step=16%Distance;
+          while (Length>=16)
+          {
+            memcpy(Dest,Pattern+Phase,16);
+            Phase+=Step;
+            if (Phase>=Distance)
+              Phase-=Distance;
+
+            Src+=16;
+            Dest+=16;
+            Length-=16;
+          }
+        }
 #endif
+    while (Length>=8)
+    {
+      Dest[0]=Src[0];
+      Dest[1]=Src[1];
+      Dest[2]=Src[2];
+      Dest[3]=Src[3];
+      Dest[4]=Src[4];
+      Dest[5]=Src[5];
+      Dest[6]=Src[6];
+      Dest[7]=Src[7];
+
+      Src+=8;
+      Dest+=8;
+      Length-=8;
+    }
 
     // Unroll the loop for 0 - 7 bytes left. Note that we use nested "if"s.
     if (Length>0) { Dest[0]=Src[0];
@@ -86,6 +119,14 @@ _forceinline uint Unpack::DecodeNumber(BitInput &Inp,DecodeTable *Dec)
     return Dec->QuickNum[Code];
   }
 
+  // Codes longer than QuickBits are usually decoded with second table.
+  uint LongCode=(BitField-Dec->DecodeLen[Dec->QuickBits])>>Dec->LongShift;
+  if (LongCode<Dec->LongSize)
+  {
+    Inp.addbits(Dec->LongLen[LongCode]);
+    return Dec->LongNum[LongCode];
+  }
+
   // Detect the real bit length for current code.
   uint Bits=15;
   for (uint I=Dec->QuickBits+1;I<15;I++)
@@ -33,6 +33,12 @@ static UInt32 MY_FAST_CALL CrcUpdateT1(UInt32 v, const void *data, size_t size,
 
 UInt32 MY_FAST_CALL CrcUpdateT4(UInt32 v, const void *data, size_t size, const UInt32 *table);
 UInt32 MY_FAST_CALL CrcUpdateT8(UInt32 v, const void *data, size_t size, const UInt32 *table);
+#ifdef MY_CPU_X86_OR_AMD64
+UInt32 MY_FAST_CALL CrcUpdateClmul(UInt32 v, const void *data, size_t size, const UInt32 *table);
+#endif
+#if defined(__ARM_FEATURE_CRC32)
+UInt32 MY_FAST_CALL CrcUpdateArm(UInt32 v, const void *data, size_t size, const UInt32 *table);
+#endif
 
 #endif
 
@@ -69,6 +75,11 @@ void MY_FAST_CALL CrcGenerateTable()
   #ifdef MY_CPU_X86_OR_AMD64
   if (!CPU_Is_InOrder())
     g_CrcUpdate = CrcUpdateT8;
+  if (CPU_Is_Clmul_Supported())
+    g_CrcUpdate = CrcUpdateClmul;
+  #endif
+  #if defined(__ARM_FEATURE_CRC32)
+  g_CrcUpdate = CrcUpdateArm;
   #endif
   #endif
 }
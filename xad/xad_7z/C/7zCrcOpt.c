@@ -28,7 +28,116 @@ UInt32 MY_FAST_CALL CrcUpdateT4(UInt32 v, const void *data, size_t size, const U
 
 UInt32 MY_FAST_CALL CrcUpdateT8(UInt32 v, const void *data, size_t size, const UInt32 *table)
 {
-  return CrcUpdateT4(v, data, size, table);
+  const Byte *p = (const Byte *)data;
+  for (; size > 0 && ((unsigned)(ptrdiff_t)p & 7) != 0; size--, p++)
+    v = CRC_UPDATE_BYTE_2(v, *p);
+  for (; size >= 8; size -= 8, p += 8)
+  {
+    UInt32 d;
+    v ^= *(const UInt32 *)p;
+    d = *((const UInt32 *)p + 1);
+    v =
+      table[0x700 + (v & 0xFF)] ^
+      table[0x600 + ((v >> 8) & 0xFF)] ^
+      table[0x500 + ((v >> 16) & 0xFF)] ^
+      table[0x400 + ((v >> 24))] ^
+      table[0x300 + (d & 0xFF)] ^
+      table[0x200 + ((d >> 8) & 0xFF)] ^
+      table[0x100 + ((d >> 16) & 0xFF)] ^
+      table[0x000 + ((d >> 24))];
+  }
+  for (; size > 0; size--, p++)
+    v = CRC_UPDATE_BYTE_2(v, *p);
+  return v;
 }
 
+#ifdef MY_CPU_X86_OR_AMD64
+
+/*
+  CrcUpdateClmul folds the data with PCLMULQDQ in the same way as
+  xad_xz/lzma/liblzma/check/crc_x86_clmul.h, which describes the method.
+  Compilers without the intrinsics get CrcUpdateT8 instead.
+*/
+
+#if defined(_MSC_VER) && _MSC_VER >= 1500
+#define USE_CRC_CLMUL
+#define CRC_CLMUL_ATTRIB
+#elif defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#define USE_CRC_CLMUL
+#define CRC_CLMUL_ATTRIB __attribute__((__target__("sse2,pclmul")))
+#endif
+
+#ifdef USE_CRC_CLMUL
+
+#include <emmintrin.h>
+#include <wmmintrin.h>
+
+#define CRC_CLMUL_FOLD(x, k, y) \
+  x = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00), _mm_clmulepi64_si128(x, k, 0x11)), y)
+
+CRC_CLMUL_ATTRIB
+UInt32 MY_FAST_CALL CrcUpdateClmul(UInt32 v, const void *data, size_t size, const UInt32 *table)
+{
+  const __m128i *p = (const __m128i *)data;
+  __m128i k, x0, x1, x2, x3;
+  Byte temp[16];
+
+  if (size < 64)
+    return CrcUpdateT8(v, data, size, table);
+
+  k = _mm_set_epi32((int)0xCAD38E8F, 0, 0x653D9822, 0);
+  x0 = _mm_xor_si128(_mm_loadu_si128(p), _mm_cvtsi32_si128((int)v));
+  x1 = _mm_loadu_si128(p + 1);
+  x2 = _mm_loadu_si128(p + 2);
+  x3 = _mm_loadu_si128(p + 3);
+  for (p += 4, size -= 64; size >= 64; p += 4, size -= 64)
+  {
+    CRC_CLMUL_FOLD(x0, k, _mm_loadu_si128(p));
+    CRC_CLMUL_FOLD(x1, k, _mm_loadu_si128(p + 1));
+    CRC_CLMUL_FOLD(x2, k, _mm_loadu_si128(p + 2));
+    CRC_CLMUL_FOLD(x3, k, _mm_loadu_si128(p + 3));
+  }
+
+  k = _mm_set_epi32((int)0x9BA54C6F, 0, 0x65673B46, 0);
+  CRC_CLMUL_FOLD(x0, k, x1);
+  CRC_CLMUL_FOLD(x0, k, x2);
+  CRC_CLMUL_FOLD(x0, k, x3);
+  for (; size >= 16; p++, size -= 16)
+    CRC_CLMUL_FOLD(x0, k, _mm_loadu_si128(p));
+
+  _mm_storeu_si128((__m128i *)temp, x0);
+  v = CrcUpdateT8(0, temp, 16, table);
+  return CrcUpdateT8(v, p, size, table);
+}
+
+#else
+
+UInt32 MY_FAST_CALL CrcUpdateClmul(UInt32 v, const void *data, size_t size, const UInt32 *table)
+{
+  return CrcUpdateT8(v, data, size, table);
+}
+
+#endif
+
+#endif
+
+#if defined(__ARM_FEATURE_CRC32)
+
+#include <arm_acle.h>
+
+UInt32 MY_FAST_CALL CrcUpdateArm(UInt32 v, const void *data, size_t size, const UInt32 *table)
+{
+  const Byte *p = (const Byte *)data;
+  for (; size > 0 && ((unsigned)(ptrdiff_t)p & 7) != 0; size--, p++)
+    v = __crc32b(v, *p);
+  for (; size >= 8; size -= 8, p += 8)
+    v = __crc32d(v, *(const UInt64 *)p);
+  for (; size > 0; size--, p++)
+    v = __crc32b(v, *p);
+  (void)table;
+  return v;
+}
+
+#endif
+
 #endif
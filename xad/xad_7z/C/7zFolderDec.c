@@ -0,0 +1,381 @@
+/* 7zFolderDec.c -- Streaming decoding of 7z folders
+2013-11-02 : Public domain */
+
+#include <string.h>
+
+#include "7zFolderDec.h"
+#include "7zCrc.h"
+#include "Bra.h"
+#include "CpuArch.h"
+
+#define k_Copy 0
+#define k_LZMA2 0x21
+#define k_LZMA 0x30101
+#define k_BCJ 0x03030103
+
+#define LZMA_DIC_MIN (1 << 12)
+#define LZMA2_DIC_SIZE_FROM_PROP(p) (((UInt32)2 | ((p) & 1)) << ((p) / 2 + 11))
+
+void SzFolderDec_Construct(CSzFolderDec *p)
+{
+  p->folderIndex = (UInt32)-1;
+  p->dic = NULL;
+  p->buf = NULL;
+  LzmaDec_Construct(&p->lzma);
+  Lzma2Dec_Construct(&p->lzma2);
+}
+
+static void SzFolderDec_Close(CSzFolderDec *p, ISzAlloc *alloc)
+{
+  LzmaDec_FreeProbs(&p->lzma, alloc);
+  Lzma2Dec_FreeProbs(&p->lzma2, alloc);
+  IAlloc_Free(alloc, p->dic);
+  p->dic = NULL;
+  p->folderIndex = (UInt32)-1;
+}
+
+void SzFolderDec_Free(CSzFolderDec *p, ISzAlloc *alloc)
+{
+  SzFolderDec_Close(p, alloc);
+  IAlloc_Free(alloc, p->buf);
+  p->buf = NULL;
+}
+
+static SRes SzFolderDec_Open(CSzFolderDec *p, const CSzArEx *db, UInt32 folderIndex, ISzAlloc *alloc)
+{
+  CSzFolder *folder = db->db.Folders + folderIndex;
+  CSzCoderInfo *coder = &folder->Coders[0];
+  UInt64 unpackSize;
+  UInt64 dicSize = 0;
+
+  SzFolderDec_Close(p, alloc);
+
+  if (folder->NumCoders < 1 || folder->NumCoders > 2 ||
+      folder->NumPackStreams != 1 || folder->PackStreams[0] != 0 ||
+      coder->NumInStreams != 1 || coder->NumOutStreams != 1 ||
+      coder->MethodID > (UInt32)0xFFFFFFFF)
+    return SZ_ERROR_UNSUPPORTED;
+
+  p->bcj = False;
+  if (folder->NumCoders == 2)
+  {
+    CSzCoderInfo *filter = &folder->Coders[1];
+    if (filter->MethodID != k_BCJ ||
+        filter->NumInStreams != 1 || filter->NumOutStreams != 1 ||
+        folder->NumBindPairs != 1 ||
+        folder->BindPairs[0].InIndex != 1 || folder->BindPairs[0].OutIndex != 0)
+      return SZ_ERROR_UNSUPPORTED;
+    p->bcj = True;
+  }
+  else if (folder->NumBindPairs != 0)
+    return SZ_ERROR_UNSUPPORTED;
+
+  unpackSize = folder->UnpackSizes[0];
+  p->methodID = (UInt32)coder->MethodID;
+  switch (p->methodID)
+  {
+    case k_Copy:
+      break;
+    case k_LZMA:
+      if (coder->Props.size < LZMA_PROPS_SIZE)
+        return SZ_ERROR_UNSUPPORTED;
+      dicSize = GetUi32(coder->Props.data + 1);
+      if (dicSize < LZMA_DIC_MIN)
+        dicSize = LZMA_DIC_MIN;
+      break;
+    case k_LZMA2:
+      if (coder->Props.size != 1 || coder->Props.data[0] > 40)
+        return SZ_ERROR_UNSUPPORTED;
+      dicSize = (coder->Props.data[0] == 40) ? 0xFFFFFFFF :
+          LZMA2_DIC_SIZE_FROM_PROP(coder->Props.data[0]);
+      break;
+    default:
+      return SZ_ERROR_UNSUPPORTED;
+  }
+
+  /* The dictionary never needs to be larger than the data it holds. */
+  if (dicSize > unpackSize)
+    dicSize = unpackSize;
+  p->dicSize = (SizeT)dicSize;
+  if (p->dicSize != dicSize)
+    return SZ_ERROR_MEM;
+
+  /* LZMA output is returned straight from the dictionary, unless BCJ
+     has to modify it */
+  p->direct = (p->methodID != k_Copy && !p->bcj);
+  if (!p->direct && p->buf == NULL)
+  {
+    p->buf = (Byte *)IAlloc_Alloc(alloc, SZ_FOLDER_DEC_BUF_SIZE);
+    if (p->buf == NULL)
+      return SZ_ERROR_MEM;
+  }
+
+  if (p->methodID != k_Copy && p->dicSize != 0)
+  {
+    p->dic = (Byte *)IAlloc_Alloc(alloc, p->dicSize);
+    if (p->dic == NULL)
+      return SZ_ERROR_MEM;
+  }
+  if (p->methodID == k_LZMA)
+  {
+    RINOK(LzmaDec_AllocateProbs(&p->lzma, coder->Props.data, (unsigned)coder->Props.size, alloc));
+    p->lzma.dic = p->dic;
+    p->lzma.dicBufSize = p->dicSize;
+    LzmaDec_Init(&p->lzma);
+  }
+  else if (p->methodID == k_LZMA2)
+  {
+    RINOK(Lzma2Dec_AllocateProbs(&p->lzma2, coder->Props.data[0], alloc));
+    p->lzma2.decoder.dic = p->dic;
+    p->lzma2.decoder.dicBufSize = p->dicSize;
+    Lzma2Dec_Init(&p->lzma2);
+  }
+  p->status = LZMA_STATUS_NOT_SPECIFIED;
+
+  p->inPos = SzArEx_GetFolderStreamPos(db, folderIndex, 0);
+  p->packRem = db->db.PackSizes[db->FolderStartPackStreamIndex[folderIndex]];
+  p->unpackRem = unpackSize;
+  if (p->methodID == k_Copy && p->packRem != p->unpackRem)
+    return SZ_ERROR_DATA;
+
+  x86_Convert_Init(p->bcjState);
+  p->bcjIp = 0;
+  p->crc = CRC_INIT_VAL;
+  p->bufPos = p->bufFiltered = p->bufLim = 0;
+  p->fileIndex = db->FolderStartFileIndex[folderIndex];
+  p->folderIndex = folderIndex;
+  return SZ_OK;
+}
+
+static SRes SzFolderDec_Decode(CSzFolderDec *p, const Byte *src, SizeT *srcLen,
+    Byte *dest, SizeT *destLen, ELzmaFinishMode finishMode)
+{
+  if (p->methodID == k_LZMA)
+    return LzmaDec_DecodeToBuf(&p->lzma, dest, destLen, src, srcLen, finishMode, &p->status);
+  if (p->methodID == k_LZMA2)
+    return Lzma2Dec_DecodeToBuf(&p->lzma2, dest, destLen, src, srcLen, finishMode, &p->status);
+  if (*destLen > *srcLen)
+    *destLen = *srcLen;
+  memcpy(dest, src, *destLen);
+  *srcLen = *destLen;
+  return SZ_OK;
+}
+
+/* Reads the end of the coder stream after all data was decoded. */
+static SRes SzFolderDec_Finish(CSzFolderDec *p, ILookInStream *inStream)
+{
+  if (p->methodID == k_Copy)
+    return SZ_OK;
+  for (;;)
+  {
+    const void *inBuf = NULL;
+    size_t lookahead = (1 << 18);
+    SizeT inProcessed, outProcessed = 0;
+
+    if (p->status == LZMA_STATUS_FINISHED_WITH_MARK ||
+        (p->methodID == k_LZMA && p->status == LZMA_STATUS_MAYBE_FINISHED_WITHOUT_MARK))
+      return SZ_OK;
+    if (lookahead > p->packRem)
+      lookahead = (size_t)p->packRem;
+    if (lookahead == 0)
+      return SZ_ERROR_DATA;
+    RINOK(inStream->Look((void *)inStream, &inBuf, &lookahead));
+    inProcessed = (SizeT)lookahead;
+    RINOK(SzFolderDec_Decode(p, (const Byte *)inBuf, &inProcessed, p->buf, &outProcessed, LZMA_FINISH_END));
+    RINOK(inStream->Skip((void *)inStream, inProcessed));
+    p->inPos += inProcessed;
+    p->packRem -= inProcessed;
+    if (inProcessed == 0)
+      return SZ_ERROR_DATA;
+  }
+}
+
+/* Decodes the next part of the folder, when all filtered data was returned. */
+static SRes SzFolderDec_Fill(CSzFolderDec *p, ILookInStream *inStream)
+{
+  size_t rem = p->bufLim - p->bufFiltered;
+
+  /* keep the BCJ tail, it is converted together with the next data */
+  memmove(p->buf, p->buf + p->bufFiltered, rem);
+  p->bufPos = p->bufFiltered = 0;
+  p->bufLim = rem;
+
+  while (p->bufLim != SZ_FOLDER_DEC_BUF_SIZE && p->unpackRem != 0)
+  {
+    const void *inBuf = NULL;
+    size_t lookahead = (1 << 18);
+    SizeT inProcessed, outProcessed = SZ_FOLDER_DEC_BUF_SIZE - p->bufLim;
+    ELzmaFinishMode finishMode = LZMA_FINISH_ANY;
+
+    if (lookahead > p->packRem)
+      lookahead = (size_t)p->packRem;
+    RINOK(inStream->Look((void *)inStream, &inBuf, &lookahead));
+    inProcessed = (SizeT)lookahead;
+    if (outProcessed >= p->unpackRem)
+    {
+      outProcessed = (SizeT)p->unpackRem;
+      finishMode = LZMA_FINISH_END;
+    }
+    RINOK(SzFolderDec_Decode(p, (const Byte *)inBuf, &inProcessed,
+        p->buf + p->bufLim, &outProcessed, finishMode));
+    RINOK(inStream->Skip((void *)inStream, inProcessed));
+    p->inPos += inProcessed;
+    p->packRem -= inProcessed;
+    p->bufLim += outProcessed;
+    p->unpackRem -= outProcessed;
+    if (inProcessed == 0 && outProcessed == 0)
+      return SZ_ERROR_DATA;
+  }
+  if (p->unpackRem == 0)
+  {
+    RINOK(SzFolderDec_Finish(p, inStream));
+  }
+
+  p->bufFiltered = p->bufLim;
+  if (p->bcj)
+  {
+    SizeT processed = x86_Convert(p->buf, p->bufLim, p->bcjIp, &p->bcjState, 0);
+    p->bcjIp += (UInt32)processed;
+    /* last bytes of folder are never converted */
+    if (p->unpackRem != 0)
+      p->bufFiltered = processed;
+  }
+  return SZ_OK;
+}
+
+/* Decodes the next part of the folder in place in the dictionary.
+   bufPos and bufLim refer to the dictionary in this mode. */
+static SRes SzFolderDec_FillDic(CSzFolderDec *p, ILookInStream *inStream)
+{
+  CLzmaDec *dec = (p->methodID == k_LZMA) ? &p->lzma : &p->lzma2.decoder;
+  SizeT limit;
+
+  if (dec->dicPos == dec->dicBufSize)
+    dec->dicPos = 0;
+  p->bufPos = p->bufLim = dec->dicPos;
+  limit = dec->dicBufSize;
+  if (limit - dec->dicPos > SZ_FOLDER_DEC_BUF_SIZE)
+    limit = dec->dicPos + SZ_FOLDER_DEC_BUF_SIZE;
+
+  while (dec->dicPos != limit && p->unpackRem != 0)
+  {
+    const void *inBuf = NULL;
+    size_t lookahead = (1 << 18);
+    SizeT inProcessed, outProcessed, dicLimit = limit;
+    ELzmaFinishMode finishMode = LZMA_FINISH_ANY;
+
+    if (lookahead > p->packRem)
+      lookahead = (size_t)p->packRem;
+    RINOK(inStream->Look((void *)inStream, &inBuf, &lookahead));
+    inProcessed = (SizeT)lookahead;
+    if (dicLimit - dec->dicPos >= p->unpackRem)
+    {
+      dicLimit = dec->dicPos + (SizeT)p->unpackRem;
+      finishMode = LZMA_FINISH_END;
+    }
+    if (p->methodID == k_LZMA)
+      RINOK(LzmaDec_DecodeToDic(&p->lzma, dicLimit, (const Byte *)inBuf, &inProcessed, finishMode, &p->status))
+    else
+      RINOK(Lzma2Dec_DecodeToDic(&p->lzma2, dicLimit, (const Byte *)inBuf, &inProcessed, finishMode, &p->status))
+    RINOK(inStream->Skip((void *)inStream, inProcessed));
+    p->inPos += inProcessed;
+    p->packRem -= inProcessed;
+    outProcessed = dec->dicPos - p->bufLim;
+    p->bufLim = dec->dicPos;
+    p->unpackRem -= outProcessed;
+    if (inProcessed == 0 && outProcessed == 0)
+      return SZ_ERROR_DATA;
+  }
+  if (p->unpackRem == 0)
+  {
+    RINOK(SzFolderDec_Finish(p, inStream));
+  }
+  p->bufFiltered = p->bufLim;
+  return SZ_OK;
+}
+
+static SRes SzFolderDec_Read(CSzFolderDec *p, ILookInStream *inStream, const Byte **data, size_t *size)
+{
+  size_t avail;
+  if (p->bufPos == p->bufFiltered)
+  {
+    if (p->direct)
+      RINOK(SzFolderDec_FillDic(p, inStream))
+    else
+      RINOK(SzFolderDec_Fill(p, inStream))
+  }
+  avail = p->bufFiltered - p->bufPos;
+  if (avail == 0)
+    return SZ_ERROR_DATA;
+  if (*size > avail)
+    *size = avail;
+  *data = (p->direct ? p->dic : p->buf) + p->bufPos;
+  p->bufPos += *size;
+  p->crc = CrcUpdate(p->crc, *data, *size);
+  return SZ_OK;
+}
+
+SRes SzFolderDec_Extract(CSzFolderDec *p, const CSzArEx *db,
+    ILookInStream *inStream, UInt32 fileIndex,
+    ISeqOutStream *outStream, ISzAlloc *allocMain)
+{
+  UInt32 folderIndex = db->FileIndexToFolderIndexMap[fileIndex];
+  CSzFolder *folder;
+  SRes res = SZ_OK;
+
+  if (folderIndex == (UInt32)-1)
+    return SZ_OK;
+  if (p->folderIndex != folderIndex || p->fileIndex > fileIndex)
+  {
+    RINOK(SzFolderDec_Open(p, db, folderIndex, allocMain));
+  }
+  /* the archive stream may have been moved since the previous call */
+  RINOK(LookInStream_SeekTo(inStream, p->inPos));
+
+  while (p->fileIndex <= fileIndex)
+  {
+    const CSzFileItem *f = db->db.Files + p->fileIndex;
+    Bool isTarget = (p->fileIndex == fileIndex);
+    UInt64 rem = f->Size;
+    UInt32 crc = CRC_INIT_VAL;
+
+    while (rem != 0)
+    {
+      const Byte *data;
+      size_t size = SZ_FOLDER_DEC_BUF_SIZE;
+      if (size > rem)
+        size = (size_t)rem;
+      res = SzFolderDec_Read(p, inStream, &data, &size);
+      if (res != SZ_OK)
+        break;
+      rem -= size;
+      if (isTarget)
+      {
+        crc = CrcUpdate(crc, data, size);
+        if (outStream->Write(outStream, data, size) != size)
+        {
+          res = SZ_ERROR_WRITE;
+          break;
+        }
+      }
+    }
+    if (res != SZ_OK)
+    {
+      SzFolderDec_Close(p, allocMain);
+      return res;
+    }
+    p->fileIndex++;
+    if (isTarget && f->CrcDefined && CRC_GET_DIGEST(crc) != f->Crc)
+      res = SZ_ERROR_CRC;
+  }
+
+  folder = db->db.Folders + folderIndex;
+  if (p->unpackRem == 0 && p->bufPos == p->bufLim)
+  {
+    if (folder->UnpackCRCDefined && CRC_GET_DIGEST(p->crc) != folder->UnpackCRC)
+      res = SZ_ERROR_CRC;
+    /* whole folder is decoded, release the dictionary */
+    SzFolderDec_Close(p, allocMain);
+  }
+  return res;
+}
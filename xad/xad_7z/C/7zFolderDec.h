@@ -0,0 +1,74 @@
+/* 7zFolderDec.h -- Streaming decoding of 7z folders
+2013-11-02 : Public domain */
+
+#ifndef __7Z_FOLDER_DEC_H
+#define __7Z_FOLDER_DEC_H
+
+#include "7z.h"
+#include "LzmaDec.h"
+#include "Lzma2Dec.h"
+
+EXTERN_C_BEGIN
+
+/*
+  CSzFolderDec decodes a folder sequentially instead of allocating the
+  whole unpacked folder like SzArEx_Extract. Decoder state is kept between
+  calls, so extracting the files of a solid folder in order decodes the
+  folder only once. Only the memory for the LZMA dictionary (limited to
+  the folder size) is needed. Data is passed to the output stream directly
+  from the dictionary. Copy and BCJ folders use an extra output buffer of
+  SZ_FOLDER_DEC_BUF_SIZE bytes.
+
+  Supported folders: Copy, LZMA and LZMA2, optionally followed by BCJ.
+  SzFolderDec_Extract returns SZ_ERROR_UNSUPPORTED for other folders and
+  the caller can fall back to SzArEx_Extract.
+*/
+
+/* Maximum size of data passed to a single ISeqOutStream::Write call. */
+#ifndef SZ_FOLDER_DEC_BUF_SIZE
+#define SZ_FOLDER_DEC_BUF_SIZE (1 << 20)
+#endif
+
+typedef struct
+{
+  UInt32 folderIndex;  /* (UInt32)-1, if no folder is open */
+  UInt32 fileIndex;    /* next file in folder to be decoded */
+  UInt32 methodID;
+  Bool bcj;
+  Bool direct;         /* output is returned from dic instead of buf */
+  UInt32 bcjState;
+  UInt32 bcjIp;
+
+  CLzmaDec lzma;
+  CLzma2Dec lzma2;
+  ELzmaStatus status;
+  Byte *dic;
+  SizeT dicSize;
+
+  UInt64 inPos;        /* archive position of next packed byte */
+  UInt64 packRem;      /* packed bytes left */
+  UInt64 unpackRem;    /* coder output bytes left */
+  UInt32 crc;          /* CRC of folder output so far */
+
+  Byte *buf;
+  size_t bufPos;       /* start of data not yet returned */
+  size_t bufFiltered;  /* end of data ready to return */
+  size_t bufLim;       /* end of decoded data */
+} CSzFolderDec;
+
+void SzFolderDec_Construct(CSzFolderDec *p);
+void SzFolderDec_Free(CSzFolderDec *p, ISzAlloc *alloc);
+
+/*
+  Decodes file 'fileIndex' and passes its data to outStream in chunks of up
+  to SZ_FOLDER_DEC_BUF_SIZE bytes. Earlier files of the folder are decoded
+  and skipped, if the decoder isn't positioned at this file already.
+*/
+
+SRes SzFolderDec_Extract(CSzFolderDec *p, const CSzArEx *db,
+    ILookInStream *inStream, UInt32 fileIndex,
+    ISeqOutStream *outStream, ISzAlloc *allocMain);
+
+EXTERN_C_END
+
+#endif
@@ -36,7 +36,7 @@ If MY_CPU_LE_UNALIGN is not defined, we don't know about these properties of pla
 #define MY_CPU_32BIT
 #endif
 
-#if defined(_WIN32) && defined(_M_ARM)
+#if (defined(_WIN32) && defined(_M_ARM)) || defined(__ARMEL__) || defined(__AARCH64EL__)
 #define MY_CPU_ARM_LE
 #endif
 
@@ -130,6 +130,7 @@ int x86cpuid_GetFirm(const Cx86cpuid *p);
 
 Bool CPU_Is_InOrder();
 Bool CPU_Is_Aes_Supported();
+Bool CPU_Is_Clmul_Supported();
 
 #endif
 
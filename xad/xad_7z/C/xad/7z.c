@@ -120,6 +120,22 @@ SRes SzFileSeekImp(void *object, Int64 *pos, ESzSeek method)
   return SZ_ERROR_FAIL;
 }
 
+size_t SzFileWriteImp(void *object, const void *buffer, size_t size)
+{
+  CFileXadOutStream *s = (CFileXadOutStream *)object;
+#ifdef __amigaos4__
+	struct xadMasterIFace *IxadMaster = s->IxadMaster;
+#else
+	struct xadMasterBase *xadMasterBase = s->xadMasterBase;
+#endif
+
+	s->err = xadHookAccess(XADAC_WRITE, size, (void *)buffer, s->ai);
+	if(s->err != XADERR_OK)
+		return 0;
+
+	return size;
+}
+
 ULONG ConvertFileTime(CNtfsFileTime *ft)
 {
 #define PERIOD_4 (4 * 365 + 1)
@@ -316,6 +332,7 @@ REG(a6, struct xadMasterBase *xadMasterBase))
 	xad7z->blockIndex = 0xfffffff;
 	xad7z->outBuffer = 0;
 	xad7z->outBufferSize = 0;
+	SzFolderDec_Construct(&xad7z->folderDec);
 
   CrcGenerateTable();
   SzArEx_Init(db);
@@ -381,6 +398,7 @@ REG(a6, struct xadMasterBase *xadMasterBase))
   ISzAlloc allocImp;           /* memory functions for main pool */
   ISzAlloc allocTempImp;       /* memory functions for temporary pool */
 	CLookToRead *lookStream = &xad7z->lookStream;
+	CFileXadOutStream outStream;
 
 	UInt32 *blockIndex = &xad7z->blockIndex;
       Byte **outBuffer = &xad7z->outBuffer; /* it must be 0 before first call for each new archive. */
@@ -409,6 +427,27 @@ REG(a6, struct xadMasterBase *xadMasterBase))
  SysBase = *(struct ExecBase **)4;
 #endif
 
+  outStream.OutStream.Write = SzFileWriteImp;
+  outStream.ai = ai;
+  outStream.err = XADERR_OK;
+#ifdef __amigaos4__
+  outStream.IxadMaster = IxadMaster;
+#else
+  outStream.xadMasterBase = xadMasterBase;
+#endif
+
+  /* decode and write the file in small pieces, keeping the decoder
+     positioned after it for the next file of a solid folder */
+  res = SzFolderDec_Extract(&xad7z->folderDec, db, &lookStream->s,
+    (UInt32)fi->xfi_EntryNumber - 1, &outStream.OutStream, &allocImp);
+
+	if(res == SZ_ERROR_WRITE)
+		return outStream.err;
+
+	if(res != SZ_ERROR_UNSUPPORTED)
+		return sztoxaderr(res);
+
+  /* BCJ2, BZip2 and PPMd folders are decoded to memory as a whole */
   res = SzArEx_Extract(
     db,
     &lookStream->s, 
@@ -423,31 +462,17 @@ REG(a6, struct xadMasterBase *xadMasterBase))
 
 	if(res==SZ_OK)
 	{
-		/* test loopy stuff */
-		UBYTE *tempmem = NULL;
-		long bytes = 0,writebytes=0;
-
-		tempmem = AllocVec(1024,MEMF_CLEAR);
-		if(!tempmem) return XADERR_NOMEMORY;
+		size_t pos, writebytes;
 
-		for(bytes = outSizeProcessed;bytes>0;bytes-=1024)
+		/* write straight from the folder buffer */
+		for(pos = 0; pos < outSizeProcessed; pos += writebytes)
 		{
-			if(bytes>1024)
-			{
-				writebytes = 1024;
-			}
-			else
-			{
-				writebytes = bytes;
-			}
-
-			CopyMem((*outBuffer)+offset+(outSizeProcessed-bytes),tempmem,writebytes);
-			err = xadHookAccess(XADAC_WRITE,writebytes,tempmem,ai);
-			if(err != XADERR_OK) break;
-//			xadHookAccess(XADAC_WRITE,outSizeProcessed,(*outBuffer)+offset, ai);
+			writebytes = outSizeProcessed - pos;
+			if(writebytes > SZ_FOLDER_DEC_BUF_SIZE) writebytes = SZ_FOLDER_DEC_BUF_SIZE;
 
+			err = xadHookAccess(XADAC_WRITE, writebytes, (*outBuffer)+offset+pos, ai);
+			if(err != XADERR_OK) break;
 		}
-		FreeVec(tempmem);
 	}
 
 	if(err==XADERR_OK) err=sztoxaderr(res);
@@ -483,6 +508,7 @@ REG(a6, struct xadMasterBase *xadMasterBase))
 	size_t *outBufferSize = &xad7z->outBufferSize;
 
 //	allocImp.Free(NULL,*outBuffer);
+	SzFolderDec_Free(&xad7z->folderDec, &allocImp);
 	SzArEx_Free(db, &allocImp);
 
 	*outBuffer=0;
@@ -6,6 +6,7 @@
 #endif
 
 #include "../7z.h"
+#include "../7zFolderDec.h"
 #include "7-Zip_rev.h"
 #include <exec/types.h>
 
@@ -33,6 +34,18 @@ typedef struct _CFileInStream
 #endif
 } CFileXadInStream;
 
+typedef struct _CFileXadOutStream
+{
+  ISeqOutStream OutStream;
+  struct xadArchiveInfo *ai;
+  long err;
+#ifdef __amigaos4__
+  struct xadMasterIFace *IxadMaster;
+#else
+	struct xadMasterBase *xadMasterBase;
+#endif
+} CFileXadOutStream;
+
 struct xad7zprivate {
 	CFileXadInStream archiveStream;
 	CLookToRead lookStream;
@@ -42,6 +55,7 @@ struct xad7zprivate {
 	UInt32 blockIndex;
 	Byte *outBuffer;
 	size_t outBufferSize;
+	CSzFolderDec folderDec;
 };
 
 #endif
@@ -0,0 +1,20 @@
+/* Host stand-in for AROS exec.library, used by unrarlib tests */
+
+#ifndef TEST_PROTO_EXEC_H
+#define TEST_PROTO_EXEC_H
+
+#include <stdlib.h>
+
+#define MEMF_CLEAR (1L<<16)
+
+static inline void* AllocVec( unsigned long size, unsigned long flags )
+{
+	return (flags & MEMF_CLEAR) ? calloc( 1, size ) : malloc( size );
+}
+
+static inline void FreeVec( void* p )
+{
+	free( p );
+}
+
+#endif
@@ -0,0 +1,34 @@
+/* Host stand-in for xadmaster.library, used by unrarlib tests. Input is
+   read from memory and output is collected by the test hook. */
+
+#ifndef TEST_PROTO_XADMASTER_H
+#define TEST_PROTO_XADMASTER_H
+
+#define XADERR_OK           0
+#define XADERR_INPUT        3
+#define XADERR_OUTPUT       4
+
+#define XADAC_READ          10
+#define XADAC_WRITE         11
+#define XADAC_INPUTSEEK     13
+
+struct xadMasterBase;
+struct xadMasterIFace;
+
+struct xadArchiveInfo
+{
+	long xai_InSize;
+	long xai_InPos;
+	void* xai_PrivateClient;
+};
+
+#ifdef __cplusplus
+extern "C"
+#endif
+long test_hook_access( unsigned long command, long data, void* buffer,
+		struct xadArchiveInfo* ai );
+
+#define xadHookAccess( command, data, buffer, ai ) \
+	test_hook_access( (command), (data), (buffer), (ai) )
+
+#endif
@@ -0,0 +1,208 @@
+// Tests urarlib_extract() cursor with an in-memory stored RAR archive:
+// files requested out of order, the same file twice, and requests after
+// failed ones must all be extracted correctly.
+
+#include "../unrarlib/unrarlib.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <proto/xadmaster.h>
+
+static const int file_count = 4;
+
+static unsigned char arc_data [4096];
+static long arc_size;
+
+static unsigned char out_data [1024];
+static long out_size;
+
+static bool fail_read; // make next read fail
+
+static const char* file_data( int i, char* buf )
+{
+	sprintf( buf, "contents of file %d.%.*s", i, i * 7, "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz" );
+	return buf;
+}
+
+long test_hook_access( unsigned long command, long data, void* buffer,
+		struct xadArchiveInfo* ai )
+{
+	switch ( command )
+	{
+		case XADAC_READ:
+			if ( fail_read )
+			{
+				fail_read = false;
+				return XADERR_INPUT;
+			}
+			if ( data < 0 || ai->xai_InPos + data > ai->xai_InSize )
+				return XADERR_INPUT;
+			memcpy( buffer, arc_data + ai->xai_InPos, data );
+			ai->xai_InPos += data;
+			return XADERR_OK;
+
+		case XADAC_INPUTSEEK:
+			if ( ai->xai_InPos + data < 0 || ai->xai_InPos + data > ai->xai_InSize )
+				return XADERR_INPUT;
+			ai->xai_InPos += data;
+			return XADERR_OK;
+
+		case XADAC_WRITE:
+			if ( out_size + data > (long) sizeof out_data )
+				return XADERR_OUTPUT;
+			memcpy( out_data + out_size, buffer, data );
+			out_size += data;
+			return XADERR_OK;
+	}
+	return XADERR_INPUT;
+}
+
+static unsigned long crc32( const unsigned char* p, long size )
+{
+	unsigned long crc = 0xFFFFFFFF;
+	while ( size-- > 0 )
+	{
+		crc ^= *p++;
+		for ( int i = 0; i < 8; i++ )
+			crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+	}
+	return ~crc & 0xFFFFFFFF;
+}
+
+static void put( unsigned long n, int size )
+{
+	for ( int i = 0; i < size; i++ )
+		arc_data [arc_size++] = (unsigned char) (n >> (i * 8));
+}
+
+// Set 16-bit header CRC of block starting at 'start'
+static void set_head_crc( long start )
+{
+	unsigned long crc = crc32( arc_data + start + 2, arc_size - start - 2 );
+	arc_data [start] = (unsigned char) crc;
+	arc_data [start + 1] = (unsigned char) (crc >> 8);
+}
+
+// Build RAR 2.9 archive with 'file_count' stored files
+static void make_archive()
+{
+	static const unsigned char mark [7] = { 0x52, 0x61, 0x72, 0x21, 0x1A, 0x07, 0x00 };
+	memcpy( arc_data, mark, sizeof mark );
+	arc_size = sizeof mark;
+
+	long start = arc_size;
+	put( 0, 2 );
+	put( 0x73, 1 ); // main header
+	put( 0, 2 );
+	put( 13, 2 );
+	put( 0, 6 );
+	set_head_crc( start );
+
+	for ( int i = 0; i < file_count; i++ )
+	{
+		char name [32];
+		char buf [128];
+		sprintf( name, "file%d.txt", i );
+		const char* data = file_data( i, buf );
+		long name_size = (long) strlen( name );
+		long size = (long) strlen( data );
+
+		start = arc_size;
+		put( 0, 2 );
+		put( 0x74, 1 ); // file header
+		put( 0x8000, 2 ); // LONG_BLOCK
+		put( 32 + name_size, 2 );
+		put( size, 4 ); // packed size
+		put( size, 4 ); // unpacked size
+		put( 0, 1 ); // host OS
+		put( crc32( (const unsigned char*) data, size ), 4 );
+		put( 0x3A210000, 4 ); // DOS time
+		put( 20, 1 ); // unpack version
+		put( 0x30, 1 ); // stored
+		put( name_size, 2 );
+		put( 0x20, 4 ); // attributes
+		memcpy( arc_data + arc_size, name, name_size );
+		arc_size += name_size;
+		set_head_crc( start );
+
+		memcpy( arc_data + arc_size, data, size );
+		arc_size += size;
+	}
+
+	start = arc_size;
+	put( 0, 2 );
+	put( 0x7B, 1 ); // end of archive
+	put( 0x4000, 2 );
+	put( 7, 2 );
+	set_head_crc( start );
+}
+
+static int errors;
+
+static void check( bool ok, const char* what, long index )
+{
+	if ( !ok )
+	{
+		printf( "FAILED: %s (index %ld)\n", what, index );
+		errors++;
+	}
+}
+
+// Extract file 'index' and compare with expected contents
+static void extract( urarlib_cursor* c, struct xadArchiveInfo* ai, long index )
+{
+	char buf [128];
+	const char* data = file_data( (int) index, buf );
+	unsigned long size = 0;
+
+	out_size = 0;
+	check( urarlib_extract( c, &size, index ) != 0, "extract", index );
+	check( size == strlen( data ), "size", index );
+	check( out_size == (long) strlen( data ) && !memcmp( out_data, data, out_size ),
+			"data", index );
+}
+
+int main()
+{
+	make_archive();
+
+	struct xadArchiveInfo ai;
+	memset( &ai, 0, sizeof ai );
+	ai.xai_InSize = arc_size;
+
+	ArchiveList_struct* list = NULL;
+	check( urarlib_list( &list, NULL, &ai ) == file_count, "list", -1 );
+	urarlib_freelist( list );
+
+	// listing leaves input at end of archive, as xadmaster may do
+	urarlib_cursor* c = urarlib_open( NULL, &ai );
+	check( c != NULL, "open", -1 );
+	if ( !c )
+		return 1;
+
+	extract( c, &ai, 1 );
+	extract( c, &ai, 3 );
+	extract( c, &ai, 0 ); // earlier file
+	extract( c, &ai, 0 ); // same file again
+	extract( c, &ai, 2 );
+
+	// past last file
+	unsigned long size = 0;
+	check( !urarlib_extract( c, &size, file_count ), "missing file fails", file_count );
+	extract( c, &ai, 1 );
+
+	// read error in the middle of archive
+	fail_read = true;
+	check( !urarlib_extract( c, &size, 3 ), "read error fails", 3 );
+	extract( c, &ai, 3 );
+	extract( c, &ai, 2 );
+
+	urarlib_close( c );
+
+	if ( errors )
+		printf( "%d test(s) failed\n", errors );
+	else
+		printf( "All tests passed\n" );
+	return errors != 0;
+}
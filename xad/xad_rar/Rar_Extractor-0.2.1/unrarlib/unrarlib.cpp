@@ -7,6 +7,7 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <setjmp.h>
+#include <new>
 #include <proto/exec.h>
 
 #include "unrar/Rar_Extractor.h"
@@ -42,43 +43,79 @@ inline const char* log_error( const char* str )
 	return str;
 }
 
-int urarlib_get( unsigned long* size, char* filename,
-		void *xadLib, struct xadArchiveInfo *ai )
+// Extraction cursor kept alive between urarlib_extract() calls, so files
+// requested in archive order are reached by moving forward only.
+struct urarlib_cursor
 {
-	*size = 0;
+	Rar_Extractor rar;
+	XAD_File_Reader file;
+	XAD_Writer out;
+	long index; // index of current file entry, -1 if none or not opened
+	bool opened;
 	
-	// catch failed construction of rar extractor
-	if ( setjmp( jmp_env ) )
-		return false;
+	urarlib_cursor( void *xadLib, struct xadArchiveInfo *ai ) :
+		file( xadLib, ai ),
+		out( xadLib, ai )
+	{
+		index = -1;
+		opened = false;
+	}
+};
+
+urarlib_cursor* urarlib_open( void *xadLib, struct xadArchiveInfo *ai )
+{
+	return new (std::nothrow) urarlib_cursor( xadLib, ai );
+}
+
+int urarlib_extract( urarlib_cursor* c, unsigned long* size, long index )
+{
+	*size = 0;
 	
-	Rar_Extractor rar;
-	XAD_File_Reader file(xadLib, ai);
 	if ( setjmp( jmp_env ) )
 		goto error;
+	
+	// already past the requested entry, so start over
+	if ( !c->opened || c->index >= index )
+	{
+		c->opened = false;
+		c->index = -1;
 
-	if ( log_error( rar.open( &file ) ) )
-		goto error;
+		// IsArchive() reads the mark header at current position
+		if ( log_error( c->file.seek( 0 ) ) )
+			goto error;
+		if ( log_error( c->rar.open( &c->file ) ) )
+			goto error;
+		c->opened = true;
+	}
 	
-	while ( !log_error( rar.next() ) )
+	// skipped entries of a solid archive are decompressed by next()
+	while ( c->index < index )
 	{
-		if ( rar.info().is_file && 0 == strcmp( rar.info().name, filename ) )
-		{
-			XAD_Writer out( xadLib, ai );
-			if ( log_error( rar.extract( out ) ) )
-				goto error;
-			
-			// success
-			*size = rar.info().size;
-			return true;
-		}
+		if ( log_error( c->rar.next() ) )
+			goto error;
+		
+		if ( c->rar.info().is_file )
+			c->index++;
 	}
 	
-	 // not found
-	 
+	if ( log_error( c->rar.extract( c->out ) ) )
+		goto error;
+	
+	*size = c->rar.info().size;
+	return true;
+	
 error:
+	// state is unknown after an error, rewind on the next request
+	c->opened = false;
+	c->index = -1;
 	return false;
 }
 
+void urarlib_close( urarlib_cursor* c )
+{
+	delete c;
+}
+
 int urarlib_list( ArchiveList_struct** list, void *xadLib, struct xadArchiveInfo *ai )
 {
 	int count = 0;
@@ -129,6 +166,7 @@ int urarlib_list( ArchiveList_struct** list, void *xadLib, struct xadArchiveInfo
 			item->item.FileTime = rar.info().date;
 			item->item.PackSize = (long) rar.info().packsize;
 			item->item.FileAttr = rar.info().attrs;
+			item->Index = count;
 
 			// insert at end
 			*list = item;
@@ -28,6 +28,7 @@ typedef struct ArchiveList_struct
 {
 	struct RAR20_archive_entry item;
 	struct ArchiveList_struct* next; // next entry in list, or NULL if end of list
+	long Index; // position of file in archive, for urarlib_extract()
 	
 } ArchiveList_struct;
 
@@ -37,15 +38,21 @@ typedef struct ArchiveList_struct
 */
 int urarlib_list( ArchiveList_struct** list_out, void *xadLib, struct xadArchiveInfo *ai );
 
-/* Extract file 'filename' from an RAR archive at 'rar_path' into internal buffer.
-   Sets *buffer_out to beginning of buffer and *size_out to number of bytes extracted.
-   Returns true if successful otherwise false. Password is not supported (must be NULL).
-   Caller must free returned buffer when done with it.
+/* Extraction cursor which keeps the archive open between calls. */
+typedef struct urarlib_cursor urarlib_cursor;
 
-   Note: output is treated as void**, but is void* here to maintain urarlib.h compatibility.
+/* Create a cursor for the archive. Returns NULL if out of memory. */
+urarlib_cursor* urarlib_open( void *, struct xadArchiveInfo * );
+
+/* Extract file with list index 'index' to xadmaster output and set *size_out to
+   its size. The cursor only moves forward, so extracting files in list order
+   reads and decompresses the archive once, even when it is solid. Asking for
+   an earlier file rewinds to the beginning. Returns true if successful.
 */
-int urarlib_get( unsigned long* size_out, char* filename,
-		void *, struct xadArchiveInfo * );
+int urarlib_extract( urarlib_cursor*, unsigned long* size_out, long index );
+
+/* Free cursor returned by urarlib_open(). */
+void urarlib_close( urarlib_cursor* );
 
 /* Free memory used by list of nodes returned by urarlib_list(). Pointer must be that
    returned by urarlib_list() (that is, the first node in the list).
@@ -210,11 +210,17 @@ REG(a6, struct xadMasterBase *xadMasterBase))
 		libnixopen();
 	#endif
 	
+	if(!xadrar->Cursor)
+	{
 #ifdef __amigaos4__
-	if(!urarlib_get(&data_size, templist->item.Name, IxadMaster, ai))
+		xadrar->Cursor = urarlib_open(IxadMaster, ai);
 #else
-	if(!urarlib_get(&data_size, templist->item.Name, xadMasterBase, ai))
+		xadrar->Cursor = urarlib_open(xadMasterBase, ai);
 #endif
+		if(!xadrar->Cursor) return(XADERR_NOMEMORY);
+	}
+
+	if(!urarlib_extract(xadrar->Cursor, &data_size, templist->Index))
 	{
 		err=XADERR_UNKNOWN;
 	}
@@ -237,6 +243,7 @@ REG(a6, struct xadMasterBase *xadMasterBase))
 
 	struct xadrarprivate *xadrar = (struct xadrarprivate *)ai->xai_PrivateClient;
 
+	urarlib_close(xadrar->Cursor);
 	urarlib_freelist(xadrar->List);
 
 	xadFreeObjectA(ai->xai_PrivateClient,NULL);
@@ -10,6 +10,7 @@
 
 struct xadrarprivate {
 	ArchiveList_struct *List;
+	urarlib_cursor *Cursor; /* live extractor, created on first UnArchive */
 };
 
 #endif
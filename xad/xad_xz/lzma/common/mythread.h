@@ -25,6 +25,32 @@
 #	define mythread_sigmask(how, set, oset) \
 		pthread_sigmask(how, set, oset)
 
+// Thin wrappers for the threaded coders in liblzma. These are available
+// only when MYTHREAD_ENABLED is defined.
+#	define MYTHREAD_ENABLED 1
+
+#	define MYTHREAD_RET_TYPE void *
+#	define MYTHREAD_RET_VALUE NULL
+
+typedef pthread_t mythread;
+typedef pthread_mutex_t mythread_mutex;
+typedef pthread_cond_t mythread_cond;
+
+#	define mythread_create(thr, func, arg) \
+		pthread_create(thr, NULL, func, arg)
+#	define mythread_join(thr) pthread_join(thr, NULL)
+
+#	define mythread_mutex_init(mutex) pthread_mutex_init(mutex, NULL)
+#	define mythread_mutex_destroy(mutex) pthread_mutex_destroy(mutex)
+#	define mythread_mutex_lock(mutex) pthread_mutex_lock(mutex)
+#	define mythread_mutex_unlock(mutex) pthread_mutex_unlock(mutex)
+
+#	define mythread_cond_init(cond) pthread_cond_init(cond, NULL)
+#	define mythread_cond_destroy(cond) pthread_cond_destroy(cond)
+#	define mythread_cond_signal(cond) pthread_cond_signal(cond)
+#	define mythread_cond_broadcast(cond) pthread_cond_broadcast(cond)
+#	define mythread_cond_wait(cond, mutex) pthread_cond_wait(cond, mutex)
+
 #else
 
 #	define mythread_once(func) \
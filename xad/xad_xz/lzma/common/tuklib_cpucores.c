@@ -25,6 +25,11 @@
 #elif defined(TUKLIB_CPUCORES_PSTAT_GETDYNAMIC)
 #	include <sys/param.h>
 #	include <sys/pstat.h>
+
+#elif defined(TUKLIB_CPUCORES_AROS)
+#	include <proto/exec.h>
+#	include <proto/processor.h>
+#	include <resources/processor.h>
 #endif
 
 
@@ -56,6 +61,16 @@ tuklib_cpucores(void)
 	struct pst_dynamic pst;
 	if (pstat_getdynamic(&pst, sizeof(pst), 1, 0) != -1)
 		ret = pst.psd_proc_cnt;
+
+#elif defined(TUKLIB_CPUCORES_AROS)
+	// processor.resource is missing from older AROS builds.
+	APTR ProcessorBase = OpenResource(PROCESSORNAME);
+	if (ProcessorBase != NULL) {
+		ULONG cpus = 0;
+		GetCPUInfoTags(GCIT_NumberOfProcessors, (IPTR)&cpus,
+				TAG_DONE);
+		ret = cpus;
+	}
 #endif
 
 	return ret;
@@ -63,6 +63,9 @@
 // This sysinfo() is Linux-specific.
 #elif defined(TUKLIB_PHYSMEM_SYSINFO)
 #	include <sys/sysinfo.h>
+
+#elif defined(TUKLIB_PHYSMEM_AROS)
+#	include <proto/exec.h>
 #endif
 
 
@@ -190,6 +193,9 @@ tuklib_physmem(void)
 	struct sysinfo si;
 	if (sysinfo(&si) == 0)
 		ret = (uint64_t)si.totalram * si.mem_unit;
+
+#elif defined(TUKLIB_PHYSMEM_AROS)
+	ret = AvailMem(MEMF_TOTAL);
 #endif
 
 	return ret;
@@ -28,3 +28,7 @@
 #define HAVE_CHECK_CRC32
 #define HAVE_CHECK_CRC64
 #define HAVE_CHECK_SHA256
+
+// CPU count from processor.resource, RAM size from exec AvailMem()
+#define TUKLIB_CPUCORES_AROS
+#define TUKLIB_PHYSMEM_AROS
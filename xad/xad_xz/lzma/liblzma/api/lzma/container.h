@@ -341,6 +341,148 @@ extern LZMA_API(lzma_ret) lzma_stream_decoder(
 		lzma_nothrow lzma_attr_warn_unused_result;
 
 
+/**
+ * \brief       Options for the multithreaded coders
+ *
+ * Members that aren't used by a coder are ignored by it. Set everything
+ * to zero before filling in the members, so that new members added in
+ * the future get their default values.
+ */
+typedef struct {
+	/**
+	 * \brief       Decoder flags
+	 *
+	 * The same flags as for lzma_stream_decoder(). No flags are
+	 * supported by the encoder, so this must be zero there.
+	 */
+	uint32_t flags;
+
+	/**
+	 * \brief       Number of worker threads to use
+	 *
+	 * Use lzma_cputhreads() to get the number of available hardware
+	 * threads. With one thread the decoder uses the single-threaded
+	 * decoder. The encoder still splits the input into Blocks.
+	 */
+	uint32_t threads;
+
+	/**
+	 * \brief       Encoder only: Maximum uncompressed size of a Block
+	 *
+	 * The input is split into Blocks of this size, which are compressed
+	 * independently. Zero means three times the LZMA2 dictionary size,
+	 * but at least 1 MiB.
+	 */
+	uint64_t block_size;
+
+	/**
+	 * \brief       Encoder only: Compression preset
+	 *
+	 * The preset is used if filters is NULL. See lzma_easy_encoder().
+	 */
+	uint32_t preset;
+
+	/**
+	 * \brief       Encoder only: Filter chain
+	 *
+	 * If this is NULL, the filter chain is taken from the preset.
+	 */
+	const lzma_filter *filters;
+
+	/**
+	 * \brief       Encoder only: Integrity check type
+	 */
+	lzma_check check;
+
+	/**
+	 * \brief       Memory usage limit for threaded decoding
+	 *
+	 * Blocks are decoded in parallel only as long as the buffers of
+	 * the Blocks in flight fit in this limit. Blocks that don't fit
+	 * even alone are decoded in the calling thread. Zero means the
+	 * same as memlimit_stop.
+	 */
+	uint64_t memlimit_threading;
+
+	/**
+	 * \brief       Memory usage limit of a single decoder
+	 *
+	 * This works like the memlimit argument of lzma_stream_decoder().
+	 * Use UINT64_MAX to effectively disable the limiter.
+	 */
+	uint64_t memlimit_stop;
+
+} lzma_mt;
+
+
+/**
+ * \brief       Maximum number of threads the multithreaded coders accept
+ */
+#define LZMA_THREADS_MAX 16384
+
+
+/**
+ * \brief       Initialize multithreaded .xz Stream encoder
+ *
+ * The input is split into Blocks of options->block_size bytes, which are
+ * compressed in parallel with independent encoders on options->threads
+ * worker threads. The Blocks are written in order, with their sizes in
+ * the Block Headers, so the result can also be decoded in parallel.
+ * Without thread support in liblzma this works like lzma_stream_encoder().
+ *
+ * Valid actions for lzma_code() are LZMA_RUN, LZMA_FULL_FLUSH, and
+ * LZMA_FINISH. LZMA_FULL_FLUSH finishes the current Block.
+ *
+ * lzma_code() may block while waiting for the worker threads.
+ *
+ * \return      - LZMA_OK: Initialization was successful.
+ *              - LZMA_MEM_ERROR
+ *              - LZMA_UNSUPPORTED_CHECK
+ *              - LZMA_OPTIONS_ERROR
+ *              - LZMA_PROG_ERROR
+ */
+extern LZMA_API(lzma_ret) lzma_stream_encoder_mt(
+		lzma_stream *strm, const lzma_mt *options)
+		lzma_nothrow lzma_attr_warn_unused_result;
+
+
+/**
+ * \brief       Calculate approximate memory usage of multithreaded encoder
+ *
+ * The result includes the encoder and the input and output buffers of
+ * every thread. Call this with options->threads set to 1 to get the
+ * memory needed per thread.
+ *
+ * \return      Number of bytes of memory required for encoding with the
+ *              given options. If an error occurs, for example due to
+ *              unsupported preset or filter chain, UINT64_MAX is returned.
+ */
+extern LZMA_API(uint64_t) lzma_stream_encoder_mt_memusage(
+		const lzma_mt *options) lzma_nothrow;
+
+
+/**
+ * \brief       Initialize multithreaded .xz Stream decoder
+ *
+ * Blocks whose Block Header stores both Compressed Size and Uncompressed
+ * Size (like the ones written by multithreaded encoders) are decoded in
+ * parallel on options->threads worker threads. The output is always
+ * produced in order. Other Blocks, and all Blocks when liblzma was built
+ * without thread support, are decoded in the calling thread, so this
+ * can be used as a drop-in replacement for lzma_stream_decoder().
+ *
+ * lzma_code() may block while waiting for the worker threads.
+ *
+ * \return      - LZMA_OK: Initialization was successful.
+ *              - LZMA_MEM_ERROR: Cannot allocate memory.
+ *              - LZMA_OPTIONS_ERROR: Unsupported flags or thread count
+ *              - LZMA_PROG_ERROR
+ */
+extern LZMA_API(lzma_ret) lzma_stream_decoder_mt(
+		lzma_stream *strm, const lzma_mt *options)
+		lzma_nothrow lzma_attr_warn_unused_result;
+
+
 /**
  * \brief       Decode .xz Streams and .lzma files with autodetection
  *
@@ -6,10 +6,8 @@
  * ways to limit the resource usage. Applications linking against liblzma
  * need to do the actual decisions how much resources to let liblzma to use.
  * To ease making these decisions, liblzma provides functions to find out
- * the relevant capabilities of the underlaying hardware. Currently there
- * is only a function to find out the amount of RAM, but in the future there
- * will be also a function to detect how many concurrent threads the system
- * can run.
+ * the relevant capabilities of the underlaying hardware: the amount of RAM
+ * and the number of concurrent threads the system can run.
  *
  * \note        On some operating systems, these function may temporarily
  *              load a shared library or open file descriptor(s) to find out
@@ -48,3 +46,16 @@
  *              of RAM on the specific operating system.
  */
 extern LZMA_API(uint64_t) lzma_physmem(void) lzma_nothrow;
+
+
+/**
+ * \brief       Get the number of processor cores or threads
+ *
+ * This function may be useful when determining how many threads to use
+ * with the multithreaded coders.
+ *
+ * \return      On success, the number of available CPU threads or cores
+ *              is returned. If this information isn't available or an
+ *              error occurs, zero is returned.
+ */
+extern LZMA_API(uint32_t) lzma_cputhreads(void) lzma_nothrow;
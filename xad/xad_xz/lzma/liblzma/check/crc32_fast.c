@@ -8,6 +8,10 @@
 /// http://www.intel.com/technology/comms/perfnet/download/CRC_generators.pdf
 /// The code in this file is not the same as in Intel's paper, but
 /// the basic principle is identical.
+///
+/// On x86 with CLMUL and on ARMv8 with the CRC32 extension, faster
+/// versions are used instead. The x86 version is selected at run time
+/// on the first call, see crc_x86_clmul.h.
 //
 //  Author:     Lasse Collin
 //
@@ -18,13 +22,19 @@
 
 #include "check.h"
 #include "crc_macros.h"
+#include "crc_x86_clmul.h"
+
+#if defined(__ARM_FEATURE_CRC32) && !defined(WORDS_BIGENDIAN)
+#	include <arm_acle.h>
+#	define CRC32_ARM 1
+#endif
 
 
 // If you make any changes, do some bench marking! Seemingly unrelated
 // changes can very easily ruin the performance (and very probably is
 // very compiler dependent).
-extern LZMA_API(uint32_t)
-lzma_crc32(const uint8_t *buf, size_t size, uint32_t crc)
+static uint32_t
+crc32_generic(const uint8_t *buf, size_t size, uint32_t crc)
 {
 	crc = ~crc;
 
@@ -80,3 +90,86 @@ lzma_crc32(const uint8_t *buf, size_t size, uint32_t crc)
 
 	return ~crc;
 }
+
+
+#ifdef CRC_CLMUL
+crc_attr_clmul
+static uint32_t
+crc32_clmul(const uint8_t *buf, size_t size, uint32_t crc)
+{
+	if (size < CRC_CLMUL_MIN_SIZE)
+		return crc32_generic(buf, size, crc);
+
+	// Constants for P = 0xEDB88320, see crc_x86_clmul.h.
+	const __m128i k512 = _mm_set_epi64x(
+			(long long)UINT64_C(0xCAD38E8F00000000),
+			(long long)UINT64_C(0x653D982200000000));
+	const __m128i k128 = _mm_set_epi64x(
+			(long long)UINT64_C(0x9BA54C6F00000000),
+			(long long)UINT64_C(0x65673B4600000000));
+
+	uint8_t tmp[16];
+	_mm_storeu_si128((__m128i *)tmp, crc_clmul_fold(&buf, &size,
+			_mm_cvtsi32_si128((int)~crc), k512, k128));
+
+	// The folded value is finished with zero as the initial CRC.
+	crc = crc32_generic(tmp, sizeof(tmp), UINT32_MAX);
+	return crc32_generic(buf, size, crc);
+}
+
+
+typedef uint32_t (*crc32_func_type)(
+		const uint8_t *buf, size_t size, uint32_t crc);
+
+// Set once by crc32_set_func(), which the threaded coders may call
+// at the same time.
+static crc32_func_type crc32_func;
+
+static void
+crc32_set_func(void)
+{
+	crc32_func = crc_clmul_is_supported() ? &crc32_clmul : &crc32_generic;
+	return;
+}
+
+#elif defined(CRC32_ARM)
+static uint32_t
+crc32_arm(const uint8_t *buf, size_t size, uint32_t crc)
+{
+	crc = ~crc;
+
+	while (size > 0 && ((uintptr_t)(buf) & 7)) {
+		crc = __crc32b(crc, *buf++);
+		--size;
+	}
+
+	for (; size >= 32; size -= 32, buf += 32) {
+		crc = __crc32d(crc, *(const uint64_t *)(buf));
+		crc = __crc32d(crc, *(const uint64_t *)(buf + 8));
+		crc = __crc32d(crc, *(const uint64_t *)(buf + 16));
+		crc = __crc32d(crc, *(const uint64_t *)(buf + 24));
+	}
+
+	for (; size >= 8; size -= 8, buf += 8)
+		crc = __crc32d(crc, *(const uint64_t *)(buf));
+
+	while (size-- != 0)
+		crc = __crc32b(crc, *buf++);
+
+	return ~crc;
+}
+#endif
+
+
+extern LZMA_API(uint32_t)
+lzma_crc32(const uint8_t *buf, size_t size, uint32_t crc)
+{
+#if defined(CRC_CLMUL)
+	mythread_once(crc32_set_func);
+	return crc32_func(buf, size, crc);
+#elif defined(CRC32_ARM)
+	return crc32_arm(buf, size, crc);
+#else
+	return crc32_generic(buf, size, crc);
+#endif
+}
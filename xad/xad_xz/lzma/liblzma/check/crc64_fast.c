@@ -6,6 +6,9 @@
 /// Calculate the CRC64 using the slice-by-four algorithm. This is the same
 /// idea that is used in crc32_fast.c, but for CRC64 we use only four tables
 /// instead of eight to avoid increasing CPU cache usage.
+///
+/// On x86 with CLMUL, the folding code in crc_x86_clmul.h is used instead.
+/// It is selected at run time on the first call like in crc32_fast.c.
 //
 //  Author:     Lasse Collin
 //
@@ -16,6 +19,7 @@
 
 #include "check.h"
 #include "crc_macros.h"
+#include "crc_x86_clmul.h"
 
 
 #ifdef WORDS_BIGENDIAN
@@ -26,8 +30,8 @@
 
 
 // See the comments in crc32_fast.c. They aren't duplicated here.
-extern LZMA_API(uint64_t)
-lzma_crc64(const uint8_t *buf, size_t size, uint64_t crc)
+static uint64_t
+crc64_generic(const uint8_t *buf, size_t size, uint64_t crc)
 {
 	crc = ~crc;
 
@@ -70,3 +74,54 @@ lzma_crc64(const uint8_t *buf, size_t size, uint64_t crc)
 
 	return ~crc;
 }
+
+
+#ifdef CRC_CLMUL
+crc_attr_clmul
+static uint64_t
+crc64_clmul(const uint8_t *buf, size_t size, uint64_t crc)
+{
+	if (size < CRC_CLMUL_MIN_SIZE)
+		return crc64_generic(buf, size, crc);
+
+	// Constants for P = 0xC96C5795D7870F42, see crc_x86_clmul.h.
+	const __m128i k512 = _mm_set_epi64x(
+			(long long)UINT64_C(0x081F6054A7842DF4),
+			(long long)UINT64_C(0x6AE3EFBB9DD441F3));
+	const __m128i k128 = _mm_set_epi64x(
+			(long long)UINT64_C(0xDABE95AFC7875F40),
+			(long long)UINT64_C(0xE05DD497CA393AE4));
+
+	uint8_t tmp[16];
+	_mm_storeu_si128((__m128i *)tmp, crc_clmul_fold(&buf, &size,
+			_mm_set_epi64x(0, (long long)~crc), k512, k128));
+
+	crc = crc64_generic(tmp, sizeof(tmp), UINT64_MAX);
+	return crc64_generic(buf, size, crc);
+}
+
+
+typedef uint64_t (*crc64_func_type)(
+		const uint8_t *buf, size_t size, uint64_t crc);
+
+static crc64_func_type crc64_func;
+
+static void
+crc64_set_func(void)
+{
+	crc64_func = crc_clmul_is_supported() ? &crc64_clmul : &crc64_generic;
+	return;
+}
+#endif
+
+
+extern LZMA_API(uint64_t)
+lzma_crc64(const uint8_t *buf, size_t size, uint64_t crc)
+{
+#ifdef CRC_CLMUL
+	mythread_once(crc64_set_func);
+	return crc64_func(buf, size, crc);
+#else
+	return crc64_generic(buf, size, crc);
+#endif
+}
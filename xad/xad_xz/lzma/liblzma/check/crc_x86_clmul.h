@@ -0,0 +1,125 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+/// \file       crc_x86_clmul.h
+/// \brief      CRC32 and CRC64 folding with the x86 CLMUL instruction
+///
+/// The buffer is folded 64 bytes at a time into four 128-bit remainders
+/// using carry-less multiplication, as described in Intel's paper "Fast CRC
+/// Computation for Generic Polynomials Using PCLMULQDQ Instruction".
+/// The remainders are then folded into one 128-bit value, and the CRC of
+/// that and of the last few bytes is calculated with the lookup tables.
+/// This avoids the Barrett reduction and works for both CRC widths.
+///
+/// The fold constants are x^(D+63) mod P and x^(D-1) mod P bit-reflected
+/// to 64 bits, where D is the folding distance in bits (512 or 128).
+//
+//  This file has been put into the public domain.
+//  You can do whatever you want with this file.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef LZMA_CRC_X86_CLMUL_H
+#define LZMA_CRC_X86_CLMUL_H
+
+// The intrinsics are used through the target attribute so that the rest
+// of liblzma doesn't need to be built with -mpclmul. GCC supports this
+// since 4.9.
+#if (defined(__i386__) || defined(__x86_64__) \
+		|| defined(_M_IX86) || defined(_M_X64)) \
+		&& !defined(WORDS_BIGENDIAN) \
+		&& (defined(_MSC_VER) || defined(__clang__) \
+		|| (defined(__GNUC__) && (__GNUC__ > 4 \
+		|| (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#	define CRC_CLMUL 1
+#endif
+
+#ifdef CRC_CLMUL
+
+#include <emmintrin.h>
+#include <wmmintrin.h>
+
+#ifdef _MSC_VER
+#	include <intrin.h>
+#	define crc_attr_clmul
+#else
+#	include <cpuid.h>
+#	define crc_attr_clmul __attribute__((__target__("sse2,pclmul")))
+#endif
+
+
+/// Buffers smaller than this are left to the table-based code.
+#define CRC_CLMUL_MIN_SIZE 64
+
+
+static inline bool
+crc_clmul_is_supported(void)
+{
+	uint32_t r[4];
+
+#ifdef _MSC_VER
+	__cpuid((int *)r, 1);
+#else
+	if (!__get_cpuid(1, &r[0], &r[1], &r[2], &r[3]))
+		return false;
+#endif
+
+	// PCLMULQDQ is ECX bit 1 and SSE2 is EDX bit 26.
+	return (r[2] & (UINT32_C(1) << 1)) != 0
+			&& (r[3] & (UINT32_C(1) << 26)) != 0;
+}
+
+
+/// Folds the buffer into a 128-bit value whose CRC (with zero initial
+/// value) equals the CRC of the folded part. init is XORed into the
+/// first 16 bytes. *size must be at least CRC_CLMUL_MIN_SIZE. On return,
+/// *buf and *size describe the bytes that weren't folded (less than 16).
+crc_attr_clmul
+static inline __m128i
+crc_clmul_fold(const uint8_t **buf, size_t *size, __m128i init,
+		__m128i k512, __m128i k128)
+{
+	const __m128i *p = (const __m128i *)(*buf);
+	size_t n = *size;
+
+	__m128i x0 = _mm_xor_si128(_mm_loadu_si128(p), init);
+	__m128i x1 = _mm_loadu_si128(p + 1);
+	__m128i x2 = _mm_loadu_si128(p + 2);
+	__m128i x3 = _mm_loadu_si128(p + 3);
+	p += 4;
+	n -= 64;
+
+	// x = x * k + y, where the low half of x is multiplied with the
+	// low half of k and the high half with the high half.
+#define crc_clmul_fold1(x, k, y) \
+	x = _mm_xor_si128(_mm_xor_si128( \
+			_mm_clmulepi64_si128(x, k, 0x00), \
+			_mm_clmulepi64_si128(x, k, 0x11)), y)
+
+	while (n >= 64) {
+		crc_clmul_fold1(x0, k512, _mm_loadu_si128(p));
+		crc_clmul_fold1(x1, k512, _mm_loadu_si128(p + 1));
+		crc_clmul_fold1(x2, k512, _mm_loadu_si128(p + 2));
+		crc_clmul_fold1(x3, k512, _mm_loadu_si128(p + 3));
+		p += 4;
+		n -= 64;
+	}
+
+	crc_clmul_fold1(x0, k128, x1);
+	crc_clmul_fold1(x0, k128, x2);
+	crc_clmul_fold1(x0, k128, x3);
+
+	while (n >= 16) {
+		crc_clmul_fold1(x0, k128, _mm_loadu_si128(p));
+		++p;
+		n -= 16;
+	}
+
+#undef crc_clmul_fold1
+
+	*buf = (const uint8_t *)p;
+	*size = n;
+	return x0;
+}
+
+#endif
+#endif
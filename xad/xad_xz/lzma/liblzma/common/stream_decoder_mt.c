@@ -0,0 +1,954 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+/// \file       stream_decoder_mt.c
+/// \brief      Multithreaded .xz Stream decoder
+//
+//  This file has been put into the public domain.
+//  You can do whatever you want with this file.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "stream_decoder.h"
+#include "block_decoder.h"
+
+
+#ifdef MYTHREAD_ENABLED
+
+/// Maximum number of Blocks in flight per worker thread. This bounds the
+/// memory used for Blocks that have been decoded but not yet returned to
+/// the application.
+#define JOBS_PER_THREAD 2
+
+
+typedef enum {
+	/// Compressed data is being copied from the input.
+	JOB_COLLECTING,
+
+	/// Waiting for a worker thread
+	JOB_PENDING,
+
+	/// A worker thread is decoding the Block.
+	JOB_RUNNING,
+
+	/// Decoded (or failed); the output can be returned.
+	JOB_DONE,
+} job_state;
+
+
+typedef struct job_s job;
+struct job_s {
+	/// Next Block in the Stream
+	job *next;
+
+	job_state state;
+
+	/// Return value of the Block decoder
+	lzma_ret ret;
+
+	/// Block options and the filter chain from the Block Header. The
+	/// filter options are freed by the worker once the Block decoder
+	/// has been initialized.
+	lzma_block block;
+	lzma_filter filters[LZMA_FILTERS_MAX + 1];
+
+	/// Compressed Data, Block Padding, and Check
+	uint8_t *in;
+	size_t in_pos;
+	size_t in_size;
+
+	/// Uncompressed data. out_pos is the position of the data not yet
+	/// copied to the application.
+	uint8_t *out;
+	size_t out_pos;
+	size_t out_size;
+
+	/// Memory accounted to this job
+	uint64_t memusage;
+};
+
+
+typedef struct {
+	lzma_coder *coder;
+	mythread thread;
+
+	/// Block decoder of this thread. It is reused for every Block
+	/// so that the dictionary doesn't need to be reallocated.
+	lzma_next_coder block_decoder;
+} worker;
+
+
+struct lzma_coder_s {
+	enum {
+		SEQ_STREAM_HEADER,
+		SEQ_BLOCK_HEADER,
+		SEQ_BLOCK_INIT,
+		SEQ_BLOCK_COPY,
+		SEQ_BLOCK,
+		SEQ_INDEX_WAIT,
+		SEQ_INDEX,
+		SEQ_STREAM_FOOTER,
+		SEQ_STREAM_PADDING,
+	} sequence;
+
+	/// Block decoder for the Blocks decoded in the calling thread
+	lzma_next_coder block_decoder;
+
+	/// Block options decoded by the Block Header decoder
+	lzma_block block_options;
+
+	/// Filter chain of the latest Block Header. block_options.filters
+	/// points here as long as the filter options haven't been freed
+	/// or handed over to a job.
+	lzma_filter filters[LZMA_FILTERS_MAX + 1];
+
+	/// Memory usage of the filter chain of the latest Block Header
+	uint64_t block_memusage;
+
+	/// Stream Flags from Stream Header
+	lzma_stream_flags stream_flags;
+
+	/// Index is hashed so that it can be compared to the sizes of Blocks
+	lzma_index_hash *index_hash;
+
+	/// Memory usage limit of a single Block decoder
+	uint64_t memlimit;
+
+	/// Memory usage limit of the Blocks in flight
+	uint64_t memlimit_threading;
+
+	/// Amount of memory actually needed (only an estimate)
+	uint64_t memusage;
+
+	bool tell_no_check;
+	bool tell_unsupported_check;
+	bool tell_any_check;
+	bool concatenated;
+	bool first_stream;
+
+	/// Write position in buffer[] and position in Stream Padding
+	size_t pos;
+
+	/// Buffer to hold Stream Header, Block Header, and Stream Footer
+	uint8_t buffer[LZMA_BLOCK_HEADER_SIZE_MAX];
+
+	/// Allocator given to the init function, used by the workers
+	lzma_allocator *allocator;
+
+	/// Protects the job states and the job list
+	mythread_mutex mutex;
+
+	/// Signaled when a job becomes JOB_PENDING or on shutdown
+	mythread_cond cond_work;
+
+	/// Signaled when a job becomes JOB_DONE
+	mythread_cond cond_done;
+
+	/// Set when the worker threads should exit
+	bool shutdown;
+
+	worker *workers;
+	uint32_t threads;
+
+	/// Blocks in flight in Stream order. Only the calling thread
+	/// adds and removes jobs.
+	job *jobs_head;
+	job *jobs_tail;
+	uint32_t jobs_count;
+	uint64_t jobs_memusage;
+};
+
+
+static void
+job_free(job *j, lzma_allocator *allocator)
+{
+	if (j->block.filters != NULL)
+		for (size_t i = 0; i < LZMA_FILTERS_MAX; ++i)
+			lzma_free(j->filters[i].options, allocator);
+
+	lzma_free(j->in, allocator);
+	lzma_free(j->out, allocator);
+	lzma_free(j, allocator);
+	return;
+}
+
+
+/// Decode one Block. This is called without holding the mutex.
+static lzma_ret
+worker_decode(worker *w, job *j)
+{
+	lzma_allocator *allocator = w->coder->allocator;
+
+	lzma_ret ret = lzma_block_decoder_init(&w->block_decoder,
+			allocator, &j->block);
+
+	// The filter options are needed only for the initialization.
+	for (size_t i = 0; i < LZMA_FILTERS_MAX; ++i)
+		lzma_free(j->filters[i].options, allocator);
+
+	j->block.filters = NULL;
+
+	if (ret != LZMA_OK)
+		return ret;
+
+	size_t in_pos = 0;
+	size_t out_pos = 0;
+
+	do {
+		const size_t in_start = in_pos;
+		const size_t out_start = out_pos;
+
+		ret = w->block_decoder.code(w->block_decoder.coder, allocator,
+				j->in, &in_pos, j->in_size,
+				j->out, &out_pos, j->out_size, LZMA_FINISH);
+
+		if (ret == LZMA_OK && in_pos == in_start
+				&& out_pos == out_start)
+			ret = LZMA_DATA_ERROR;
+
+	} while (ret == LZMA_OK);
+
+	// The Block decoder validates the sizes against the Block Header,
+	// so all of the input has been used if it succeeded.
+	if (ret == LZMA_STREAM_END && (in_pos != j->in_size
+			|| out_pos != j->out_size))
+		ret = LZMA_DATA_ERROR;
+
+	// The compressed data isn't needed anymore.
+	lzma_free(j->in, allocator);
+	j->in = NULL;
+
+	return ret;
+}
+
+
+static MYTHREAD_RET_TYPE
+worker_start(void *arg)
+{
+	worker *w = arg;
+	lzma_coder *coder = w->coder;
+
+	mythread_mutex_lock(&coder->mutex);
+
+	while (true) {
+		job *j = coder->jobs_head;
+		while (j != NULL && j->state != JOB_PENDING)
+			j = j->next;
+
+		if (coder->shutdown)
+			break;
+
+		if (j == NULL) {
+			mythread_cond_wait(&coder->cond_work, &coder->mutex);
+			continue;
+		}
+
+		j->state = JOB_RUNNING;
+		mythread_mutex_unlock(&coder->mutex);
+
+		const lzma_ret ret = worker_decode(w, j);
+
+		mythread_mutex_lock(&coder->mutex);
+		j->ret = ret;
+		j->state = JOB_DONE;
+		mythread_cond_broadcast(&coder->cond_done);
+	}
+
+	mythread_mutex_unlock(&coder->mutex);
+
+	return MYTHREAD_RET_VALUE;
+}
+
+
+/// Copy the output of the finished Blocks to out[] in Stream order.
+static lzma_ret
+output_jobs(lzma_coder *coder, uint8_t *restrict out,
+		size_t *restrict out_pos, size_t out_size)
+{
+	while (coder->jobs_head != NULL && *out_pos < out_size) {
+		job *j = coder->jobs_head;
+
+		mythread_mutex_lock(&coder->mutex);
+		const job_state state = j->state;
+		mythread_mutex_unlock(&coder->mutex);
+
+		if (state != JOB_DONE)
+			break;
+
+		if (j->ret != LZMA_STREAM_END)
+			return j->ret;
+
+		lzma_bufcpy(j->out, &j->out_pos, j->out_size,
+				out, out_pos, out_size);
+
+		if (j->out_pos < j->out_size)
+			break;
+
+		// The whole Block has been returned. Add its sizes to
+		// the Index hash and free it.
+		const lzma_ret ret = lzma_index_hash_append(coder->index_hash,
+				lzma_block_unpadded_size(&j->block),
+				j->block.uncompressed_size);
+
+		mythread_mutex_lock(&coder->mutex);
+		coder->jobs_head = j->next;
+		if (coder->jobs_head == NULL)
+			coder->jobs_tail = NULL;
+
+		--coder->jobs_count;
+		coder->jobs_memusage -= j->memusage;
+		mythread_mutex_unlock(&coder->mutex);
+
+		job_free(j, coder->allocator);
+
+		if (ret != LZMA_OK)
+			return ret;
+	}
+
+	return LZMA_OK;
+}
+
+
+/// Free the filter options of the latest Block Header if they weren't
+/// handed over to a Block decoder or a job.
+static void
+free_block_filters(lzma_coder *coder, lzma_allocator *allocator)
+{
+	if (coder->block_options.filters == NULL)
+		return;
+
+	for (size_t i = 0; i < LZMA_FILTERS_MAX; ++i)
+		lzma_free(coder->filters[i].options, allocator);
+
+	coder->block_options.filters = NULL;
+	return;
+}
+
+
+typedef enum {
+	/// The Block is decoded in the calling thread.
+	BLOCK_SINGLE,
+
+	/// A job was created for the Block.
+	BLOCK_QUEUED,
+
+	/// There's no room for another job yet.
+	BLOCK_WAIT,
+} block_mode;
+
+
+/// Create a job for the Block whose header was just decoded, if the Block
+/// can be decoded by a worker thread.
+static lzma_ret
+block_init_mt(lzma_coder *coder, lzma_allocator *allocator,
+		block_mode *mode)
+{
+	const lzma_block *block = &coder->block_options;
+
+	*mode = BLOCK_SINGLE;
+
+	// Blocks can be decoded independently only if their sizes
+	// are known in advance.
+	if (block->compressed_size == LZMA_VLI_UNKNOWN
+			|| block->uncompressed_size == LZMA_VLI_UNKNOWN)
+		return LZMA_OK;
+
+	const lzma_vli in_size = lzma_block_total_size(block)
+			- block->header_size;
+	const lzma_vli out_size = block->uncompressed_size;
+
+	if (in_size > SIZE_MAX || out_size > SIZE_MAX)
+		return LZMA_OK;
+
+	const uint64_t memusage = in_size + out_size + coder->block_memusage;
+	if (memusage > coder->memlimit_threading)
+		return LZMA_OK;
+
+	// Wait until there's room for the new Block. The caller waits
+	// for the first Block to finish.
+	if (coder->jobs_count >= coder->threads * JOBS_PER_THREAD
+			|| coder->jobs_memusage + memusage
+				> coder->memlimit_threading) {
+		*mode = BLOCK_WAIT;
+		return LZMA_OK;
+	}
+
+	job *j = lzma_alloc(sizeof(job), allocator);
+	if (j == NULL)
+		return LZMA_MEM_ERROR;
+
+	j->in = lzma_alloc(in_size == 0 ? 1 : (size_t)(in_size), allocator);
+	j->out = lzma_alloc(out_size == 0 ? 1 : (size_t)(out_size),
+			allocator);
+	if (j->in == NULL || j->out == NULL) {
+		lzma_free(j->in, allocator);
+		lzma_free(j->out, allocator);
+		lzma_free(j, allocator);
+		return LZMA_MEM_ERROR;
+	}
+
+	// Hand the filter chain over to the job.
+	j->next = NULL;
+	j->state = JOB_COLLECTING;
+	j->ret = LZMA_OK;
+	j->block = *block;
+	memcpy(j->filters, coder->filters, sizeof(j->filters));
+	j->block.filters = j->filters;
+	j->in_pos = 0;
+	j->in_size = (size_t)(in_size);
+	j->out_pos = 0;
+	j->out_size = (size_t)(out_size);
+	j->memusage = memusage;
+
+	coder->block_options.filters = NULL;
+
+	mythread_mutex_lock(&coder->mutex);
+	if (coder->jobs_tail == NULL)
+		coder->jobs_head = j;
+	else
+		coder->jobs_tail->next = j;
+
+	coder->jobs_tail = j;
+	++coder->jobs_count;
+	coder->jobs_memusage += memusage;
+	mythread_mutex_unlock(&coder->mutex);
+
+	*mode = BLOCK_QUEUED;
+	return LZMA_OK;
+}
+
+
+static lzma_ret
+stream_decoder_reset(lzma_coder *coder, lzma_allocator *allocator)
+{
+	// Initialize the Index hash used to verify the Index.
+	coder->index_hash = lzma_index_hash_init(coder->index_hash, allocator);
+	if (coder->index_hash == NULL)
+		return LZMA_MEM_ERROR;
+
+	// Reset the rest of the variables.
+	coder->sequence = SEQ_STREAM_HEADER;
+	coder->pos = 0;
+
+	return LZMA_OK;
+}
+
+
+/// Parse the input. This returns LZMA_OK when it cannot continue without
+/// more input, more output space, or waiting for the worker threads.
+static lzma_ret
+decode_input(lzma_coder *coder, lzma_allocator *allocator,
+		const uint8_t *restrict in, size_t *restrict in_pos,
+		size_t in_size, uint8_t *restrict out,
+		size_t *restrict out_pos, size_t out_size, lzma_action action)
+{
+	while (true)
+	switch (coder->sequence) {
+	case SEQ_STREAM_HEADER: {
+		// Copy the Stream Header to the internal buffer.
+		lzma_bufcpy(in, in_pos, in_size, coder->buffer, &coder->pos,
+				LZMA_STREAM_HEADER_SIZE);
+
+		// Return if we didn't get the whole Stream Header yet.
+		if (coder->pos < LZMA_STREAM_HEADER_SIZE)
+			return LZMA_OK;
+
+		coder->pos = 0;
+
+		// Decode the Stream Header.
+		const lzma_ret ret = lzma_stream_header_decode(
+				&coder->stream_flags, coder->buffer);
+		if (ret != LZMA_OK)
+			return ret == LZMA_FORMAT_ERROR && !coder->first_stream
+					? LZMA_DATA_ERROR : ret;
+
+		coder->first_stream = false;
+
+		// Copy the type of the Check so that Block Header and Block
+		// decoders see it.
+		coder->block_options.check = coder->stream_flags.check;
+
+		coder->sequence = SEQ_BLOCK_HEADER;
+
+		if (coder->tell_no_check && coder->stream_flags.check
+				== LZMA_CHECK_NONE)
+			return LZMA_NO_CHECK;
+
+		if (coder->tell_unsupported_check
+				&& !lzma_check_is_supported(
+					coder->stream_flags.check))
+			return LZMA_UNSUPPORTED_CHECK;
+
+		if (coder->tell_any_check)
+			return LZMA_GET_CHECK;
+
+		break;
+	}
+
+	case SEQ_BLOCK_HEADER: {
+		if (*in_pos >= in_size)
+			return LZMA_OK;
+
+		if (coder->pos == 0) {
+			// Detect if it's Index.
+			if (in[*in_pos] == 0x00) {
+				coder->sequence = SEQ_INDEX_WAIT;
+				break;
+			}
+
+			// Calculate the size of the Block Header. Note that
+			// Block Header decoder wants to see this byte too
+			// so don't advance *in_pos.
+			coder->block_options.header_size
+					= lzma_block_header_size_decode(
+						in[*in_pos]);
+		}
+
+		// Copy the Block Header to the internal buffer.
+		lzma_bufcpy(in, in_pos, in_size, coder->buffer, &coder->pos,
+				coder->block_options.header_size);
+
+		// Return if we didn't get the whole Block Header yet.
+		if (coder->pos < coder->block_options.header_size)
+			return LZMA_OK;
+
+		coder->pos = 0;
+
+		// Version 0 is currently the only possible version.
+		coder->block_options.version = 0;
+		coder->block_options.filters = coder->filters;
+
+		// Decode the Block Header.
+		const lzma_ret ret = lzma_block_header_decode(
+				&coder->block_options, allocator,
+				coder->buffer);
+		if (ret != LZMA_OK) {
+			coder->block_options.filters = NULL;
+			return ret;
+		}
+
+		// Check the memory usage limit.
+		const uint64_t memusage
+				= lzma_raw_decoder_memusage(coder->filters);
+
+		if (memusage == UINT64_MAX) {
+			// One or more unknown Filter IDs.
+			free_block_filters(coder, allocator);
+			return LZMA_OPTIONS_ERROR;
+		}
+
+		coder->block_memusage = memusage;
+
+		if (memusage > coder->memlimit) {
+			free_block_filters(coder, allocator);
+			return LZMA_MEMLIMIT_ERROR;
+		}
+
+		if (coder->memusage < memusage)
+			coder->memusage = memusage;
+
+		coder->sequence = SEQ_BLOCK_INIT;
+		break;
+	}
+
+	case SEQ_BLOCK_INIT: {
+		block_mode mode;
+		return_if_error(block_init_mt(coder, allocator, &mode));
+
+		if (mode == BLOCK_WAIT)
+			return LZMA_OK;
+
+		if (mode == BLOCK_QUEUED) {
+			coder->sequence = SEQ_BLOCK_COPY;
+			break;
+		}
+
+		// The Block is decoded in this thread. The earlier Blocks
+		// have to be returned first.
+		if (coder->jobs_head != NULL)
+			return LZMA_OK;
+
+		const lzma_ret init_ret = lzma_block_decoder_init(
+				&coder->block_decoder, allocator,
+				&coder->block_options);
+
+		free_block_filters(coder, allocator);
+
+		if (init_ret != LZMA_OK)
+			return init_ret;
+
+		coder->sequence = SEQ_BLOCK;
+		break;
+	}
+
+	case SEQ_BLOCK_COPY: {
+		job *j = coder->jobs_tail;
+
+		lzma_bufcpy(in, in_pos, in_size, j->in, &j->in_pos,
+				j->in_size);
+
+		if (j->in_pos < j->in_size)
+			return LZMA_OK;
+
+		mythread_mutex_lock(&coder->mutex);
+		j->state = JOB_PENDING;
+		mythread_cond_signal(&coder->cond_work);
+		mythread_mutex_unlock(&coder->mutex);
+
+		coder->sequence = SEQ_BLOCK_HEADER;
+		break;
+	}
+
+	case SEQ_BLOCK: {
+		const lzma_ret ret = coder->block_decoder.code(
+				coder->block_decoder.coder, allocator,
+				in, in_pos, in_size, out, out_pos, out_size,
+				action);
+
+		if (ret != LZMA_STREAM_END)
+			return ret;
+
+		// Block decoded successfully. Add the new size pair to
+		// the Index hash.
+		return_if_error(lzma_index_hash_append(coder->index_hash,
+				lzma_block_unpadded_size(
+					&coder->block_options),
+				coder->block_options.uncompressed_size));
+
+		coder->sequence = SEQ_BLOCK_HEADER;
+		break;
+	}
+
+	case SEQ_INDEX_WAIT:
+		// All the Blocks have to be in the Index hash before
+		// the Index can be verified.
+		if (coder->jobs_head != NULL)
+			return LZMA_OK;
+
+		coder->sequence = SEQ_INDEX;
+
+	// Fall through
+
+	case SEQ_INDEX: {
+		// If we don't have any input, don't call
+		// lzma_index_hash_decode() since it would return
+		// LZMA_BUF_ERROR, which we must not do here.
+		if (*in_pos >= in_size)
+			return LZMA_OK;
+
+		// Decode the Index and compare it to the hash calculated
+		// from the sizes of the Blocks (if any).
+		const lzma_ret ret = lzma_index_hash_decode(coder->index_hash,
+				in, in_pos, in_size);
+		if (ret != LZMA_STREAM_END)
+			return ret;
+
+		coder->sequence = SEQ_STREAM_FOOTER;
+	}
+
+	// Fall through
+
+	case SEQ_STREAM_FOOTER: {
+		// Copy the Stream Footer to the internal buffer.
+		lzma_bufcpy(in, in_pos, in_size, coder->buffer, &coder->pos,
+				LZMA_STREAM_HEADER_SIZE);
+
+		// Return if we didn't get the whole Stream Footer yet.
+		if (coder->pos < LZMA_STREAM_HEADER_SIZE)
+			return LZMA_OK;
+
+		coder->pos = 0;
+
+		lzma_stream_flags footer_flags;
+		const lzma_ret ret = lzma_stream_footer_decode(
+				&footer_flags, coder->buffer);
+		if (ret != LZMA_OK)
+			return ret == LZMA_FORMAT_ERROR
+					? LZMA_DATA_ERROR : ret;
+
+		if (lzma_index_hash_size(coder->index_hash)
+				!= footer_flags.backward_size)
+			return LZMA_DATA_ERROR;
+
+		return_if_error(lzma_stream_flags_compare(
+				&coder->stream_flags, &footer_flags));
+
+		if (!coder->concatenated)
+			return LZMA_STREAM_END;
+
+		coder->sequence = SEQ_STREAM_PADDING;
+	}
+
+	// Fall through
+
+	case SEQ_STREAM_PADDING:
+		assert(coder->concatenated);
+
+		// Skip over possible Stream Padding.
+		while (true) {
+			if (*in_pos >= in_size) {
+				if (action != LZMA_FINISH)
+					return LZMA_OK;
+
+				return coder->pos == 0
+						? LZMA_STREAM_END
+						: LZMA_DATA_ERROR;
+			}
+
+			if (in[*in_pos] != 0x00)
+				break;
+
+			++*in_pos;
+			coder->pos = (coder->pos + 1) & 3;
+		}
+
+		if (coder->pos != 0) {
+			++*in_pos;
+			return LZMA_DATA_ERROR;
+		}
+
+		return_if_error(stream_decoder_reset(coder, allocator));
+		break;
+
+	default:
+		assert(0);
+		return LZMA_PROG_ERROR;
+	}
+
+	// Never reached
+}
+
+
+static lzma_ret
+stream_decode_mt(lzma_coder *coder, lzma_allocator *allocator,
+		const uint8_t *restrict in, size_t *restrict in_pos,
+		size_t in_size, uint8_t *restrict out,
+		size_t *restrict out_pos, size_t out_size, lzma_action action)
+{
+	while (true) {
+		const size_t in_start = *in_pos;
+		const size_t out_start = *out_pos;
+
+		return_if_error(output_jobs(coder, out, out_pos, out_size));
+
+		const lzma_ret ret = decode_input(coder, allocator,
+				in, in_pos, in_size, out, out_pos, out_size,
+				action);
+		if (ret != LZMA_OK)
+			return ret;
+
+		if (*in_pos != in_start || *out_pos != out_start)
+			continue;
+
+		// No progress. Return if the application has to provide
+		// more input or output space; otherwise wait for the first
+		// Block in flight to be decoded.
+		job *j = coder->jobs_head;
+		if (*out_pos == out_size || j == NULL)
+			return LZMA_OK;
+
+		mythread_mutex_lock(&coder->mutex);
+
+		if (j->state == JOB_COLLECTING) {
+			mythread_mutex_unlock(&coder->mutex);
+			return LZMA_OK;
+		}
+
+		while (j->state != JOB_DONE)
+			mythread_cond_wait(&coder->cond_done, &coder->mutex);
+
+		mythread_mutex_unlock(&coder->mutex);
+	}
+}
+
+
+static void
+stream_decoder_mt_end(lzma_coder *coder, lzma_allocator *allocator)
+{
+	mythread_mutex_lock(&coder->mutex);
+	coder->shutdown = true;
+	mythread_cond_broadcast(&coder->cond_work);
+	mythread_mutex_unlock(&coder->mutex);
+
+	for (uint32_t i = 0; i < coder->threads; ++i) {
+		mythread_join(coder->workers[i].thread);
+		lzma_next_end(&coder->workers[i].block_decoder, allocator);
+	}
+
+	while (coder->jobs_head != NULL) {
+		job *j = coder->jobs_head;
+		coder->jobs_head = j->next;
+		job_free(j, allocator);
+	}
+
+	free_block_filters(coder, allocator);
+
+	mythread_cond_destroy(&coder->cond_done);
+	mythread_cond_destroy(&coder->cond_work);
+	mythread_mutex_destroy(&coder->mutex);
+
+	lzma_free(coder->workers, allocator);
+	lzma_next_end(&coder->block_decoder, allocator);
+	lzma_index_hash_end(coder->index_hash, allocator);
+	lzma_free(coder, allocator);
+	return;
+}
+
+
+static lzma_check
+stream_decoder_mt_get_check(const lzma_coder *coder)
+{
+	return coder->stream_flags.check;
+}
+
+
+static lzma_ret
+stream_decoder_mt_memconfig(lzma_coder *coder, uint64_t *memusage,
+		uint64_t *old_memlimit, uint64_t new_memlimit)
+{
+	// The Block decoders of the workers and the Blocks in flight
+	// are included in the estimate.
+	*memusage = coder->memusage * (coder->threads + 1)
+			+ coder->jobs_memusage;
+	*old_memlimit = coder->memlimit;
+
+	if (new_memlimit != 0) {
+		if (new_memlimit < coder->memusage)
+			return LZMA_MEMLIMIT_ERROR;
+
+		coder->memlimit = new_memlimit;
+	}
+
+	return LZMA_OK;
+}
+
+
+static lzma_ret
+stream_decoder_mt_init(lzma_next_coder *next, lzma_allocator *allocator,
+		const lzma_mt *options)
+{
+	lzma_next_coder_init(&stream_decoder_mt_init, next, allocator);
+
+	if (options == NULL || options->memlimit_stop == 0)
+		return LZMA_PROG_ERROR;
+
+	if (options->flags & ~LZMA_SUPPORTED_FLAGS)
+		return LZMA_OPTIONS_ERROR;
+
+	if (options->threads == 0 || options->threads > LZMA_THREADS_MAX)
+		return LZMA_OPTIONS_ERROR;
+
+	// One thread is handled by the single-threaded decoder.
+	if (options->threads == 1)
+		return lzma_stream_decoder_init(next, allocator,
+				options->memlimit_stop, options->flags);
+
+	// The worker threads are started again for every initialization
+	// instead of trying to reuse the old ones.
+	lzma_next_end(next, allocator);
+	next->init = (uintptr_t)(&stream_decoder_mt_init);
+
+	lzma_coder *coder = lzma_alloc(sizeof(lzma_coder), allocator);
+	if (coder == NULL)
+		return LZMA_MEM_ERROR;
+
+	coder->workers = lzma_alloc(options->threads * sizeof(worker),
+			allocator);
+	if (coder->workers == NULL) {
+		lzma_free(coder, allocator);
+		return LZMA_MEM_ERROR;
+	}
+
+	if (mythread_mutex_init(&coder->mutex)) {
+		lzma_free(coder->workers, allocator);
+		lzma_free(coder, allocator);
+		return LZMA_MEM_ERROR;
+	}
+
+	if (mythread_cond_init(&coder->cond_work)) {
+		mythread_mutex_destroy(&coder->mutex);
+		lzma_free(coder->workers, allocator);
+		lzma_free(coder, allocator);
+		return LZMA_MEM_ERROR;
+	}
+
+	if (mythread_cond_init(&coder->cond_done)) {
+		mythread_cond_destroy(&coder->cond_work);
+		mythread_mutex_destroy(&coder->mutex);
+		lzma_free(coder->workers, allocator);
+		lzma_free(coder, allocator);
+		return LZMA_MEM_ERROR;
+	}
+
+	next->coder = coder;
+	next->code = &stream_decode_mt;
+	next->end = &stream_decoder_mt_end;
+	next->get_check = &stream_decoder_mt_get_check;
+	next->memconfig = &stream_decoder_mt_memconfig;
+
+	coder->block_decoder = LZMA_NEXT_CODER_INIT;
+	coder->block_options.filters = NULL;
+	coder->index_hash = NULL;
+	coder->allocator = allocator;
+	coder->shutdown = false;
+	coder->threads = 0;
+	coder->jobs_head = NULL;
+	coder->jobs_tail = NULL;
+	coder->jobs_count = 0;
+	coder->jobs_memusage = 0;
+
+	coder->memlimit = options->memlimit_stop;
+	coder->memlimit_threading = options->memlimit_threading == 0
+			|| options->memlimit_threading > options->memlimit_stop
+			? options->memlimit_stop
+			: options->memlimit_threading;
+	coder->memusage = LZMA_MEMUSAGE_BASE;
+	coder->tell_no_check = (options->flags & LZMA_TELL_NO_CHECK) != 0;
+	coder->tell_unsupported_check
+			= (options->flags & LZMA_TELL_UNSUPPORTED_CHECK) != 0;
+	coder->tell_any_check = (options->flags & LZMA_TELL_ANY_CHECK) != 0;
+	coder->concatenated = (options->flags & LZMA_CONCATENATED) != 0;
+	coder->first_stream = true;
+
+	// Start the workers. If only some of them could be created,
+	// continue with those.
+	for (uint32_t i = 0; i < options->threads; ++i) {
+		worker *w = &coder->workers[i];
+		w->coder = coder;
+		w->block_decoder = LZMA_NEXT_CODER_INIT;
+
+		if (mythread_create(&w->thread, &worker_start, w))
+			break;
+
+		++coder->threads;
+	}
+
+	if (coder->threads == 0)
+		return LZMA_MEM_ERROR;
+
+	return stream_decoder_reset(coder, allocator);
+}
+
+#endif
+
+
+extern LZMA_API(lzma_ret)
+lzma_stream_decoder_mt(lzma_stream *strm, const lzma_mt *options)
+{
+#ifdef MYTHREAD_ENABLED
+	lzma_next_strm_init(stream_decoder_mt_init, strm, options);
+#else
+	if (options == NULL)
+		return LZMA_PROG_ERROR;
+
+	if (options->threads == 0 || options->threads > LZMA_THREADS_MAX)
+		return LZMA_OPTIONS_ERROR;
+
+	lzma_next_strm_init(lzma_stream_decoder_init, strm,
+			options->memlimit_stop, options->flags);
+#endif
+
+	strm->internal->supported_actions[LZMA_RUN] = true;
+	strm->internal->supported_actions[LZMA_FINISH] = true;
+
+	return LZMA_OK;
+}
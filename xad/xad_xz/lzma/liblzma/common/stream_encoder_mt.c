@@ -0,0 +1,730 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+/// \file       stream_encoder_mt.c
+/// \brief      Multithreaded .xz Stream encoder
+//
+//  This file has been put into the public domain.
+//  You can do whatever you want with this file.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "easy_preset.h"
+#include "block_encoder.h"
+#include "index_encoder.h"
+#include "stream_encoder.h"
+
+
+/// Number of Blocks in flight per worker thread. One is being compressed
+/// while the other one is being filled or written out.
+#define JOBS_PER_THREAD 2
+
+/// Smallest default Block size
+#define BLOCK_SIZE_MIN (UINT64_C(1) << 20)
+
+
+/// Get the filter chain and the Block size from the options.
+static lzma_ret
+get_options(const lzma_mt *options, lzma_options_easy *easy,
+		const lzma_filter **filters, uint64_t *block_size)
+{
+	if (options == NULL)
+		return LZMA_PROG_ERROR;
+
+	if (options->flags != 0 || options->threads == 0
+			|| options->threads > LZMA_THREADS_MAX)
+		return LZMA_OPTIONS_ERROR;
+
+	if (options->filters != NULL) {
+		*filters = options->filters;
+	} else {
+		if (lzma_easy_preset(easy, options->preset))
+			return LZMA_OPTIONS_ERROR;
+
+		*filters = easy->filters;
+	}
+
+	if (options->block_size > 0) {
+		*block_size = options->block_size;
+	} else {
+		// Three times the dictionary size gives a good balance
+		// between compression ratio and parallelism.
+		*block_size = BLOCK_SIZE_MIN;
+
+		for (size_t i = 0; (*filters)[i].id != LZMA_VLI_UNKNOWN; ++i) {
+			if ((*filters)[i].id != LZMA_FILTER_LZMA2
+					|| (*filters)[i].options == NULL)
+				continue;
+
+			const lzma_options_lzma *opt = (*filters)[i].options;
+			if (*block_size < 3 * (uint64_t)(opt->dict_size))
+				*block_size = 3 * (uint64_t)(opt->dict_size);
+		}
+	}
+
+	// The output buffer has to be able to hold a whole Block.
+	if (*block_size > SIZE_MAX
+			|| lzma_block_buffer_bound((size_t)(*block_size)) == 0)
+		return LZMA_OPTIONS_ERROR;
+
+	return LZMA_OK;
+}
+
+
+extern LZMA_API(uint64_t)
+lzma_stream_encoder_mt_memusage(const lzma_mt *options)
+{
+	lzma_options_easy easy;
+	const lzma_filter *filters;
+	uint64_t block_size;
+
+	if (get_options(options, &easy, &filters, &block_size) != LZMA_OK)
+		return UINT64_MAX;
+
+	const uint64_t filters_memusage = lzma_raw_encoder_memusage(filters);
+	if (filters_memusage == UINT64_MAX)
+		return UINT64_MAX;
+
+	// The input and output buffers of the Blocks in flight
+	const uint64_t buffers_memusage = JOBS_PER_THREAD * (block_size
+			+ lzma_block_buffer_bound((size_t)(block_size)));
+
+	const uint64_t thread_memusage = filters_memusage + buffers_memusage;
+	if (thread_memusage > (UINT64_MAX - LZMA_MEMUSAGE_BASE)
+			/ options->threads)
+		return UINT64_MAX;
+
+	return LZMA_MEMUSAGE_BASE + thread_memusage * options->threads;
+}
+
+
+#ifdef MYTHREAD_ENABLED
+
+typedef enum {
+	/// Input is being copied from the application.
+	JOB_FILLING,
+
+	/// Waiting for a worker thread
+	JOB_PENDING,
+
+	/// A worker thread is compressing the Block.
+	JOB_RUNNING,
+
+	/// Compressed (or failed); the output can be written out.
+	JOB_DONE,
+} job_state;
+
+
+typedef struct job_s job;
+struct job_s {
+	/// Next Block in the Stream
+	job *next;
+
+	job_state state;
+
+	/// Return value of the worker
+	lzma_ret ret;
+
+	/// Block options. The sizes are filled in by the worker.
+	lzma_block block;
+
+	/// Uncompressed data
+	uint8_t *in;
+	size_t in_size;
+
+	/// Block Header, followed by the Compressed Data, Block Padding,
+	/// and Check in out[]
+	uint8_t header[LZMA_BLOCK_HEADER_SIZE_MAX];
+	uint8_t *out;
+	size_t out_size;
+
+	/// Position of the data not yet written out. Positions below
+	/// block.header_size are in header[], the rest in out[].
+	size_t pos;
+};
+
+
+typedef struct {
+	lzma_coder *coder;
+	mythread thread;
+
+	/// Block encoder of this thread. It is reused for every Block
+	/// so that the match finder doesn't need to be reallocated.
+	lzma_next_coder block_encoder;
+} worker;
+
+
+struct lzma_coder_s {
+	enum {
+		SEQ_STREAM_HEADER,
+		SEQ_BLOCK,
+		SEQ_INDEX,
+		SEQ_STREAM_FOOTER,
+	} sequence;
+
+	/// Uncompressed size of a Block
+	size_t block_size;
+
+	/// Size of the output buffer of a Block
+	size_t out_size;
+
+	/// The filter chain used for every Block
+	lzma_filter filters[LZMA_FILTERS_MAX + 1];
+
+	/// Integrity check type
+	lzma_check check;
+
+	/// Index to hold sizes of the Blocks
+	lzma_index *index;
+
+	/// Index encoder
+	lzma_next_coder index_encoder;
+
+	/// Read position in buffer[]
+	size_t buffer_pos;
+
+	/// Buffer to hold Stream Header and Stream Footer
+	uint8_t buffer[LZMA_STREAM_HEADER_SIZE];
+
+	/// Allocator given to the init function, used by the workers
+	lzma_allocator *allocator;
+
+	/// Protects the job states
+	mythread_mutex mutex;
+
+	/// Signaled when a job becomes JOB_PENDING or on shutdown
+	mythread_cond cond_work;
+
+	/// Signaled when a job becomes JOB_DONE
+	mythread_cond cond_done;
+
+	/// Set when the worker threads should exit
+	bool shutdown;
+
+	worker *workers;
+	uint32_t threads;
+
+	/// Blocks in flight in Stream order. Only the calling thread
+	/// adds and removes jobs.
+	job *jobs_head;
+	job *jobs_tail;
+	uint32_t jobs_count;
+
+	/// The job being filled, or NULL. This is always jobs_tail.
+	job *input;
+};
+
+
+static void
+job_free(job *j, lzma_allocator *allocator)
+{
+	lzma_free(j->in, allocator);
+	lzma_free(j->out, allocator);
+	lzma_free(j, allocator);
+	return;
+}
+
+
+/// Compress one Block. This is called without holding the mutex.
+static lzma_ret
+worker_encode(worker *w, job *j)
+{
+	lzma_coder *coder = w->coder;
+	lzma_allocator *allocator = coder->allocator;
+
+	j->block.version = 0;
+	j->block.check = coder->check;
+	j->block.compressed_size = LZMA_VLI_UNKNOWN;
+	j->block.uncompressed_size = LZMA_VLI_UNKNOWN;
+	j->block.filters = coder->filters;
+
+	return_if_error(lzma_block_encoder_init(&w->block_encoder,
+			allocator, &j->block));
+
+	size_t in_pos = 0;
+	size_t out_pos = 0;
+	lzma_ret ret;
+
+	do {
+		const size_t in_start = in_pos;
+		const size_t out_start = out_pos;
+
+		ret = w->block_encoder.code(w->block_encoder.coder, allocator,
+				j->in, &in_pos, j->in_size,
+				j->out, &out_pos, coder->out_size, LZMA_FINISH);
+
+		// out[] is big enough for the worst case, so no progress
+		// means a bug.
+		if (ret == LZMA_OK && in_pos == in_start
+				&& out_pos == out_start)
+			ret = LZMA_PROG_ERROR;
+
+	} while (ret == LZMA_OK);
+
+	if (ret != LZMA_STREAM_END)
+		return ret;
+
+	// The uncompressed data isn't needed anymore.
+	lzma_free(j->in, allocator);
+	j->in = NULL;
+	j->out_size = out_pos;
+
+	// Now that the sizes are known, they can be stored in the Block
+	// Header so that the Block can be decoded independently.
+	return_if_error(lzma_block_header_size(&j->block));
+	return lzma_block_header_encode(&j->block, j->header);
+}
+
+
+static MYTHREAD_RET_TYPE
+worker_start(void *arg)
+{
+	worker *w = arg;
+	lzma_coder *coder = w->coder;
+
+	mythread_mutex_lock(&coder->mutex);
+
+	while (true) {
+		job *j = coder->jobs_head;
+		while (j != NULL && j->state != JOB_PENDING)
+			j = j->next;
+
+		if (coder->shutdown)
+			break;
+
+		if (j == NULL) {
+			mythread_cond_wait(&coder->cond_work, &coder->mutex);
+			continue;
+		}
+
+		j->state = JOB_RUNNING;
+		mythread_mutex_unlock(&coder->mutex);
+
+		const lzma_ret ret = worker_encode(w, j);
+
+		mythread_mutex_lock(&coder->mutex);
+		j->ret = ret == LZMA_STREAM_END ? LZMA_OK : ret;
+		j->state = JOB_DONE;
+		mythread_cond_broadcast(&coder->cond_done);
+	}
+
+	mythread_mutex_unlock(&coder->mutex);
+
+	return MYTHREAD_RET_VALUE;
+}
+
+
+static job_state
+job_get_state(lzma_coder *coder, job *j)
+{
+	mythread_mutex_lock(&coder->mutex);
+	const job_state state = j->state;
+	mythread_mutex_unlock(&coder->mutex);
+	return state;
+}
+
+
+/// Hand the job being filled over to the worker threads.
+static void
+submit_input(lzma_coder *coder)
+{
+	mythread_mutex_lock(&coder->mutex);
+	coder->input->state = JOB_PENDING;
+	mythread_cond_signal(&coder->cond_work);
+	mythread_mutex_unlock(&coder->mutex);
+
+	coder->input = NULL;
+	return;
+}
+
+
+/// Start a new job for the input, if there's room for one.
+static lzma_ret
+start_input(lzma_coder *coder, lzma_allocator *allocator)
+{
+	if (coder->jobs_count >= coder->threads * JOBS_PER_THREAD)
+		return LZMA_OK;
+
+	job *j = lzma_alloc(sizeof(job), allocator);
+	if (j == NULL)
+		return LZMA_MEM_ERROR;
+
+	j->in = lzma_alloc(coder->block_size, allocator);
+	j->out = lzma_alloc(coder->out_size, allocator);
+	if (j->in == NULL || j->out == NULL) {
+		job_free(j, allocator);
+		return LZMA_MEM_ERROR;
+	}
+
+	j->next = NULL;
+	j->state = JOB_FILLING;
+	j->ret = LZMA_OK;
+	j->in_size = 0;
+	j->out_size = 0;
+	j->pos = 0;
+
+	mythread_mutex_lock(&coder->mutex);
+	if (coder->jobs_tail == NULL)
+		coder->jobs_head = j;
+	else
+		coder->jobs_tail->next = j;
+
+	coder->jobs_tail = j;
+	++coder->jobs_count;
+	mythread_mutex_unlock(&coder->mutex);
+
+	coder->input = j;
+	return LZMA_OK;
+}
+
+
+/// Write the finished Blocks out in Stream order.
+static lzma_ret
+output_jobs(lzma_coder *coder, lzma_allocator *allocator,
+		uint8_t *restrict out, size_t *restrict out_pos,
+		size_t out_size)
+{
+	while (coder->jobs_head != NULL && *out_pos < out_size) {
+		job *j = coder->jobs_head;
+
+		if (job_get_state(coder, j) != JOB_DONE)
+			break;
+
+		if (j->ret != LZMA_OK)
+			return j->ret;
+
+		const size_t header_size = j->block.header_size;
+
+		if (j->pos < header_size) {
+			lzma_bufcpy(j->header, &j->pos, header_size,
+					out, out_pos, out_size);
+			if (j->pos < header_size)
+				break;
+		}
+
+		size_t data_pos = j->pos - header_size;
+		lzma_bufcpy(j->out, &data_pos, j->out_size,
+				out, out_pos, out_size);
+		j->pos = header_size + data_pos;
+
+		if (data_pos < j->out_size)
+			break;
+
+		// The whole Block has been written out.
+		return_if_error(lzma_index_append(coder->index, allocator,
+				lzma_block_unpadded_size(&j->block),
+				j->block.uncompressed_size));
+
+		mythread_mutex_lock(&coder->mutex);
+		coder->jobs_head = j->next;
+		if (coder->jobs_head == NULL)
+			coder->jobs_tail = NULL;
+
+		--coder->jobs_count;
+		mythread_mutex_unlock(&coder->mutex);
+
+		job_free(j, allocator);
+	}
+
+	return LZMA_OK;
+}
+
+
+static lzma_ret
+stream_encode_mt(lzma_coder *coder, lzma_allocator *allocator,
+		const uint8_t *restrict in, size_t *restrict in_pos,
+		size_t in_size, uint8_t *restrict out,
+		size_t *restrict out_pos, size_t out_size, lzma_action action)
+{
+	switch (coder->sequence) {
+	case SEQ_STREAM_HEADER:
+		lzma_bufcpy(coder->buffer, &coder->buffer_pos,
+				LZMA_STREAM_HEADER_SIZE,
+				out, out_pos, out_size);
+		if (coder->buffer_pos < LZMA_STREAM_HEADER_SIZE)
+			return LZMA_OK;
+
+		coder->buffer_pos = 0;
+		coder->sequence = SEQ_BLOCK;
+
+	// Fall through
+
+	case SEQ_BLOCK:
+		while (true) {
+			const size_t in_start = *in_pos;
+			const size_t out_start = *out_pos;
+
+			return_if_error(output_jobs(coder, allocator,
+					out, out_pos, out_size));
+
+			if (*in_pos < in_size && coder->input == NULL)
+				return_if_error(start_input(
+						coder, allocator));
+
+			if (coder->input != NULL) {
+				job *j = coder->input;
+
+				lzma_bufcpy(in, in_pos, in_size, j->in,
+						&j->in_size, coder->block_size);
+
+				// A Block is finished when it's full or when
+				// the application flushes or finishes.
+				if (j->in_size == coder->block_size
+						|| (*in_pos == in_size
+						&& action != LZMA_RUN))
+					submit_input(coder);
+			}
+
+			if (*in_pos == in_size && action != LZMA_RUN
+					&& coder->jobs_head == NULL) {
+				if (action == LZMA_FULL_FLUSH)
+					return LZMA_STREAM_END;
+
+				break;
+			}
+
+			if (*in_pos != in_start || *out_pos != out_start)
+				continue;
+
+			// No progress. Return if the application has to
+			// provide more input or output space; otherwise
+			// wait for the first Block in flight.
+			job *j = coder->jobs_head;
+			if (*out_pos == out_size || j == NULL
+					|| j == coder->input)
+				return LZMA_OK;
+
+			mythread_mutex_lock(&coder->mutex);
+			while (j->state != JOB_DONE)
+				mythread_cond_wait(&coder->cond_done,
+						&coder->mutex);
+			mythread_mutex_unlock(&coder->mutex);
+		}
+
+		// All Blocks have been written out.
+		return_if_error(lzma_index_encoder_init(
+				&coder->index_encoder, allocator,
+				coder->index));
+		coder->sequence = SEQ_INDEX;
+
+	// Fall through
+
+	case SEQ_INDEX: {
+		// Call the Index encoder. It doesn't take any input, so
+		// those pointers can be NULL.
+		const lzma_ret ret = coder->index_encoder.code(
+				coder->index_encoder.coder, allocator,
+				NULL, NULL, 0,
+				out, out_pos, out_size, LZMA_RUN);
+		if (ret != LZMA_STREAM_END)
+			return ret;
+
+		// Encode the Stream Footer into coder->buffer.
+		const lzma_stream_flags stream_flags = {
+			.version = 0,
+			.backward_size = lzma_index_size(coder->index),
+			.check = coder->check,
+		};
+
+		if (lzma_stream_footer_encode(&stream_flags, coder->buffer)
+				!= LZMA_OK)
+			return LZMA_PROG_ERROR;
+
+		coder->sequence = SEQ_STREAM_FOOTER;
+	}
+
+	// Fall through
+
+	case SEQ_STREAM_FOOTER:
+		lzma_bufcpy(coder->buffer, &coder->buffer_pos,
+				LZMA_STREAM_HEADER_SIZE,
+				out, out_pos, out_size);
+		return coder->buffer_pos < LZMA_STREAM_HEADER_SIZE
+				? LZMA_OK : LZMA_STREAM_END;
+
+	default:
+		assert(0);
+		return LZMA_PROG_ERROR;
+	}
+}
+
+
+static void
+stream_encoder_mt_end(lzma_coder *coder, lzma_allocator *allocator)
+{
+	mythread_mutex_lock(&coder->mutex);
+	coder->shutdown = true;
+	mythread_cond_broadcast(&coder->cond_work);
+	mythread_mutex_unlock(&coder->mutex);
+
+	for (uint32_t i = 0; i < coder->threads; ++i) {
+		mythread_join(coder->workers[i].thread);
+		lzma_next_end(&coder->workers[i].block_encoder, allocator);
+	}
+
+	while (coder->jobs_head != NULL) {
+		job *j = coder->jobs_head;
+		coder->jobs_head = j->next;
+		job_free(j, allocator);
+	}
+
+	for (size_t i = 0; coder->filters[i].id != LZMA_VLI_UNKNOWN; ++i)
+		lzma_free(coder->filters[i].options, allocator);
+
+	mythread_cond_destroy(&coder->cond_done);
+	mythread_cond_destroy(&coder->cond_work);
+	mythread_mutex_destroy(&coder->mutex);
+
+	lzma_free(coder->workers, allocator);
+	lzma_next_end(&coder->index_encoder, allocator);
+	lzma_index_end(coder->index, allocator);
+	lzma_free(coder, allocator);
+	return;
+}
+
+
+static lzma_ret
+stream_encoder_mt_init(lzma_next_coder *next, lzma_allocator *allocator,
+		const lzma_mt *options)
+{
+	lzma_next_coder_init(&stream_encoder_mt_init, next, allocator);
+
+	lzma_options_easy easy;
+	const lzma_filter *filters;
+	uint64_t block_size;
+
+	return_if_error(get_options(options, &easy, &filters, &block_size));
+
+	if ((unsigned int)(options->check) > LZMA_CHECK_ID_MAX)
+		return LZMA_PROG_ERROR;
+
+	if (!lzma_check_is_supported(options->check))
+		return LZMA_UNSUPPORTED_CHECK;
+
+	// Validate the filter chain so that errors are reported now
+	// instead of by the first worker.
+	if (lzma_raw_encoder_memusage(filters) == UINT64_MAX)
+		return LZMA_OPTIONS_ERROR;
+
+	lzma_block block = {
+		.version = 0,
+		.check = options->check,
+		.compressed_size = LZMA_VLI_UNKNOWN,
+		.uncompressed_size = LZMA_VLI_UNKNOWN,
+		.filters = (lzma_filter *)(filters),
+	};
+	return_if_error(lzma_block_header_size(&block));
+
+	// The worker threads are started again for every initialization
+	// instead of trying to reuse the old ones.
+	lzma_next_end(next, allocator);
+	next->init = (uintptr_t)(&stream_encoder_mt_init);
+
+	lzma_coder *coder = lzma_alloc(sizeof(lzma_coder), allocator);
+	if (coder == NULL)
+		return LZMA_MEM_ERROR;
+
+	coder->workers = lzma_alloc(options->threads * sizeof(worker),
+			allocator);
+	if (coder->workers == NULL) {
+		lzma_free(coder, allocator);
+		return LZMA_MEM_ERROR;
+	}
+
+	if (mythread_mutex_init(&coder->mutex)) {
+		lzma_free(coder->workers, allocator);
+		lzma_free(coder, allocator);
+		return LZMA_MEM_ERROR;
+	}
+
+	if (mythread_cond_init(&coder->cond_work)) {
+		mythread_mutex_destroy(&coder->mutex);
+		lzma_free(coder->workers, allocator);
+		lzma_free(coder, allocator);
+		return LZMA_MEM_ERROR;
+	}
+
+	if (mythread_cond_init(&coder->cond_done)) {
+		mythread_cond_destroy(&coder->cond_work);
+		mythread_mutex_destroy(&coder->mutex);
+		lzma_free(coder->workers, allocator);
+		lzma_free(coder, allocator);
+		return LZMA_MEM_ERROR;
+	}
+
+	next->coder = coder;
+	next->code = &stream_encode_mt;
+	next->end = &stream_encoder_mt_end;
+
+	coder->sequence = SEQ_STREAM_HEADER;
+	coder->block_size = (size_t)(block_size);
+	coder->out_size = lzma_block_buffer_bound(coder->block_size);
+	coder->filters[0].id = LZMA_VLI_UNKNOWN;
+	coder->check = options->check;
+	coder->index = NULL;
+	coder->index_encoder = LZMA_NEXT_CODER_INIT;
+	coder->buffer_pos = 0;
+	coder->allocator = allocator;
+	coder->shutdown = false;
+	coder->threads = 0;
+	coder->jobs_head = NULL;
+	coder->jobs_tail = NULL;
+	coder->jobs_count = 0;
+	coder->input = NULL;
+
+	return_if_error(lzma_filters_copy(filters, coder->filters, allocator));
+
+	coder->index = lzma_index_init(allocator);
+	if (coder->index == NULL)
+		return LZMA_MEM_ERROR;
+
+	const lzma_stream_flags stream_flags = {
+		.version = 0,
+		.check = options->check,
+	};
+	return_if_error(lzma_stream_header_encode(
+			&stream_flags, coder->buffer));
+
+	// Start the workers. If only some of them could be created,
+	// continue with those.
+	for (uint32_t i = 0; i < options->threads; ++i) {
+		worker *w = &coder->workers[i];
+		w->coder = coder;
+		w->block_encoder = LZMA_NEXT_CODER_INIT;
+
+		if (mythread_create(&w->thread, &worker_start, w))
+			break;
+
+		++coder->threads;
+	}
+
+	if (coder->threads == 0)
+		return LZMA_MEM_ERROR;
+
+	return LZMA_OK;
+}
+
+#endif
+
+
+extern LZMA_API(lzma_ret)
+lzma_stream_encoder_mt(lzma_stream *strm, const lzma_mt *options)
+{
+#ifdef MYTHREAD_ENABLED
+	lzma_next_strm_init(stream_encoder_mt_init, strm, options);
+#else
+	lzma_options_easy easy;
+	const lzma_filter *filters;
+	uint64_t block_size;
+
+	return_if_error(get_options(options, &easy, &filters, &block_size));
+
+	lzma_next_strm_init(lzma_stream_encoder_init, strm,
+			filters, options->check);
+#endif
+
+	strm->internal->supported_actions[LZMA_RUN] = true;
+	strm->internal->supported_actions[LZMA_FULL_FLUSH] = true;
+	strm->internal->supported_actions[LZMA_FINISH] = true;
+
+	return LZMA_OK;
+}
@@ -135,6 +135,125 @@ REG(a6, struct xadMasterBase *xadMasterBase))
     return 0; /* unknown file */
 }
 
+/* Get the uncompressed size from the indexes of the streams, working
+   backwards from the end of the file. Only the stream footers, headers
+   and indexes are read. */
+#ifdef __amigaos4__
+static LONG xz_IndexSize(struct xadArchiveInfo *ai, lzma_vli *size,
+struct xadMasterIFace *IxadMaster)
+#else
+static LONG xz_IndexSize(struct xadArchiveInfo *ai, lzma_vli *size,
+struct xadMasterBase *xadMasterBase)
+#endif
+{
+	UBYTE buf[LZMA_STREAM_HEADER_SIZE];
+	UBYTE *inbuffer;
+	lzma_stream strm = LZMA_STREAM_INIT;
+	lzma_stream_flags footer_flags, header_flags;
+	lzma_index *idx;
+	lzma_vli pos, indexleft, streamsize;
+	ULONG readbytes;
+	lzma_ret ret = LZMA_OK;
+	long err = XADERR_OK;
+
+	*size = 0;
+	pos = ai->xai_InSize;
+
+	inbuffer = xadAllocVec(XZ_IN_BUF_SIZE, MEMF_PRIVATE);
+	if(!inbuffer) return XADERR_NOMEMORY;
+
+	while((err == XADERR_OK) && (pos > 0))
+	{
+		if(pos < 2 * LZMA_STREAM_HEADER_SIZE)
+		{
+			err = XADERR_ILLEGALDATA;
+			break;
+		}
+
+		/* stream footer, skipping any stream padding */
+		if((err = xadHookAccess(XADAC_INPUTSEEK, (long)(pos - LZMA_STREAM_HEADER_SIZE) - ai->xai_InPos, 0, ai))) break;
+		if((err = xadHookAccess(XADAC_READ, LZMA_STREAM_HEADER_SIZE, buf, ai))) break;
+
+		if(!buf[8] && !buf[9] && !buf[10] && !buf[11])
+		{
+			pos -= 4;
+			continue;
+		}
+
+		if(lzma_stream_footer_decode(&footer_flags, buf) != LZMA_OK)
+		{
+			err = XADERR_ILLEGALDATA;
+			break;
+		}
+
+		pos -= LZMA_STREAM_HEADER_SIZE;
+		if(pos < LZMA_STREAM_HEADER_SIZE + footer_flags.backward_size)
+		{
+			err = XADERR_ILLEGALDATA;
+			break;
+		}
+
+		/* index */
+		if((err = xadHookAccess(XADAC_INPUTSEEK, (long)(pos - footer_flags.backward_size) - ai->xai_InPos, 0, ai))) break;
+
+		if(lzma_index_decoder(&strm, &idx, UINT64_MAX) != LZMA_OK)
+		{
+			err = XADERR_NOMEMORY;
+			break;
+		}
+
+		indexleft = footer_flags.backward_size;
+		do
+		{
+			readbytes = indexleft > XZ_IN_BUF_SIZE ? XZ_IN_BUF_SIZE : indexleft;
+			if((err = xadHookAccess(XADAC_READ, readbytes, inbuffer, ai))) break;
+
+			strm.next_in = inbuffer;
+			strm.avail_in = readbytes;
+			indexleft -= readbytes;
+
+			ret = lzma_code(&strm, LZMA_RUN);
+		} while((ret == LZMA_OK) && (indexleft > 0));
+
+		if(err) break;
+
+		if((ret != LZMA_STREAM_END) || (indexleft > 0) || (strm.avail_in > 0))
+		{
+			/* the decoder frees the index on error */
+			if(ret == LZMA_STREAM_END) lzma_index_end(idx, NULL);
+			err = XADERR_ILLEGALDATA;
+			break;
+		}
+
+		/* stream header, which has to match the footer */
+		streamsize = lzma_index_stream_size(idx);
+		pos += LZMA_STREAM_HEADER_SIZE;
+
+		if(pos < streamsize)
+		{
+			lzma_index_end(idx, NULL);
+			err = XADERR_ILLEGALDATA;
+			break;
+		}
+
+		pos -= streamsize;
+		*size += lzma_index_uncompressed_size(idx);
+		lzma_index_end(idx, NULL);
+
+		if((err = xadHookAccess(XADAC_INPUTSEEK, (long)pos - ai->xai_InPos, 0, ai))) break;
+		if((err = xadHookAccess(XADAC_READ, LZMA_STREAM_HEADER_SIZE, buf, ai))) break;
+
+		if((lzma_stream_header_decode(&header_flags, buf) != LZMA_OK) ||
+			(lzma_stream_flags_compare(&header_flags, &footer_flags) != LZMA_OK))
+			err = XADERR_ILLEGALDATA;
+	}
+
+	lzma_end(&strm);
+	xadFreeObjectA(inbuffer, NULL);
+
+	return err;
+}
+
 #ifdef __amigaos4__
 LONG sz_GetInfo(struct xadArchiveInfo *ai,
 struct xadMasterIFace *IxadMaster)
@@ -145,6 +264,7 @@ REG(a6, struct xadMasterBase *xadMasterBase))
 {
   struct xadFileInfo *fi;
 	long err=XADERR_OK;
+	lzma_vli size;
 	if (!open_lzma()) return XADERR_RESOURCE;
 
 	ai->xai_PrivateClient = xadAllocVec(sizeof(struct xad7zprivate),MEMF_PRIVATE | MEMF_CLEAR);
@@ -162,6 +282,20 @@ REG(a6, struct xadMasterBase *xadMasterBase))
 
 	fi->xfi_Flags = XADFIF_NODATE | XADFIF_NOUNCRUNCHSIZE | XADFIF_NOFILENAME;
 
+	/* leave the size unknown if the index can't be read or the size
+	   doesn't fit, sz_UnArchive reports any errors */
+#ifdef __amigaos4__
+	if(xz_IndexSize(ai, &size, IxadMaster) == XADERR_OK)
+#else
+	if(xz_IndexSize(ai, &size, xadMasterBase) == XADERR_OK)
+#endif
+	{
+		fi->xfi_Size = size;
+		if(fi->xfi_Size == size) fi->xfi_Flags &= ~XADFIF_NOUNCRUNCHSIZE;
+	}
+
+	xadHookAccess(XADAC_INPUTSEEK, -ai->xai_InPos, 0, ai);
+
 		 if ((err = xadAddFileEntryA(fi, ai, NULL))) return(XADERR_NOMEMORY);
 
 return(err);
@@ -179,40 +313,84 @@ REG(a6, struct xadMasterBase *xadMasterBase))
   struct xadFileInfo *fi = ai->xai_CurFile;
 	UBYTE *inbuffer, *outbuffer;
 	long err=XADERR_OK;
+	ULONG inleft, readbytes;
 	lzma_ret ret;
+	lzma_action action = LZMA_RUN;
 	lzma_stream strm = LZMA_STREAM_INIT;
+#ifdef __AROS__
+	lzma_mt mt = { 0 };
+#endif
 
 	if (!open_lzma()) return XADERR_RESOURCE;
 
-	inbuffer = 	xadAllocVec(ai->xai_InSize, MEMF_CLEAR);
-	outbuffer = xadAllocVec(1024, MEMF_CLEAR);
-
-	xadHookAccess(XADAC_READ, ai->xai_InSize, inbuffer, ai);
-	// need to get actual bytes read
+	inbuffer = 	xadAllocVec(XZ_IN_BUF_SIZE, MEMF_PRIVATE);
+	outbuffer = xadAllocVec(XZ_OUT_BUF_SIZE, MEMF_PRIVATE);
+	if(!inbuffer || !outbuffer)
+	{
+		if(inbuffer) xadFreeObjectA(inbuffer, NULL);
+		if(outbuffer) xadFreeObjectA(outbuffer, NULL);
+		return XADERR_NOMEMORY;
+	}
 
-	ret = lzma_stream_decoder(&strm, UINT64_MAX, 0);
-	if(ret != LZMA_OK) return XADERR_UNKNOWN;
+#ifdef __AROS__
+	/* blocks with known sizes are decoded on all CPUs, the buffers of
+	   the blocks in flight may use up to a quarter of the RAM */
+	mt.flags = LZMA_CONCATENATED;
+	mt.threads = lzma_cputhreads();
+	if(mt.threads == 0) mt.threads = 1;
+	/* zero would mean no limit, fall back to a fixed one */
+	mt.memlimit_threading = lzma_physmem() / 4;
+	if(mt.memlimit_threading == 0) mt.memlimit_threading = XZ_MT_MEMLIMIT;
+	mt.memlimit_stop = UINT64_MAX;
+
+	ret = lzma_stream_decoder_mt(&strm, &mt);
+#else
+	ret = lzma_stream_decoder(&strm, UINT64_MAX, LZMA_CONCATENATED);
+#endif
+	if(ret != LZMA_OK)
+	{
+		xadFreeObjectA(inbuffer, NULL);
+		xadFreeObjectA(outbuffer, NULL);
+		return XADERR_UNKNOWN;
+	}
 
+	/* feed the decoder in XZ_IN_BUF_SIZE chunks, memory use
+	   doesn't depend on the archive size */
+	inleft = ai->xai_InSize - ai->xai_InPos;
 
-	strm.next_in = inbuffer;
-	strm.avail_in = ai->xai_InSize;
+	strm.next_out = outbuffer;
+	strm.avail_out = XZ_OUT_BUF_SIZE;
 
-	do
+	while(err == XADERR_OK)
 	{
-		strm.next_out = outbuffer;
-		strm.avail_out = 1024;
+		if((strm.avail_in == 0) && (inleft > 0))
+		{
+			readbytes = inleft > XZ_IN_BUF_SIZE ? XZ_IN_BUF_SIZE : inleft;
+			if((err = xadHookAccess(XADAC_READ, readbytes, inbuffer, ai))) break;
 
-		ret = lzma_code(&strm, LZMA_RUN);
+			strm.next_in = inbuffer;
+			strm.avail_in = readbytes;
+			inleft -= readbytes;
+		}
 
-		if((ret != LZMA_OK) && (ret != LZMA_STREAM_END))
-			err = XADERR_DECRUNCH;
+		if((strm.avail_in == 0) && (inleft == 0)) action = LZMA_FINISH;
 
-		if((err == XADERR_OK) && (strm.avail_out != 1024))
-			err = xadHookAccess(XADAC_WRITE, 1024 - strm.avail_out, outbuffer, ai);
+		ret = lzma_code(&strm, action);
 
-		if(err) strm.avail_out = 1024;
+		if((strm.avail_out == 0) || (ret == LZMA_STREAM_END))
+		{
+			if(strm.avail_out != XZ_OUT_BUF_SIZE)
+				err = xadHookAccess(XADAC_WRITE, XZ_OUT_BUF_SIZE - strm.avail_out, outbuffer, ai);
 
-	} while (strm.avail_out == 0);
+			strm.next_out = outbuffer;
+			strm.avail_out = XZ_OUT_BUF_SIZE;
+		}
+
+		if(ret == LZMA_STREAM_END) break;
+
+		if((ret != LZMA_OK) && (err == XADERR_OK))
+			err = XADERR_DECRUNCH;
+	}
 
 	lzma_end(&strm);
 
@@ -13,6 +13,21 @@
 #define MEMF_PRIVATE MEMF_ANY
 #endif
 
+/* size of the chunks the compressed data is read in */
+#ifndef XZ_IN_BUF_SIZE
+#define XZ_IN_BUF_SIZE (1 << 16)
+#endif
+
+/* size of the decoder output buffer, each full buffer is one XADAC_WRITE */
+#ifndef XZ_OUT_BUF_SIZE
+#define XZ_OUT_BUF_SIZE (1 << 20)
+#endif
+
+/* memory for the blocks being decoded in parallel if the RAM size is unknown */
+#ifndef XZ_MT_MEMLIMIT
+#define XZ_MT_MEMLIMIT (64 << 20)
+#endif
+
 struct xad7zprivate {
 // dummy
 };